@@ -15,10 +15,21 @@ int main (int argc, char *argv[])
     string number = B_filename.substr(B_filename.find('t')+1,B_filename.find('.')-B_filename.find('t')-1);
     double t = atoi(number.c_str());
 
+    // the grid is the one in the file's header, whichever kind of uv file it is
+    const bool compressed = compressed_uv_file(B_filename);
+    const bool vti = vti_file(B_filename);
+    int filegrid[3] = {0,0,0};
+    CompressedUVHeader compressedheader;
+    VTIGrid vtigrid;
+    VTKUVGrid vtkgrid;
+    if(compressed && read_compressed_uv_header(B_filename,compressedheader)) filegrid[0] = compressedheader.Nx, filegrid[1] = compressedheader.Ny, filegrid[2] = compressedheader.Nz;
+    else if(vti && read_vti_grid(B_filename,vtigrid)) filegrid[0] = vtigrid.Nx, filegrid[1] = vtigrid.Ny, filegrid[2] = vtigrid.Nz;
+    else if(!compressed && !vti && read_vtk_uv_grid(B_filename,vtkgrid)) filegrid[0] = vtkgrid.Nx, filegrid[1] = vtkgrid.Ny, filegrid[2] = vtkgrid.Nz;
+    if(filegrid[0] == 0) return 1;
     griddata griddata;
-    griddata.Nx = initialNx;
-    griddata.Ny = initialNy;
-    griddata.Nz = initialNz;
+    griddata.Nx = filegrid[0];
+    griddata.Ny = filegrid[1];
+    griddata.Nz = filegrid[2];
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
     int Nz = griddata.Nz;
@@ -28,9 +39,16 @@ int main (int argc, char *argv[])
     vector<double>v(Nx*Ny*Nz);
     vector<double>ucvmag(Nx*Ny*Nz);
 
-    uvfile_read_BINARY(u,v,ucvmag,griddata);
+    // the simulation can write its uv files compressed (see Simulation/SnapshotCodec.h), or as .vti (see Simulation/VTIFile.h), and a .vti
+    // comes out as one
+    int failed;
+    if(compressed) failed = uvfile_read_COMPRESSED(u,v,ucvmag,griddata);
+    else if(vti) failed = uvfile_read_VTI(u,v,ucvmag,griddata);
+    else failed = uvfile_read_BINARY(u,v,ucvmag,griddata);
+    if(failed) return 1;
     extractinnerlayer(u,v,ucvmag,griddata);
-    print_uv(u,v,ucvmag,t,griddata);
+    if(vti) print_uv_vti(u,v,ucvmag,t,griddata);
+    else print_uv(u,v,ucvmag,t,griddata);
 
     return 0;
 }
@@ -134,124 +152,83 @@ void print_uv( vector<double>&u, vector<double>&v,vector<double>&ucvmag, double
     uvout.close();
 }
 
-int uvfile_read_BINARY(vector<double>&u, vector<double>&v,vector<double>&ucvmag,const griddata& griddata)
+void print_uv_vti( vector<double>&u, vector<double>&v,vector<double>&ucvmag, double t, const griddata& griddata)
 {
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
-    int Nz = griddata.Nz;
-    string temp,buff;
     stringstream ss;
-    ifstream fin (B_filename.c_str(), std::ios::in  | std::ios::binary);
-    int i,j,k,n;
-
-    for(i=0;i<10;i++)
-    {
-        if(fin.good())
-        {
-            if(getline(fin,buff)) temp = buff;
-        }
-        else
-        {
-            cout << "Something went wrong!\n";
-            return 1;
-        }
-    }
-
-    for(k=0; k<Nz; k++)
-    {
-        for(j=0; j<Ny; j++)
-        {
-            for(i=0; i<Nx; i++)
-            {
-                n=pt(i,j,k,griddata);
-                char* memblock;
-                char* swapped;
-                memblock = new char [sizeof(float)];
-                swapped = new char [sizeof(float)];
-                fin.read(memblock,sizeof(float));
-                ByteSwap(memblock, swapped);
-                float value = 12;
-                memcpy(&value, swapped, 4);
-                u[n] = value;
-                delete[] memblock;
-                delete[] swapped;
-            }
-        }
-    }
-
-    for(i=0;i<3;i++)
+    ss << "uv_plot_stripped_" << t << ".vti";
+    const VTIGrid grid = {Nx, Ny, (int)griddata.Nz, h, {x(0,griddata), y(0,griddata), z(0,griddata)}};
+    const char* names[3] = {"u", "v", "ucrossv"};
+    vector<double>* fields[3] = {&u, &v, &ucvmag};
+    size_t filebytes = 0;
+    write_vti(ss.str(), grid, vector<string>(names,names+3), [&](int a, int k0, int k1, float* values)
     {
-        if(fin.good())
-        {
-            if(getline(fin,buff)) temp = buff;
-        }
-        else
-        {
-            cout << "Something went wrong!\n";
-            return 1;
-        }
-    }
+        const vector<double>& f = *fields[a];
+        for(int k=k0; k<k1; k++) for(int j=0; j<Ny; j++) for(int i=0; i<Nx; i++) values[((size_t)(k-k0)*Ny+j)*Nx+i] = f[pt(i,j,k,griddata)];
+    }, omp_get_max_threads(), filebytes);
+}
 
-    for(k=0; k<Nz; k++)
+// the u, v and ucrossv arrays of B_filename, or if it is the u of a file per field (uv_plot<t>_u.vti), of it and the _v and _ucrossv files
+int uvfile_read_VTI(vector<double>&u, vector<double>&v,vector<double>&ucvmag,const griddata& griddata)
+{
+    int Nx = griddata.Nx;
+    int Ny = griddata.Ny;
+    int Nz = griddata.Nz;
+    const char* names[3] = {"u", "v", "ucrossv"};
+    vector<double>* fields[3] = {&u, &v, &ucvmag};
+    const size_t perfield = B_filename.rfind("_u.vti");
+    const bool onefile = (perfield == string::npos || perfield + 6 != B_filename.size());
+    for(int a=0; a<3; a++)
     {
-        for(j=0; j<Ny; j++)
+        const string filename = onefile ? B_filename : B_filename.substr(0,perfield) + "_" + names[a] + ".vti";
+        vector<double>& f = *fields[a];
+        if(!read_vti_array(filename, names[a], [&](const float* values)
         {
-            for(i=0; i<Nx; i++)
-            {
-                n=pt(i,j,k,griddata);
-                char* memblock;
-                char* swapped;
-                memblock = new char [sizeof(float)];
-                swapped = new char [sizeof(float)];
-                fin.read(memblock,sizeof(float));
-                ByteSwap(memblock, swapped);
-                float value = 12;
-                memcpy(&value, swapped, 4);
-                v[n] = value;
-                delete[] memblock;
-                delete[] swapped;
-            }
-        }
+            for(int k=0; k<Nz; k++) for(int j=0; j<Ny; j++) for(int i=0; i<Nx; i++) f[pt(i,j,k,griddata)] = values[((size_t)k*Ny+j)*Nx+i];
+        })) return 1;
     }
+    return 0;
+}
 
-    for(i=0;i<3;i++)
+int uvfile_read_COMPRESSED(vector<double>&u, vector<double>&v,vector<double>&ucvmag,const griddata& griddata)
+{
+    int Nx = griddata.Nx;
+    int Ny = griddata.Ny;
+    int Nz = griddata.Nz;
+    vector<double>* sections[3] = {&u, &v, &ucvmag};
+    const bool ok = read_compressed_uv(B_filename, 3, [&](int section, int k0, int k1, const float* values)
     {
-        if(fin.good())
-        {
-            if(getline(fin,buff)) temp = buff;
-        }
-        else
-        {
-            cout << "Something went wrong!\n";
-            return 1;
-        }
-    }
+        vector<double>& f = *sections[section];
+        for(int k=k0; k<k1; k++) for(int j=0; j<Ny; j++) for(int i=0; i<Nx; i++) f[pt(i,j,k,griddata)] = values[((size_t)(k-k0)*Ny+j)*Nx+i];
+    });
+    return ok ? 0 : 1;
+}
 
-    for(k=0; k<Nz; k++)
+// the sections u, v and ucrossv of a legacy VTK uv file (see Simulation/VTKUVFile.h), which is mapped in and swapped into place over the threads
+int uvfile_read_BINARY(vector<double>&u, vector<double>&v,vector<double>&ucvmag,const griddata& griddata)
+{
+    int Nx = griddata.Nx;
+    int Ny = griddata.Ny;
+    int Nz = griddata.Nz;
+    vector<double>* sections[3] = {&u, &v, &ucvmag};
+    const bool ok = read_vtk_uv(B_filename, 3, [&](int section, const char* values)
     {
-        for(j=0; j<Ny; j++)
+        vector<double>& f = *sections[section];
+        const size_t plane = (size_t)Nx*Ny;
+#pragma omp parallel for collapse(2) schedule(static)
+        for(int i=0; i<Nx; i++)
         {
-            for(i=0; i<Nx; i++)
+            for(int j=0; j<Ny; j++)
             {
-                n=pt(i,j,k,griddata);
-                char* memblock;
-                char* swapped;
-                memblock = new char [sizeof(float)];
-                swapped = new char [sizeof(float)];
-                fin.read(memblock,sizeof(float));
-                ByteSwap(memblock, swapped);
-                float value = 12;
-                memcpy(&value, swapped, 4);
-                ucvmag[n] = value;
-                delete[] memblock;
-                delete[] swapped;
+                const size_t column = (size_t)j*Nx + i;
+                double* row = &f[pt(i,j,0,griddata)];
+#pragma omp simd
+                for(int k=0; k<Nz; k++) row[k] = vtk_uv_value(values, column + k*plane);
             }
         }
-    }
-
-    fin.close();
-
-    return 0;
+    });
+    return ok ? 0 : 1;
 }
 
 void extractinnerlayer(vector<double>&u,vector<double>&v,vector<double>&ucvmag,griddata& oldgriddata)
@@ -262,29 +239,48 @@ void extractinnerlayer(vector<double>&u,vector<double>&v,vector<double>&ucvmag,g
     int Nz = oldgriddata.Nz;
     double ucrit = -1.2;
 
-    // first of all, go thorugh the array, and mark everything above ucrit, and with ucv>0.1  (ie actually on the knot) with a "to be evaluated" integer
-    std::vector<int>marked(u.size(),0);
-    for(int n = 0; n<u.size();n++)
+    // first of all, go thorugh the array, and mark everything above ucrit, and with ucv>0.1  (ie actually on the knot) with a "to be evaluated" integer.
+    // the marked array has a layer of padding all round, and it and everything at or below ucrit is marked as never to be grown into, so grow can
+    // look at all 26 neighbours of a point without checking where it is or what u is there
+    std::vector<int>marked((Nx+2)*(Ny+2)*(Nz+2),-4);
+    for(int i=0;i<Nx;i++)
     {
-        if(u[n]>ucrit && ucvmag[n]>0.1){marked[n]=-1;}
+        for(int j=0; j<Ny; j++)
+        {
+            for(int k=0; k<Nz; k++)
+            {
+                int n = pt(i,j,k,oldgriddata);
+                int m = ptpadded(i,j,k,oldgriddata);
+                if(u[n]<=ucrit) continue;
+                if(ucvmag[n]>0.1) marked[m]=-1;
+                else marked[m]=0;
+            }
+        }
     }
 
     // okay , grow the shell, starting from this inner layer
-    growshell(u,marked,ucrit, oldgriddata);
+    growshell(marked, oldgriddata);
     // now simply remove the u>ucrit which does not sit on this inner layer
-    for(int n = 0; n<u.size();n++)
+    for(int i=0;i<Nx;i++)
     {
-        if(marked[n]!=-2 && u[n]>ucrit) { u[n] = -1.03; v[n] = -0.66;}
+        for(int j=0; j<Ny; j++)
+        {
+            for(int k=0; k<Nz; k++)
+            {
+                int n = pt(i,j,k,oldgriddata);
+                if(marked[ptpadded(i,j,k,oldgriddata)]!=-2 && u[n]>ucrit) { u[n] = -1.03; v[n] = -0.66;}
+            }
+        }
     }
 }
-void growshell(vector<double>&u,vector<int>& marked,double ucrit, const griddata& griddata)
+void growshell(vector<int>& marked, const griddata& griddata)
 {
     bool stillboundaryleft = true;
     while(stillboundaryleft)
     {
-        grow(u,marked,ucrit,griddata);
+        grow(marked,griddata);
         stillboundaryleft = false;
-        for(int n = 0; n<u.size();n++)
+        for(int n = 0; n<marked.size();n++)
         {
             if(marked[n]==-1) stillboundaryleft =true;
         }
@@ -292,43 +288,51 @@ void growshell(vector<double>&u,vector<int>& marked,double ucrit, const griddata
     }
     // okay we have our marked points - they are marked with a 2 in the marked array. lets set all the uv values we find their to the resting state values
 }
-void grow(const vector<double>&u,vector<int>&marked,double ucrit,const griddata& griddata)
+void grow(vector<int>&marked,const griddata& griddata)
 {
     // the marked array has the following values
     // 0 - not evaluated 
     // -1 - a boundary, to be grown 
     // -2 - the interrior, already grown
     // -3 - a temporary state, marked as a boundary during the update
+    // -4 - off the grid, or at or below ucrit - never grown into
     // positive numbers - layers of shells already marked
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
     int Nz = griddata.Nz;
+    // the offsets of the 26 neighbours (and the point itself) in the padded array
+    int neighbouroffsets[27];
+    int m = 0;
+    for(int iinc=-1;iinc<=1;iinc++)
+    {
+        for(int jinc=-1; jinc<=1; jinc++)
+        {
+            for(int kinc=-1; kinc<=1; kinc++)
+            {
+                neighbouroffsets[m] = (iinc*(Ny+2)+jinc)*(Nz+2)+kinc;
+                m++;
+            }
+        }
+    }
     for(int i=0;i<Nx;i++)
     {
         for(int j=0; j<Ny; j++)
         {
             for(int k=0; k<Nz; k++)   //Central difference
             {
-                int n = pt(i,j,k,griddata);
+                int n = ptpadded(i,j,k,griddata);
                 if(marked[n] ==-1)
                 {
-
-                    for(int iinc=-1;iinc<=1;iinc++)
+                    for(m=0;m<27;m++)
                     {
-                        for(int jinc=-1; jinc<=1; jinc++)
-                        {
-                            for(int kinc=-1; kinc<=1; kinc++)   //Central difference
-                            {
-                                int neighboringn = pt(incabsorb(i,iinc,Nx),incabsorb(j,jinc,Ny),incabsorb(k,kinc,Nz),griddata);
-                                if(marked[neighboringn] == 0 && u[neighboringn] > ucrit) marked[neighboringn] = -3;
-                            }
-                        }
+                        int neighboringn = n + neighbouroffsets[m];
+                        if(marked[neighboringn] == 0) marked[neighboringn] = -3;
                     }
                 }
             }
         }
     }
-    for(int n = 0; n<u.size();n++)
+    for(int n = 0; n<marked.size();n++)
     {
         if(marked[n]==-1){marked[n] =-2;}
         if(marked[n]==-3){marked[n] =-1;}
@@ -373,6 +377,10 @@ inline  int pt( int i,  int j,  int k,const griddata& griddata)       //convert
 {
     return (i*griddata.Ny*griddata.Nz+j*griddata.Nz+k);
 }
+inline  int ptpadded( int i,  int j,  int k,const griddata& griddata)       //convert i,j,k to single index in an array with one layer of padding all round
+{
+    return ((i+1)*(griddata.Ny+2)*(griddata.Nz+2)+(j+1)*(griddata.Nz+2)+(k+1));
+}
 inline int sign(int i)
 {
     if(i==0) return 0;
@@ -1,4 +1,7 @@
 #include "ShellStripper_Constants.h"
+#include "../Simulation/SnapshotCodec.h"    // build with ../Simulation/SnapshotCodec.cpp ../Simulation/VTIFile.cpp ../Simulation/VTKUVFile.cpp and -lz
+#include "../Simulation/VTIFile.h"
+#include "../Simulation/VTKUVFile.h"
 #include <stdlib.h>
 #include <iostream>
 #include <iomanip>
@@ -23,6 +26,7 @@ inline double y(int i,const griddata& griddata);
 inline double z(int i,const griddata& griddata);
 inline int sign(int i);
 inline  int pt( int i,  int j,  int k,const griddata& griddata);       //convert i,j,k to single index
+inline  int ptpadded( int i,  int j,  int k,const griddata& griddata);       //the same, for an array with one layer of padding all round
 inline int circularmod(int i, int N);    // mod i by N in a cirucler fashion, ie wrapping around both in the +ve and -ve directions
 inline int incp(int i, int p, int N);    //increment i with p for periodic boundary
 inline int gridinc(int i, int p, int N, int direction );    //increment with reflecting boundary between -1 and 0 and N-1 and N
@@ -33,13 +37,16 @@ void extractinnerlayer(vector<double>&u,vector<double>&v,vector<double>&ucvmag,g
 void print_marked( vector<int>&marked,int shelllabel, const griddata& griddata);
 
 void print_uv( vector<double>&u, vector<double>&v,vector<double>&ucvmag, double t, const griddata& griddata);
+void print_uv_vti( vector<double>&u, vector<double>&v,vector<double>&ucvmag, double t, const griddata& griddata);
 int uvfile_read_BINARY(vector<double>&u, vector<double>&v,vector<double>&ucvmag,const griddata& griddata);
+int uvfile_read_COMPRESSED(vector<double>&u, vector<double>&v,vector<double>&ucvmag,const griddata& griddata);
+int uvfile_read_VTI(vector<double>&u, vector<double>&v,vector<double>&ucvmag,const griddata& griddata);
 float FloatSwap( float f );
 void ByteSwap(const char* TobeSwapped, char* swapped );
 
 // things for the grown function
 
 inline int incabsorb(int i, int p, int N);
-void growshell(vector<double>&u,vector<int>& marked,double ucrit, const griddata& griddata);
-void grow(const vector<double>&u,vector<int>&marked,double ucrit,const griddata& griddata);
+void growshell(vector<int>& marked, const griddata& griddata);
+void grow(vector<int>&marked,const griddata& griddata);
 
@@ -15,9 +15,7 @@ std::string B_filename = "test.vtk";    //filename for phi field or uv field
 // OPTION - what grid values do you want/ timestep
 //Grid points
 const double h = 0.641566;            //grid spacing
-const int initialNx = 238;   //No. points in x,y and z
-const int initialNy = 238;
-const int initialNz = 238;
+// the No. points in x,y and z are read from the header of the uv file
 
 // OPTION - do you want to resize the box? if so, when?
 const bool BoxResizeFlag = 0;
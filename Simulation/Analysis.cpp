@@ -0,0 +1,86 @@
+#include "Analysis.h"
+#include "DerivedFields.h"
+#include "SnapshotQueue.h"
+
+// a copy of the grid, and what the main loop wanted done with it
+struct Snapshot
+{
+    Field<StoreType> u,v;
+    double t;
+    int iteration;
+    bool frequent,velocity;
+};
+
+static vector<Snapshot> snapshots;
+static SnapshotQueue queue;
+static BoundaryKernels analysissolver;
+static Griddata analysisgriddata;
+// everything the tracing keeps from one snapshot to the next. only touched by the analysis thread while anything is queued
+static vector<knotcurve> analysiscurves,analysiscurvesold;
+static vector<double> ucvx,ucvy,ucvz,ucvmag;
+static DerivedFields derived(ucvx,ucvy,ucvz,ucvmag);
+static gsl_multimin_fminimizer* minimizerstate = NULL;
+
+static void analyse(int s)
+{
+    Snapshot& snapshot = snapshots[s];
+    trace_knot(snapshot.u,snapshot.v,derived,analysiscurves,analysiscurvesold,minimizerstate,snapshot.t,snapshot.iteration,snapshot.frequent,snapshot.velocity,analysissolver,analysisgriddata);
+}
+
+void analysis_start(const BoundaryKernels& solver, const Griddata& knotgriddata, const vector<knotcurve>& knotcurves, const vector<knotcurve>& knotcurvesold)
+{
+    analysissolver = solver;
+    analysisgriddata = knotgriddata;
+    analysiscurves = knotcurves;
+    analysiscurvesold = knotcurvesold;
+    const int points = analysisgriddata.Nx*analysisgriddata.Ny*analysisgriddata.Nz;
+    ucvx.assign(points,0);
+    ucvy.assign(points,0);
+    ucvz.assign(points,0);
+    ucvmag.assign(points,0);
+    derived.invalidate();
+    minimizerstate = gsl_multimin_fminimizer_alloc(gsl_multimin_fminimizer_nmsimplex2,2);
+    // the snapshots are sized the first time they are used
+    snapshots.resize(AnalysisQueueLength);
+    queue.start(AnalysisQueueLength,analyse);
+}
+
+void analysis_submit(const Field<StoreType>& u, const Field<StoreType>& v, double t, int n, bool frequent, bool velocity)
+{
+    // the velocities are worked out between one velocity snapshot and the next, so those can't be dropped
+    const int s = queue.acquire(AnalysisDropWhenFull && !velocity);
+    if(s < 0) return;
+    Snapshot& snapshot = snapshots[s];
+    snapshot.u = u;
+    snapshot.v = v;
+    snapshot.t = t;
+    snapshot.iteration = n;
+    snapshot.frequent = frequent;
+    snapshot.velocity = velocity;
+    queue.submit(s);
+}
+
+void analysis_curves(vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold)
+{
+    queue.drain();
+    knotcurves = analysiscurves;
+    knotcurvesold = analysiscurvesold;
+}
+
+void analysis_finish()
+{
+    queue.finish();
+    if(minimizerstate) gsl_multimin_fminimizer_free(minimizerstate);
+    minimizerstate = NULL;
+    cout << "analysis thread: grad u cross grad v worked out \t" << derived.misses << " times, reused \t" << derived.hits << " times\n";
+}
+
+double analysis_wait_seconds()
+{
+    return queue.wait_seconds();
+}
+
+int analysis_dropped()
+{
+    return queue.dropped();
+}
@@ -0,0 +1,27 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+#include "Field.h"
+using namespace std;
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+// tracing the knot on a thread of its own (AsyncAnalysis). at each print the main loop copies the grid the knot is traced on into a free
+// snapshot, queues it, and steps on, while the analysis thread takes the snapshots in order and does with each what trace_knot would have
+// done in the main loop. there are AnalysisQueueLength snapshots, and when none is free the main loop waits for one, or drops the snapshot
+// (see AnalysisDropWhenFull). the analysis thread keeps its own grad u cross grad v arrays, knot curves and minimizer, so it shares nothing
+// with the solver but the snapshots. all of these are for rank 0 only
+
+// start the analysis thread, tracing on grids with the given griddata, carrying on from the given curves (empty, unless from a checkpoint)
+void analysis_start(const BoundaryKernels& solver, const Griddata& knotgriddata, const vector<knotcurve>& knotcurves, const vector<knotcurve>& knotcurvesold);
+// queue a copy of u and v (halos filled) at time t and iteration n, for trace_knot with frequent and velocity. call from one thread
+void analysis_submit(const Field<StoreType>& u, const Field<StoreType>& v, double t, int n, bool frequent, bool velocity);
+// wait for everything queued to be traced, and copy out the curves the analysis thread is keeping, for a checkpoint. call from one thread
+void analysis_curves(vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold);
+// wait for everything queued to be traced, then stop the analysis thread
+void analysis_finish();
+// the time analysis_submit spent waiting for a free snapshot, and the number of snapshots it dropped, since the last call
+double analysis_wait_seconds();
+int analysis_dropped();
+
+#endif //ANALYSIS_H
@@ -0,0 +1,218 @@
+#include "BatchLauncher.h"
+#include "Parameters.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <omp.h>
+
+struct BatchRun
+{
+    string name,surface;
+    int Nx,Ny,Nz;
+    double h;
+    int threads;
+    vector<string> settings;  // NAME=value parameters for this run only
+    pid_t pid;
+    int skipped;              // how many times a run behind this one was started ahead of it
+    double start,finish;
+    int status;
+};
+
+static bool read_manifest(const string& manifest, int budget, vector<BatchRun>& runs)
+{
+    ifstream in(manifest.c_str());
+    if(!in)
+    {
+        cout << "can't open the batch manifest " << manifest << "\n";
+        return false;
+    }
+    const size_t slash = manifest.rfind('/');
+    const string directory = (slash == string::npos) ? "." : manifest.substr(0,slash);
+    char cwd[4096];
+    const string here = getcwd(cwd,sizeof(cwd)) ? string(cwd) : string(".");
+    string line;
+    int linenumber = 0;
+    while(getline(in,line))
+    {
+        linenumber++;
+        const size_t hash = line.find('#');
+        if(hash != string::npos) line.erase(hash);
+        istringstream fields(line);
+        BatchRun run;
+        if(!(fields >> run.name)) continue;
+        if(!(fields >> run.surface >> run.Nx >> run.Ny >> run.Nz >> run.h) || run.Nx < 1 || run.Ny < 1 || run.Nz < 1 || run.h <= 0)
+        {
+            cout << manifest << " line " << linenumber << ": expected name surface Nx Ny Nz h [threads] [NAME=value ...]\n";
+            return false;
+        }
+        run.threads = 0;
+        string setting;
+        while(fields >> setting)
+        {
+            if(setting.find('=') != string::npos) run.settings.push_back(setting);
+            else if(run.threads == 0 && run.settings.empty() && atoi(setting.c_str()) > 0) run.threads = atoi(setting.c_str());
+            else
+            {
+                cout << manifest << " line " << linenumber << ": expected name surface Nx Ny Nz h [threads] [NAME=value ...]\n";
+                return false;
+            }
+        }
+        if(run.threads == 0)
+        {
+            const double points = (double)run.Nx*run.Ny*run.Nz;
+            run.threads = (int)(points/BatchPointsPerThread);
+        }
+        run.threads = max(1,min(run.threads,budget));
+        // the runs are started in directories of their own, so they get the surface by its full path
+        if(run.surface[0] != '/') run.surface = directory + "/" + run.surface;
+        if(run.surface[0] != '/') run.surface = here + "/" + run.surface;
+        for(size_t r=0;r<runs.size();r++)
+        {
+            if(runs[r].name == run.name)
+            {
+                cout << manifest << " line " << linenumber << ": there is already a run called " << run.name << "\n";
+                return false;
+            }
+        }
+        run.pid = -1;
+        run.skipped = 0;
+        run.start = run.finish = 0;
+        run.status = -1;
+        runs.push_back(run);
+    }
+    return true;
+}
+
+// start a run in its directory, and return its pid, or -1
+static pid_t launch(const BatchRun& run)
+{
+    if(mkdir(run.name.c_str(),0755) != 0 && errno != EEXIST)
+    {
+        cout << "can't make the directory " << run.name << ": " << strerror(errno) << "\n";
+        return -1;
+    }
+    // the run reads its parameters from a file in its directory: everything this process was given, then the surface, the grid and
+    // anything else from its line of the manifest, which being later win
+    const string parametersname = run.name + "/parameters";
+    ofstream parametersfile(parametersname.c_str());
+    write_parameters(parametersfile);
+    parametersfile << "# from the manifest\n";
+    parametersfile << "knot_filename=\"" << run.surface << "\"\n";
+    parametersfile << "initialNx=" << run.Nx << "\ninitialNy=" << run.Ny << "\ninitialNz=" << run.Nz << "\n";
+    parametersfile << "initialh=" << setprecision(17) << run.h << "\n";
+    for(size_t s=0;s<run.settings.size();s++) parametersfile << run.settings[s] << "\n";
+    parametersfile.close();
+    if(!parametersfile)
+    {
+        cout << "can't write " << parametersname << "\n";
+        return -1;
+    }
+    // everything the child needs is made before the fork, so it only has to make system calls
+    ostringstream threads;
+    threads << run.threads;
+    const string logname = run.name + "/run.log";
+    const string threadss = threads.str();
+    const char* args[] = {"FN_Knot", NULL};
+    cout.flush();
+    const pid_t pid = fork();
+    if(pid != 0) return pid;
+    const int log = open(logname.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(log < 0 || chdir(run.name.c_str()) != 0) _exit(127);
+    dup2(log,1);
+    dup2(log,2);
+    close(log);
+    setenv("OMP_NUM_THREADS",threadss.c_str(),1);
+    execv("/proc/self/exe",(char* const*)args);
+    _exit(127);
+}
+
+int launch_batch(const string& manifest)
+{
+    // the threads this process would have had. nothing here may start a parallel region, or this process would keep a team of its own
+    const int budget = omp_get_max_threads();
+    vector<BatchRun> runs;
+    if(!read_manifest(manifest,budget,runs)) return 1;
+    if(runs.empty())
+    {
+        cout << "there are no runs in " << manifest << "\n";
+        return 1;
+    }
+    cout << "running " << runs.size() << " simulations from " << manifest << " on " << budget << " threads\n";
+
+    const double begin = omp_get_wtime();
+    vector<int> waiting;     // the runs not yet started, in manifest order
+    for(int r=0;r<(int)runs.size();r++) waiting.push_back(r);
+    int freethreads = budget;
+    int running = 0;
+    double threadseconds = 0;   // the threads in use, integrated over time
+    double lastevent = begin;
+    bool failed = false;
+    while(!waiting.empty() || running > 0)
+    {
+        // start what fits, in order. a run that doesn't fit is stepped over, unless it has been stepped over enough already
+        vector<int> stillwaiting;
+        size_t w;
+        for(w=0;w<waiting.size();w++)
+        {
+            BatchRun& run = runs[waiting[w]];
+            if(run.threads > freethreads)
+            {
+                if(run.skipped >= BatchSkipLimit) break;
+                stillwaiting.push_back(waiting[w]);
+                continue;
+            }
+            run.pid = launch(run);
+            run.start = omp_get_wtime() - begin;
+            if(run.pid < 0)
+            {
+                cout << run.name << ": couldn't be started\n";
+                failed = true;
+                continue;
+            }
+            cout << setprecision(4) << "t=" << run.start << "s\tstarted " << run.name << " (" << run.Nx << "x" << run.Ny << "x" << run.Nz << ", h=" << run.h << ") on " << run.threads << " threads\n";
+            freethreads -= run.threads;
+            running++;
+            for(size_t s=0;s<stillwaiting.size();s++) runs[stillwaiting[s]].skipped++;
+        }
+        for(;w<waiting.size();w++) stillwaiting.push_back(waiting[w]);
+        waiting.swap(stillwaiting);
+        if(running == 0) continue;
+
+        // then wait for one to finish
+        int status;
+        const pid_t pid = waitpid(-1,&status,0);
+        if(pid < 0)
+        {
+            if(errno == EINTR) continue;
+            cout << "lost track of the runs: " << strerror(errno) << "\n";
+            return 1;
+        }
+        const double now = omp_get_wtime();
+        threadseconds += (budget-freethreads)*(now-lastevent);
+        lastevent = now;
+        for(size_t r=0;r<runs.size();r++)
+        {
+            BatchRun& run = runs[r];
+            if(run.pid != pid) continue;
+            run.finish = now - begin;
+            run.status = status;
+            freethreads += run.threads;
+            running--;
+            const bool clean = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            if(!clean) failed = true;
+            cout << setprecision(4) << "t=" << run.finish << "s\tfinished " << run.name << " after " << run.finish-run.start << "s" << (clean ? "" : ", and it failed - see its run.log") << "\n";
+        }
+    }
+    const double total = omp_get_wtime() - begin;
+    cout << setprecision(4) << "all done in " << total << "s, with " << 100*threadseconds/(budget*total) << "% of the thread time in use\n";
+    return failed ? 1 : 0;
+}
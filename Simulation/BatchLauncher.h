@@ -0,0 +1,26 @@
+#include "FN_Constants.h"
+#include <string>
+using namespace std;
+
+#ifndef BATCHLAUNCHER_H
+#define BATCHLAUNCHER_H
+
+// launching a batch of simulations as separate processes (./FN_Knot --batch <manifest>). each line of the manifest is a run,
+//   name surface Nx Ny Nz h [threads] [NAME=value ...]
+// with everything after a # ignored. surface is the surface or curve file less its extension (as knot_filename), relative to the directory of
+// the manifest unless it starts with /. threads is how many OpenMP threads the run gets, and if it isn't given a run gets one per
+// BatchPointsPerThread grid points. the runs are packed into the threads this process was given (OMP_NUM_THREADS): they are started in the
+// order of the manifest as threads come free, and a run that doesn't fit yet can be stepped over by smaller ones behind it, but only
+// BatchSkipLimit times, after which the ones behind it wait too, so a big run isn't starved by a stream of small ones.
+//
+// each run is this program started again, as a process of its own, in a directory of its own called name, with everything it prints going to
+// name/run.log. it keeps the thread count it was started with until it finishes: the packing only happens as runs are started, and threads
+// a run leaves idle, or that come free while it is going, can't be picked up by one already running. it is a process rather than a thread
+// because the solver keeps its state in statics, and writes its output to the working directory. the run's parameters are written to
+// name/parameters, which it reads when it starts (see Parameters.h): the ones this process was given, then the surface and grid, then any
+// NAME=value on its line of the manifest. so a uv or phi file (B_filename) is looked for in each run's directory, and a run can be started
+// again by hand by running FN_Knot in its directory.
+// returns 0 if every run finished cleanly, 1 otherwise
+int launch_batch(const string& manifest);
+
+#endif //BATCHLAUNCHER_H
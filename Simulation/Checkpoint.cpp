@@ -0,0 +1,312 @@
+#include "Checkpoint.h"
+#include "Decomposition.h"
+#include "Parameters.h"
+#include <algorithm>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char CheckpointMagic[8] = {'F','N','K','N','O','T','C','P'};
+static const int32_t CheckpointVersion = 1;
+// a knotpoint is nothing but doubles, and goes in the file as them
+static const int PointDoubles = sizeof(knotpoint)/sizeof(double);
+static_assert(sizeof(knotpoint) == PointDoubles*sizeof(double), "a knotpoint has to be all doubles to go in a checkpoint");
+
+static bool little_endian_host()
+{
+    const uint16_t one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+// the file is little endian, so on anything else each value is turned round on the way in and out
+template<typename T> static T little_endian(T value)
+{
+    if(!little_endian_host())
+    {
+        unsigned char* bytes = (unsigned char*)&value;
+        reverse(bytes,bytes+sizeof(T));
+    }
+    return value;
+}
+
+template<typename T> static void put(ostream& out, T value)
+{
+    value = little_endian(value);
+    out.write((const char*)&value,sizeof(T));
+}
+
+static void put_curves(ostream& out, const vector<knotcurve>& curves)
+{
+    put<int32_t>(out,curves.size());
+    for(size_t c=0;c<curves.size();c++)
+    {
+        put(out,curves[c].twist);
+        put(out,curves[c].writhe);
+        put(out,curves[c].length);
+        put(out,curves[c].xavgpos);
+        put(out,curves[c].yavgpos);
+        put(out,curves[c].zavgpos);
+        put<int32_t>(out,curves[c].knotcurve.size());
+        for(size_t s=0;s<curves[c].knotcurve.size();s++)
+        {
+            const double* point = (const double*)&curves[c].knotcurve[s];
+            for(int d=0;d<PointDoubles;d++) put(out,point[d]);
+        }
+    }
+}
+
+// the whole of a checkpoint, mapped into memory, and how far through it we are. a read past the end gives zero, and sets overrun
+struct MappedCheckpoint
+{
+    const char* data;
+    size_t size;
+    size_t at;
+    bool overrun;
+};
+
+template<typename T> static T get(MappedCheckpoint& in)
+{
+    T value = T();
+    if(in.at + sizeof(T) > in.size)
+    {
+        in.overrun = true;
+        return value;
+    }
+    memcpy(&value,in.data+in.at,sizeof(T));
+    in.at += sizeof(T);
+    return little_endian(value);
+}
+
+// a count of things at least minbytes each, which there has to be room left for
+static int get_count(MappedCheckpoint& in, size_t minbytes)
+{
+    const int32_t n = get<int32_t>(in);
+    if(n < 0 || (size_t)n*minbytes > in.size - min(in.at,in.size))
+    {
+        in.overrun = true;
+        return 0;
+    }
+    return n;
+}
+
+static void get_curves(MappedCheckpoint& in, vector<knotcurve>& curves)
+{
+    curves.resize(get_count(in,6*sizeof(double)+sizeof(int32_t)));
+    for(size_t c=0;c<curves.size();c++)
+    {
+        curves[c].twist = get<double>(in);
+        curves[c].writhe = get<double>(in);
+        curves[c].length = get<double>(in);
+        curves[c].xavgpos = get<double>(in);
+        curves[c].yavgpos = get<double>(in);
+        curves[c].zavgpos = get<double>(in);
+        curves[c].knotcurve.resize(get_count(in,sizeof(knotpoint)));
+        for(size_t s=0;s<curves[c].knotcurve.size();s++)
+        {
+            double* point = (double*)&curves[c].knotcurve[s];
+            for(int d=0;d<PointDoubles;d++) point[d] = get<double>(in);
+        }
+    }
+}
+
+// say which parameters aren't what they were when the checkpoint was written. both are write_parameters output
+static void report_parameter_changes(const string& then)
+{
+    stringstream nowtext;
+    write_parameters(nowtext);
+    map<string,string> before;
+    stringstream thentext(then);
+    string line;
+    while(getline(thentext,line))
+    {
+        const size_t equals = line.find('=');
+        if(equals != string::npos) before[line.substr(0,equals)] = line.substr(equals+1);
+    }
+    while(getline(nowtext,line))
+    {
+        const size_t equals = line.find('=');
+        if(equals == string::npos) continue;
+        const string name = line.substr(0,equals);
+        if(before.count(name) && before[name] != line.substr(equals+1)) cout << name << " was " << before[name] << " when the checkpoint was written, and is now " << line.substr(equals+1) << "\n";
+    }
+}
+
+template<typename Store>
+bool write_checkpoint(const Field<Store>& u, const Field<Store>& v, double t, int n, const vector<knotcurve>& knotcurves, const vector<knotcurve>& knotcurvesold, const Griddata& griddata)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    stringstream ss;
+    ss << "checkpoint" << t << ".chk";
+    // it is written under another name and moved into place, so a run stopped part way through never leaves half a checkpoint
+    const string filename = ss.str();
+    const string partname = filename + ".part";
+    ofstream out(partname.c_str(), std::ios::out | std::ios::binary);
+    if(!out.good())
+    {
+        cout << "couldn't open " << partname << " to write a checkpoint\n";
+        return false;
+    }
+    stringstream parameters;
+    write_parameters(parameters);
+    const string text = parameters.str();
+
+    out.write(CheckpointMagic,sizeof(CheckpointMagic));
+    put<int32_t>(out,CheckpointVersion);
+    put<int32_t>(out,Nx);
+    put<int32_t>(out,Ny);
+    put<int32_t>(out,Nz);
+    put<int32_t>(out,griddata.boundarytype);
+    put<int32_t>(out,n);
+    put(out,griddata.h);
+    put(out,t);
+    put(out,dtime);
+    put<int64_t>(out,text.size());
+    out.write(text.data(),text.size());
+    // the fields start on a multiple of 8 bytes, so the mapped doubles can be read where they lie
+    const size_t headerbytes = sizeof(CheckpointMagic) + 6*sizeof(int32_t) + 3*sizeof(double) + sizeof(int64_t) + text.size();
+    for(size_t b=headerbytes;b%sizeof(double);b++) out.put(0);
+
+    // a plane at a time, turned into little endian doubles
+    vector<double> plane((size_t)Ny*Nz);
+    for(int f=0;f<2;f++)
+    {
+        const Field<Store>& field = (f==0) ? u : v;
+        for(int i=0;i<Nx;i++)
+        {
+            for(int j=0;j<Ny;j++) for(int k=0;k<Nz;k++) plane[(size_t)j*Nz+k] = little_endian((double)field(i,j,k));
+            out.write((const char*)plane.data(),plane.size()*sizeof(double));
+        }
+    }
+
+    put<int32_t>(out,componenttracking.first);
+    put<int32_t>(out,componenttracking.writhe.size());
+    const vector<double>* stats[6] = {&componenttracking.writhe, &componenttracking.twist, &componenttracking.length, &componenttracking.xavgpos, &componenttracking.yavgpos, &componenttracking.zavgpos};
+    for(size_t c=0;c<componenttracking.writhe.size();c++) for(int s=0;s<6;s++) put(out,(*stats[s])[c]);
+    put_curves(out,knotcurves);
+    put_curves(out,knotcurvesold);
+
+    out.close();
+    if(out.fail() || rename(partname.c_str(),filename.c_str()) != 0)
+    {
+        cout << "couldn't write the checkpoint " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+template<typename Store>
+bool read_checkpoint(Field<Store>& u, Field<Store>& v, double& t, int& n, vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold, const Griddata& slabgriddata)
+{
+    const Griddata griddata = whole_griddata(slabgriddata);
+    const bool rankzero = (decomposition().rank == 0);
+    const int fd = open(B_filename.c_str(),O_RDONLY);
+    struct stat filestat;
+    if(fd < 0 || fstat(fd,&filestat) != 0 || filestat.st_size == 0)
+    {
+        cout << "couldn't open the checkpoint " << B_filename << "\n";
+        if(fd >= 0) close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL,filestat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        cout << "couldn't map the checkpoint " << B_filename << "\n";
+        return false;
+    }
+    MappedCheckpoint in = {(const char*)mapping, (size_t)filestat.st_size, 0, false};
+
+    bool ok = (in.size >= sizeof(CheckpointMagic) && memcmp(in.data,CheckpointMagic,sizeof(CheckpointMagic)) == 0);
+    in.at = sizeof(CheckpointMagic);
+    if(ok && get<int32_t>(in) != CheckpointVersion) ok = false;
+    if(!ok)
+    {
+        cout << B_filename << " isn't a checkpoint this version of the code can read\n";
+        munmap(mapping,in.size);
+        return false;
+    }
+    const int Nx = get<int32_t>(in);
+    const int Ny = get<int32_t>(in);
+    const int Nz = get<int32_t>(in);
+    const int boundarytype = get<int32_t>(in);
+    n = get<int32_t>(in);
+    const double h = get<double>(in);
+    t = get<double>(in);
+    const double checkpointdtime = get<double>(in);
+    const int64_t textbytes = get<int64_t>(in);
+    if(in.overrun || textbytes < 0 || (size_t)textbytes > in.size - in.at)
+    {
+        cout << "the checkpoint " << B_filename << " is cut short\n";
+        munmap(mapping,in.size);
+        return false;
+    }
+    const string text(in.data+in.at,textbytes);
+    in.at += textbytes;
+    in.at = (in.at + sizeof(double) - 1)/sizeof(double)*sizeof(double);
+
+    // the grid and dtime have to be the ones this run was set up with, since the iteration counts in steps of dtime
+    if(Nx != griddata.Nx || Ny != griddata.Ny || Nz != griddata.Nz || h != griddata.h || boundarytype != griddata.boundarytype || checkpointdtime != dtime)
+    {
+        cout << "the checkpoint " << B_filename << " was written on a " << Nx << "x" << Ny << "x" << Nz << " grid with h " << h << ", boundary type " << boundarytype << " and dtime " << checkpointdtime << ", and this run is set up for " << griddata.Nx << "x" << griddata.Ny << "x" << griddata.Nz << ", h " << griddata.h << ", boundary type " << griddata.boundarytype << " and dtime " << dtime << "\n";
+        munmap(mapping,in.size);
+        return false;
+    }
+    const size_t fielddoubles = (size_t)Nx*Ny*Nz;
+    if(in.size - in.at < 2*fielddoubles*sizeof(double))
+    {
+        cout << "the checkpoint " << B_filename << " is cut short\n";
+        munmap(mapping,in.size);
+        return false;
+    }
+    if(rankzero) report_parameter_changes(text);
+
+    // this rank's slab of each field is a run of whole planes
+    const int slabNx = slabgriddata.Nx;
+    const int xoffset = decomposition().xoffset;
+    for(int f=0;f<2;f++)
+    {
+        Field<Store>& field = (f==0) ? u : v;
+        const double* source = (const double*)(in.data + in.at + f*fielddoubles*sizeof(double)) + (size_t)xoffset*Ny*Nz;
+#pragma omp parallel for collapse(2) schedule(static) if(!omp_in_parallel())
+        for(int i=0;i<slabNx;i++)
+        {
+            for(int j=0;j<Ny;j++)
+            {
+                const double* row = source + ((size_t)i*Ny + j)*Nz;
+                for(int k=0;k<Nz;k++) field(i,j,k) = (Store)little_endian(row[k]);
+            }
+        }
+    }
+    in.at += 2*fielddoubles*sizeof(double);
+
+    if(rankzero)
+    {
+        componenttracking.first = get<int32_t>(in);
+        const int components = get_count(in,6*sizeof(double));
+        vector<double>* stats[6] = {&componenttracking.writhe, &componenttracking.twist, &componenttracking.length, &componenttracking.xavgpos, &componenttracking.yavgpos, &componenttracking.zavgpos};
+        for(int s=0;s<6;s++) stats[s]->resize(components);
+        for(int c=0;c<components;c++) for(int s=0;s<6;s++) (*stats[s])[c] = get<double>(in);
+        get_curves(in,knotcurves);
+        get_curves(in,knotcurvesold);
+        if(in.overrun)
+        {
+            cout << "the knot curves in the checkpoint " << B_filename << " are cut short\n";
+            munmap(mapping,in.size);
+            return false;
+        }
+        cout << "carrying on from the checkpoint at t = " << t << ", iteration " << n << "\n";
+    }
+    munmap(mapping,in.size);
+    return true;
+}
+
+// built for the precision picked in FN_Constants.h
+template bool write_checkpoint<StoreType>(const Field<StoreType>& u, const Field<StoreType>& v, double t, int n, const vector<knotcurve>& knotcurves, const vector<knotcurve>& knotcurvesold, const Griddata& griddata);
+template bool read_checkpoint<StoreType>(Field<StoreType>& u, Field<StoreType>& v, double& t, int& n, vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold, const Griddata& slabgriddata);
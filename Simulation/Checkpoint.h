@@ -0,0 +1,30 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+#include "Field.h"
+#include <vector>
+using namespace std;
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// checkpoints, for carrying on a run exactly where it was (FROM_CHECKPOINT, written every CheckpointTime). a checkpoint holds u and v in
+// double, the time and iteration, the run parameters, and the knot tracing's curves and component tracking (see ComponentTracking), so the
+// velocities and the order of the components carry straight on. it is taken at the top of an iteration, before anything there is printed or
+// traced, and the run carried on from it does those again, so what it prints is what the first run would have. with AdaptiveRefinement the
+// patches aren't kept - they are laid out again from the coarse grid - so that is the one restart which isn't exact.
+// the file, checkpoint<t>.chk, is little endian throughout:
+//   "FNKNOTCP", then int32 version, Nx, Ny, Nz, boundary type and iteration, then double h, t and dtime
+//   int64 length of the parameters text, the text (as write_parameters gives it), and zeros up to a multiple of 8 bytes
+//   u, then v, Nx*Ny*Nz doubles each, in pt() order
+//   the component tracking: int32 first and number of components, then the writhe, twist, length, xavgpos, yavgpos and zavgpos of each
+//   knotcurves, then knotcurvesold: int32 number of components, then for each its twist, writhe, length, xavgpos, yavgpos and zavgpos,
+//   int32 number of points, and the points, each the doubles of a knotpoint in order
+
+// write the checkpoint at time t, iteration n, from the whole grid (on rank 0, see gather_slabs). returns false, having said why, if it can't
+template<typename Store> bool write_checkpoint(const Field<Store>& u, const Field<Store>& v, double t, int n, const vector<knotcurve>& knotcurves, const vector<knotcurve>& knotcurvesold, const Griddata& griddata);
+// read the checkpoint B_filename: this rank's slab of u and v, the time and iteration, and on rank 0 the curves and componenttracking. the file
+// is mapped rather than read through, so each rank only touches its own slab. returns false, having said why, if it can't be read or was
+// written with a different grid, boundary condition or dtime. parameters that are different now are listed
+template<typename Store> bool read_checkpoint(Field<Store>& u, Field<Store>& v, double& t, int& n, vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold, const Griddata& slabgriddata);
+
+#endif //CHECKPOINT_H
@@ -0,0 +1,199 @@
+#include "Decomposition.h"
+#include <string.h>
+
+// one rank, holding the whole grid, until told otherwise
+static Decomposition decomp = {0, 1, 0, 0, -1, -1};
+
+void ranks_init(int* argc, char*** argv)
+{
+#ifdef USE_MPI
+    // the halo swaps happen inside omp single, so MPI gets called from one thread at a time, but not always the same one
+    int provided;
+    MPI_Init_thread(argc, argv, MPI_THREAD_SERIALIZED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &decomp.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &decomp.size);
+    if(decomp.rank==0 && provided < MPI_THREAD_SERIALIZED) cout << "warning: this MPI doesn't support MPI_THREAD_SERIALIZED, run with OMP_NUM_THREADS=1\n";
+    // only rank 0 talks
+    if(decomp.rank != 0) cout.setstate(std::ios::badbit);
+#else
+    // without MPI there is nothing to take from the command line
+    (void)argc;
+    (void)argv;
+#endif
+}
+
+void ranks_finalise()
+{
+#ifdef USE_MPI
+    MPI_Finalize();
+#endif
+}
+
+void ranks_barrier()
+{
+#ifdef USE_MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
+// the planes of the whole grid rank r holds: Nx is shared out as evenly as it goes, the first Nx%size ranks taking one extra
+static void slab_extent(int r, int& xoffset, int& Nx)
+{
+    const int base = decomp.globalNx/decomp.size;
+    const int extra = decomp.globalNx%decomp.size;
+    Nx = base + (r < extra ? 1 : 0);
+    xoffset = r*base + (r < extra ? r : extra);
+}
+
+Griddata decompose(const Griddata& griddata)
+{
+    Griddata slabgriddata = griddata;
+    decomp.globalNx = griddata.Nx;
+    slab_extent(decomp.rank, decomp.xoffset, slabgriddata.Nx);
+    // x is periodic only for ALLPERIODIC, otherwise the ranks at the ends sit against a reflecting wall
+    const bool xperiodic = (griddata.boundarytype == ALLPERIODIC);
+    decomp.left = (decomp.rank > 0) ? decomp.rank-1 : (xperiodic ? decomp.size-1 : -1);
+    decomp.right = (decomp.rank < decomp.size-1) ? decomp.rank+1 : (xperiodic ? 0 : -1);
+    if(slabgriddata.Nx < HaloWidth)
+    {
+        cout << "the grid is too small to split into " << decomp.size << " slabs of at least " << HaloWidth << " planes\n";
+#ifdef USE_MPI
+        MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+    }
+    return slabgriddata;
+}
+
+const Decomposition& decomposition()
+{
+    return decomp;
+}
+
+Griddata whole_griddata(const Griddata& slabgriddata)
+{
+    Griddata griddata = slabgriddata;
+    if(decomp.size > 1) griddata.Nx = decomp.globalNx;
+    return griddata;
+}
+
+#ifdef USE_MPI
+template<typename T> MPI_Datatype mpi_type();
+template<> MPI_Datatype mpi_type<double>() { return MPI_DOUBLE; }
+template<> MPI_Datatype mpi_type<float>() { return MPI_FLOAT; }
+
+// the x faces of the halo of a slab. a padded x plane is contiguous, y and z halos and all, so the g planes at each end go across whole. at a
+// reflecting wall the ghost planes mirror our own instead
+template<typename T>
+void exchange_x_faces(Field<T>& slab, int c)
+{
+    const int g = slab.g;
+    const int Nx = slab.Nx;
+    const int planes = g*slab.xstride;
+    T* f = slab.origin(c);
+    const int left = (decomp.left < 0) ? MPI_PROC_NULL : decomp.left;
+    const int right = (decomp.right < 0) ? MPI_PROC_NULL : decomp.right;
+    MPI_Sendrecv(f+slab.index(0,-g,-g), planes, mpi_type<T>(), left, 0, f+slab.index(Nx,-g,-g), planes, mpi_type<T>(), right, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(f+slab.index(Nx-g,-g,-g), planes, mpi_type<T>(), right, 1, f+slab.index(-g,-g,-g), planes, mpi_type<T>(), left, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    for(int l=1;l<=g;l++)
+    {
+        if(decomp.left < 0) memcpy(f+slab.index(-l,-g,-g), f+slab.index(l-1,-g,-g), slab.xstride*sizeof(T));
+        if(decomp.right < 0) memcpy(f+slab.index(Nx-1+l,-g,-g), f+slab.index(Nx-l,-g,-g), slab.xstride*sizeof(T));
+    }
+}
+#endif
+
+template<typename T>
+void fill_slab_halo(Field<T>& slab, BoundaryCondition boundarytype, int c)
+{
+#ifdef USE_MPI
+    if(decomp.size > 1)
+    {
+        // the y and z faces are filled over the x ghost planes too, so the x faces have to be in first. the barrier at the end of the single sees to that
+#pragma omp single
+        exchange_x_faces(slab,c);
+        slab.fill_halo(boundarytype,c,false);
+        return;
+    }
+#endif
+    slab.fill_halo(boundarytype,c);
+}
+
+template<typename T>
+void slab_neighbour_planes(Field<T>& slab, int n, vector<T>& below, vector<T>& above)
+{
+    const int g = slab.g;
+    const int Nx = slab.Nx;
+    const int planes = n*slab.xstride;
+    if(Nx < n && (decomp.left >= 0 || decomp.right >= 0))
+    {
+        cout << "a slab of " << Nx << " planes is too thin to hand " << n << " planes to its neighbours\n";
+#ifdef USE_MPI
+        MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+        exit(1);
+    }
+    below.assign(decomp.left >= 0 ? planes : 0, 0);
+    above.assign(decomp.right >= 0 ? planes : 0, 0);
+    T* f = slab.origin();
+    if(decomp.size == 1)
+    {
+        // periodic, and we are our own neighbour
+        if(decomp.left >= 0) memcpy(below.data(), f+slab.index(Nx-n,-g,-g), planes*sizeof(T));
+        if(decomp.right >= 0) memcpy(above.data(), f+slab.index(0,-g,-g), planes*sizeof(T));
+        return;
+    }
+#ifdef USE_MPI
+    const int left = (decomp.left < 0) ? MPI_PROC_NULL : decomp.left;
+    const int right = (decomp.right < 0) ? MPI_PROC_NULL : decomp.right;
+    MPI_Sendrecv(f+slab.index(0,-g,-g), planes, mpi_type<T>(), left, 2, above.data(), above.size(), mpi_type<T>(), right, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(f+slab.index(Nx-n,-g,-g), planes, mpi_type<T>(), right, 3, below.data(), below.size(), mpi_type<T>(), left, 3, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+#endif
+}
+
+template<typename T>
+void gather_slabs(Field<T>& slab, Field<T>& whole)
+{
+    if(&slab == &whole) return;
+#ifdef USE_MPI
+    // each rank sends its planes, the first and last ranks adding the outer ghost planes of the whole grid
+    const int g = slab.g;
+    const int xstride = slab.xstride;
+    vector<int> counts(decomp.size), displacements(decomp.size);
+    for(int r=0;r<decomp.size;r++)
+    {
+        int xoffset,Nx;
+        slab_extent(r,xoffset,Nx);
+        counts[r] = (Nx + (r==0 ? g : 0) + (r==decomp.size-1 ? g : 0))*xstride;
+        displacements[r] = (r==0) ? 0 : (xoffset+g)*xstride;
+    }
+    const int firstplane = (decomp.rank==0) ? -g : 0;
+    T* wholestart = (decomp.rank==0) ? whole.origin()+whole.index(-g,-g,-g) : NULL;
+    MPI_Gatherv(slab.origin()+slab.index(firstplane,-g,-g), counts[decomp.rank], mpi_type<T>(), wholestart, counts.data(), displacements.data(), mpi_type<T>(), 0, MPI_COMM_WORLD);
+#endif
+}
+
+template<typename T>
+void scatter_slabs(Field<T>& whole, Field<T>& slab)
+{
+    if(&slab == &whole) return;
+#ifdef USE_MPI
+    const int g = slab.g;
+    const int xstride = slab.xstride;
+    vector<int> counts(decomp.size), displacements(decomp.size);
+    for(int r=0;r<decomp.size;r++)
+    {
+        int xoffset,Nx;
+        slab_extent(r,xoffset,Nx);
+        counts[r] = Nx*xstride;
+        displacements[r] = xoffset*xstride;
+    }
+    T* wholestart = (decomp.rank==0) ? whole.origin()+whole.index(0,-g,-g) : NULL;
+    MPI_Scatterv(wholestart, counts.data(), displacements.data(), mpi_type<T>(), slab.origin()+slab.index(0,-g,-g), counts[decomp.rank], mpi_type<T>(), 0, MPI_COMM_WORLD);
+#endif
+}
+
+// the solver fields are kept in StoreType
+template void fill_slab_halo<StoreType>(Field<StoreType>& slab, BoundaryCondition boundarytype, int c);
+template void slab_neighbour_planes<StoreType>(Field<StoreType>& slab, int n, vector<StoreType>& below, vector<StoreType>& above);
+template void gather_slabs<StoreType>(Field<StoreType>& slab, Field<StoreType>& whole);
+template void scatter_slabs<StoreType>(Field<StoreType>& whole, Field<StoreType>& slab);
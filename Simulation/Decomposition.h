@@ -0,0 +1,47 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+#include "Field.h"
+#ifdef USE_MPI
+// only the C interface - the C++ bindings define names like DOUBLE_PRECISION, which FN_Constants.h uses
+#define OMPI_SKIP_MPICXX
+#define MPICH_SKIP_MPICXX
+#include <mpi.h>
+#endif
+using namespace std;
+
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+// the grid split into slabs along x, one per MPI rank, for the MPI build (make mpi, then mpirun -np <ranks> ./FN_Knot). each rank steps its own
+// slab, swapping the x faces of the halos with the ranks either side. without MPI there is one rank, and its slab is the whole grid
+struct Decomposition
+{
+    int rank,size;
+    int globalNx;    // the x extent of the whole grid
+    int xoffset;     // the global x index of the first plane of this rank's slab
+    int left,right;  // the ranks holding the slabs below and above this one in x, -1 at a reflecting wall
+};
+
+// start and stop MPI. ranks_init must come before anything looks at argv, and only rank 0 prints anything after it
+void ranks_init(int* argc, char*** argv);
+void ranks_finalise();
+void ranks_barrier();
+// split the whole grid into slabs, and return the griddata of this rank's slab
+Griddata decompose(const Griddata& griddata);
+const Decomposition& decomposition();
+// the griddata of the whole grid, given that of this rank's slab
+Griddata whole_griddata(const Griddata& slabgriddata);
+
+// fill the halo of component c of a field holding this rank's slab, the x faces coming from the neighbouring slabs. call it from every
+// thread of a parallel region, or from outside one
+template<typename T> void fill_slab_halo(Field<T>& slab, BoundaryCondition boundarytype, int c = 0);
+// the n planes just below and just above this rank's slab, from the neighbouring slabs (or across a periodic boundary), for something reaching
+// further than the halo. each is n padded planes, laid out as in the slab. at a reflecting wall they're left empty. call from one thread
+template<typename T> void slab_neighbour_planes(Field<T>& slab, int n, vector<T>& below, vector<T>& above);
+// copy every rank's slab, halo and all, into the whole grid on rank 0. the slab halos must be filled, and then so is the whole grid's.
+// with one rank the slab is the whole grid, and there is nothing to do. call from one thread
+template<typename T> void gather_slabs(Field<T>& slab, Field<T>& whole);
+// and the other way, handing out rank 0's whole grid. the slab halos are left for fill_slab_halo
+template<typename T> void scatter_slabs(Field<T>& whole, Field<T>& slab);
+
+#endif //DECOMPOSITION_H
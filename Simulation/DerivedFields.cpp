@@ -0,0 +1,141 @@
+#include "DerivedFields.h"
+#include <math.h>
+#include <string.h>
+
+DerivedFields::DerivedFields(vector<double>& ucvx, vector<double>& ucvy, vector<double>& ucvz, vector<double>& ucvmag)
+    : ucvx(ucvx), ucvy(ucvy), ucvz(ucvz), ucvmag(ucvmag), hits(0), misses(0), partialsincewhole(0)
+{
+    invalidate();
+}
+
+void DerivedFields::crossgrad(Field<StoreType>& u, Field<StoreType>& v, int iteration, const Griddata& griddata)
+{
+    if(crossgradsource.fresh(&u,iteration) && crossgradsource.whole)
+    {
+        hits++;
+        return;
+    }
+    misses++;
+    crossgrad_calc(u,v,ucvx,ucvy,ucvz,ucvmag,griddata);
+    crossgradsource.field = &u;
+    crossgradsource.iteration = iteration;
+    crossgradsource.whole = true;
+    filledblocks.clear();
+    partialsincewhole = 0;
+}
+
+// the block a grid index is in along one direction, and the number of blocks along it
+static inline int block_of(int i, int N)
+{
+    if(i < 0) i = 0;
+    if(i > N-1) i = N-1;
+    return i/CrossgradBandBlock;
+}
+static inline int blocks_along(int N)
+{
+    return (N+CrossgradBandBlock-1)/CrossgradBandBlock;
+}
+
+void DerivedFields::band_blocks(const vector<knotcurve>& curves, const Griddata& griddata, vector<char>& nearblocks) const
+{
+    const int nbx = blocks_along(griddata.Nx);
+    const int nby = blocks_along(griddata.Ny);
+    const int nbz = blocks_along(griddata.Nz);
+    const double h = griddata.h;
+    vector<char> oncurve(nbx*nby*nbz,0);
+    for(size_t c=0;c<curves.size();c++)
+    {
+        for(size_t s=0;s<curves[c].knotcurve.size();s++)
+        {
+            const knotpoint& p = curves[c].knotcurve[s];
+            const int bi = block_of((int)(p.modxcoord/h - 0.5 + griddata.Nx/2.0),griddata.Nx);
+            const int bj = block_of((int)(p.modycoord/h - 0.5 + griddata.Ny/2.0),griddata.Ny);
+            const int bk = block_of((int)(p.modzcoord/h - 0.5 + griddata.Nz/2.0),griddata.Nz);
+            oncurve[(bi*nby+bj)*nbz+bk] = 1;
+        }
+    }
+    // everything within the margin of a point is within this many blocks of its block. the blocks wrap round periodic boundaries
+    const int reach = (int)ceil(CrossgradBandMargin/(h*CrossgradBandBlock));
+    const bool xyperiodic = (griddata.boundarytype == ALLPERIODIC);
+    const bool zperiodic = (griddata.boundarytype != ALLREFLECTING);
+    nearblocks.assign(nbx*nby*nbz,0);
+    for(int bi=0;bi<nbx;bi++) for(int bj=0;bj<nby;bj++) for(int bk=0;bk<nbz;bk++)
+    {
+        if(!oncurve[(bi*nby+bj)*nbz+bk]) continue;
+        for(int di=-reach;di<=reach;di++) for(int dj=-reach;dj<=reach;dj++) for(int dk=-reach;dk<=reach;dk++)
+        {
+            int ni = bi+di, nj = bj+dj, nk = bk+dk;
+            if(xyperiodic) { ni = circularmod(ni,nbx); nj = circularmod(nj,nby); }
+            if(zperiodic) nk = circularmod(nk,nbz);
+            if(ni < 0 || ni >= nbx || nj < 0 || nj >= nby || nk < 0 || nk >= nbz) continue;
+            nearblocks[(ni*nby+nj)*nbz+nk] = 1;
+        }
+    }
+}
+
+bool DerivedFields::crossgrad_near(Field<StoreType>& u, Field<StoreType>& v, const vector<knotcurve>& curves, int iteration, const Griddata& griddata)
+{
+    if(crossgradsource.fresh(&u,iteration))
+    {
+        hits++;
+        return !crossgradsource.whole;
+    }
+    // the whole grid when there is nothing to go on, and every so often to pick up any new components
+    if(!CrossgradBand || curves.empty() || partialsincewhole >= CrossgradFullTraces-1)
+    {
+        crossgrad(u,v,iteration,griddata);
+        return false;
+    }
+    misses++;
+    const int nby = blocks_along(griddata.Ny);
+    const int nbz = blocks_along(griddata.Nz);
+    vector<char> nearblocks;
+    band_blocks(curves,griddata,nearblocks);
+    // blocks which may still hold something from before, but aren't near the knot now, go back to 0
+    if(filledblocks.empty()) filledblocks.assign(nearblocks.size(),1);
+    vector<int> zeroblocks,nearlist;
+    for(int b=0;b<(int)nearblocks.size();b++)
+    {
+        if(nearblocks[b]) nearlist.push_back(b);
+        else if(filledblocks[b]) zeroblocks.push_back(b);
+    }
+    const int nzero = zeroblocks.size();
+    const int nnear = nearlist.size();
+#pragma omp taskloop grainsize(4) shared(u,v,griddata,zeroblocks,nearlist)
+    for(int a=0;a<nzero+nnear;a++)
+    {
+        const int b = (a < nzero) ? zeroblocks[a] : nearlist[a-nzero];
+        const int imin = (b/(nby*nbz))*CrossgradBandBlock;
+        const int jmin = ((b/nbz)%nby)*CrossgradBandBlock;
+        const int kmin = (b%nbz)*CrossgradBandBlock;
+        const int imax = min(imin+CrossgradBandBlock,griddata.Nx);
+        const int jmax = min(jmin+CrossgradBandBlock,griddata.Ny);
+        const int kmax = min(kmin+CrossgradBandBlock,griddata.Nz);
+        if(a < nzero)
+        {
+            for(int i=imin;i<imax;i++) for(int j=jmin;j<jmax;j++)
+            {
+                const int n = pt(i,j,kmin,griddata);
+                const size_t bytes = (kmax-kmin)*sizeof(double);
+                memset(&ucvx[n],0,bytes);
+                memset(&ucvy[n],0,bytes);
+                memset(&ucvz[n],0,bytes);
+                memset(&ucvmag[n],0,bytes);
+            }
+        }
+        else crossgrad_block(u,v,ucvx,ucvy,ucvz,ucvmag,imin,imax,jmin,jmax,kmin,kmax,griddata);
+    }
+    filledblocks.swap(nearblocks);
+    crossgradsource.field = &u;
+    crossgradsource.iteration = iteration;
+    crossgradsource.whole = false;
+    partialsincewhole++;
+    return true;
+}
+
+void DerivedFields::invalidate()
+{
+    crossgradsource.field = NULL;
+    crossgradsource.iteration = -1;
+    crossgradsource.whole = false;
+}
@@ -0,0 +1,46 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+#include "Field.h"
+#include <vector>
+using namespace std;
+
+#ifndef DERIVEDFIELDS_H
+#define DERIVEDFIELDS_H
+
+// the fields worked out from u and v - for now grad u cross grad v - each computed the first time it is asked for at a given iteration, and
+// handed straight back after that until the iteration moves on. it is keyed on the field it was computed from as well, so one cache can serve
+// several grids, though it only holds one. the arrays belong to whoever made the cache, and two caches must not share them
+class DerivedFields
+{
+public:
+    DerivedFields(vector<double>& ucvx, vector<double>& ucvy, vector<double>& ucvz, vector<double>& ucvmag);
+    // make sure ucvx, ucvy, ucvz and ucvmag hold grad u cross grad v of u and v as they are at the given iteration, over the whole grid.
+    // call from one thread (see crossgrad_calc)
+    void crossgrad(Field<StoreType>& u, Field<StoreType>& v, int iteration, const Griddata& griddata);
+    // the same, but with CrossgradBand only needing it near the given curves, and 0 elsewhere. returns true if only part of the grid was done
+    bool crossgrad_near(Field<StoreType>& u, Field<StoreType>& v, const vector<knotcurve>& curves, int iteration, const Griddata& griddata);
+    // forget everything, for when u and v change without the iteration moving on
+    void invalidate();
+
+    vector<double> &ucvx,&ucvy,&ucvz,&ucvmag;
+    // how many times a field was asked for and already there, and how many times it had to be worked out
+    long hits,misses;
+
+private:
+    // what a derived field was last worked out from
+    struct Source
+    {
+        const void* field;
+        int iteration;
+        bool whole;    // over the whole grid, rather than just near the knot
+        bool fresh(const void* f, int n) const { return field == f && iteration == n; }
+    };
+    Source crossgradsource;
+    // the blocks of CrossgradBandBlock points that may hold something other than 0, and the number of times only part of the grid has been
+    // done since it was last done whole
+    vector<char> filledblocks;
+    int partialsincewhole;
+    void band_blocks(const vector<knotcurve>& curves, const Griddata& griddata, vector<char>& nearblocks) const;
+};
+
+#endif //DERIVEDFIELDS_H
@@ -7,10 +7,31 @@
 #define FROM_CURVE_FILE 1
 #define FROM_UV_FILE 2
 #define FROM_FUNCTION 3
+#define FROM_CHECKPOINT 4
 // the different boundary conditions
-enum BoundaryType {ALLREFLECTING, ZPERIODIC, ALLPERIODIC};
+enum BoundaryCondition {ALLREFLECTING, ZPERIODIC, ALLPERIODIC};
+// the different time integrators
+#define RK4 0
+#define LOWSTORAGE_RK 1
+#define IMEX_SPECTRAL 2
+// the different uv file formats
+#define VTK_UV_FILE 0
+#define COMPRESSED_UV_FILE 1
+#define VTI_UV_FILE 2
+// the different solver precisions
+#define DOUBLE_PRECISION 0
+#define SINGLE_PRECISION 1
+#define MIXED_PRECISION 2
+// the different SIMD paths for the update kernels
+#define SIMD_SCALAR 0
+#define SIMD_AVX2 1
+#define SIMD_AVX512 2
+#define SIMD_AUTO 3
 
 /* CHANGE THESE OPTIONS */
+// all but two of these are set when the code starts, from a parameters file and the command line (see Parameters.h), so one build serves
+// every run. each is given as NAME=value, by the name it has here or by the INSERT_ name the old sed templated version of this file used.
+// the defaults are in Parameters.cpp. the two marked BUILD OPTION change the code that gets compiled, and are still set here
 
 // OPTION - // what kind of initialisation
 /* the different initialisation options
@@ -19,68 +40,201 @@ FROM_PHI_FILE: Skip initialisation, input from previous run.
 FROM_SURFACE_FILE: Initialise from input file(s) generated in surface evolver.
 FROM_UV_FILE: Skip initialisation, run FN dynamics from uv file
 FROM_FUNCTION: Initialise from some function which can be implemented by the user in phi_calc_manual. eg using theta(x) = artcan(y-y0/x-x0) to give a pole at x0,y0 etc..:wq
+FROM_CHECKPOINT: Carry on exactly where an earlier run left off, from a checkpoint it wrote (B_filename, see Checkpoint.h)
  */
 //if ncomp > 1 (no. of components) then component files should be separated to 'XXXXX.txt" "XXXXX2.txt", ....
-const int option = INSERT_INITIALISATION_TYPE;         //unknot default option
-const std::string knot_filename = "INSERT_SURFACE_FILENAME";      //if FROM_SURFACE_FILE assumed input filename format of "XXXXX.stl"
-const std::string B_filename = "INSERT_UV_FILENAME";    //filename for phi field or uv field
-const int NumComponents = 1;   //No. points in x,y and z
+extern int option;         //unknot default option
+extern std::string knot_filename;      //if FROM_SURFACE_FILE assumed input filename format of "XXXXX.stl"
+extern std::string B_filename;    //filename for phi field or uv field
+extern int NumComponents;   //No. points in x,y and z
 
-// OPTION - what kind of boundary condition
-const BoundaryType BoundaryType=ALLPERIODIC;
+// OPTION - what kind of boundary condition. it can also be given on the command line on its own, as ./FN_Knot ZPERIODIC
+extern BoundaryCondition BoundaryType;
 
 //OPTION - do you want the geometry of the input file to be exactly preserved, or can it be scaled to fit the box better
-#define PRESERVE_RATIOS 0  //1 to scale input file preserving the aspect ratio
+extern bool PreserveRatios;  //1 to scale input file preserving the aspect ratio
 
 // OPTION - how long should it run, when do you want data printed, what time value should it start at
-const double TTime = INSERT_RUNTIME;       //total time of simulation (simulation units)
-const double UVPrintTime = INSERT_UVPRINTTIME;       //print out UV every # unit of time (simulation units)
-const double VelocityKnotplotPrintTime = INSERT_VELOCITYPRINTTIME;       //print out the velocity every # unit of time (simulation units)
-const double FrequentKnotplotPrintTime = INSERT_FREQUENTPRINTTIME; // print out the knot , without the velocity
-const double InitialSkipTime = INSERT_SKIPTIME;       // amout to skip before beginning the curve tracing
+extern double TTime;       //total time of simulation (simulation units)
+extern double UVPrintTime;       //print out UV every # unit of time (simulation units)
+extern double VelocityKnotplotPrintTime;       //print out the velocity every # unit of time (simulation units)
+extern double FrequentKnotplotPrintTime; // print out the knot , without the velocity
+extern double InitialSkipTime;       // amout to skip before beginning the curve tracing
+extern double CheckpointTime;       // write a checkpoint every # unit of time, to carry on from with FROM_CHECKPOINT (0 for never)
+// OPTION - how should the uv files be written? VTK_UV_FILE is the VTK of floats, uv_plot<t>.vtk. COMPRESSED_UV_FILE is uv_plot<t>.uvz, which
+// holds the same floats cut into slabs of z planes, each packed by UVCodec in parallel (see SnapshotCodec.h). FROM_UV_FILE and the
+// ShellStripper read either. UV_CODEC_SHUFFLE_LZ is lossless. UV_CODEC_ERROR_BOUNDED keeps u and v to within UVErrorBound, which packs
+// them far smaller, and ucrossv, which picks out the filament, exactly. the size of each file and how fast it was packed are printed.
+// VTI_UV_FILE is VTK XML ImageData, uv_plot<t>.vti, which ParaView reads: the same floats, appended raw in the machine's byte order, with the
+// offset of each field given at the top so it can be read on its own (see VTIFile.h). with UVFilePerField each field goes in a file of its
+// own, uv_plot<t>_u.vti and so on. FROM_UV_FILE takes either, or the _u file of the three.
+// anything but VTK_UV_FILE needs the whole grid on one MPI rank
+extern int UVFileFormat;
+extern int UVCodec;
+extern double UVErrorBound;
+extern bool UVFilePerField;
+// OPTION - should the knot be traced on a thread of its own? with AsyncAnalysis, at each knot print the grid is copied into one of
+// AnalysisQueueLength snapshots, and a separate thread traces them in turn while the solver steps on, so the tracing stops holding up the
+// update. leave it a core - run with OMP_NUM_THREADS one less than the cores there are. each snapshot is a copy of u and v, at the fine spacing
+// with AdaptiveRefinement. when none of the snapshots is free the solver waits for one, unless AnalysisDropWhenFull is set and the snapshot
+// is only for a knotplot print, which is then dropped. the ones for the velocity tracking are never dropped, since the velocities
+// need each of them. the time spent waiting is printed with the progress
+extern bool AsyncAnalysis;
+extern int AnalysisQueueLength;
+extern bool AnalysisDropWhenFull;
+// OPTION - should the uv files be written on a thread of their own? with AsyncOutput, at each uv print u, v and |grad u x grad v| are copied
+// into one of OutputQueueLength staging buffers, and a separate thread writes them out in turn, turning each into floats over OutputThreads
+// threads, so the solver only stops for the copy. each buffer takes as much memory as u, v and ucvmag, and when none is free the solver
+// waits for one, and the time it spent waiting is printed with the progress. it needs the whole grid on one MPI rank
+extern bool AsyncOutput;
+extern int OutputQueueLength;
+extern int OutputThreads;
+// OPTION - should grad u cross grad v only be worked out near the knot when tracing it? with CrossgradBand it is only worked out in the blocks
+// of CrossgradBandBlock points a side within CrossgradBandMargin of the curves traced the time before, and left at 0 everywhere else. the whole
+// grid is still done when there are no curves from before, on every CrossgradFullTraces-th trace so that new components get picked up, and
+// over again whenever the curves found near the old ones don't number the same as them. the margin has to cover how far the knot moves
+// between traces, and the few points the tracing reaches either side of it. the uv files always get the whole grid
+extern bool CrossgradBand;
+extern int CrossgradBandBlock;
+extern double CrossgradBandMargin;
+extern int CrossgradFullTraces;
+// OPTION - find each new point of the curve by Newton's method on the tricubic interpolation of |grad u x grad v|, with its gradient taken
+// from the interpolation too, rather than by the simplex minimiser with the gradient interpolated linearly from finite differences. it takes
+// fewer evaluations, but hasn't yet been checked against the default's writhe, twist and length on a traced knot, so it stays off until it has
+extern bool NewtonTracing;
+// OPTION - for ./FN_Knot --batch <manifest>, which launches a batch of simulations as processes side by side (see BatchLauncher.h). a run
+// given no thread count in the manifest gets one thread per BatchPointsPerThread grid points, up to all of them. a run that doesn't fit in the
+// threads free can have BatchSkipLimit runs from further down the manifest started ahead of it before they have to wait for it
+extern int BatchPointsPerThread;
+extern int BatchSkipLimit;
 
 // OPTION - what grid values do you want/ timestep
 //Grid points
-const double initialh = INSERT_GRIDSPACING;            //grid spacing
-const int initialNx = INSERT_NX;   //No. points in x,y and z
-const int initialNy = INSERT_NY;
-const int initialNz = INSERT_NZ;
+extern double initialh;            //grid spacing
+extern int initialNx;   //No. points in x,y and z
+extern int initialNy;
+extern int initialNz;
 
 // OPTION - do you want to read in a coarse uv file , and interpolate onto a finer grid? If so,
 // first, set the flag to 1 if you want, 0 if you dont.
 // give the # points in each dimension, which should be > initialNx - the spacing will be set by (initialNx-1)*h/(interpolatedNx-1)
-const int interpolationflag = 1 ;
-const int interpolatedNx = INSERT_INTERPOLATED_NX;   //No. points in x,y and z
-const int interpolatedNy = INSERT_INTERPOLATED_NY;
-const int interpolatedNz = INSERT_INTERPOLATED_NZ;
+extern int interpolationflag;
+extern int interpolatedNx;   //No. points in x,y and z
+extern int interpolatedNy;
+extern int interpolatedNz;
 
 
 // timestep
-const double dtime = INSERT_TIMESTEP;         //size of each time step
+extern double dtime;         //size of each time step
+
+// OPTION - which time integrator? RK4 is the classic scheme, and needs 4 grids each of ku and kv for its stages.
+// LOWSTORAGE_RK is Carpenter & Kennedy's 2N-storage scheme, which needs 1 grid each, at the cost of a fifth stage per step. it saves memory,
+// not time: each step moves 40 grids' worth of data through memory against RK4's 34, so it is slower wherever the update is limited by memory
+// bandwidth, which is usually. use it when the stage grids don't fit. both are fourth order, and explicit, so dtime has to stay below about
+// h^2/6 or the diffusion blows up.
+// IMEX_SPECTRAL splits each step into exact diffusion, done with FFTs (DCTs along reflecting axes), and RK4 on the reaction terms. it is only
+// second order, but the diffusion puts no limit on dtime, so steps several times bigger can be taken - Shell_Scripts/imexcheck measures what
+// that does to the traced length and writhe. the reaction terms still blow up beyond dtime of about 0.25. it needs one extra grid of
+// doubles, and the whole grid on a single MPI rank
+extern int TimeIntegrator;
+// OPTION - how many RK4 timesteps should the update take in each sweep of the grid? with more than 1, the grid is swept in columns of
+// TimeBlockNy x TimeBlockNz points, each taken through up to TimeBlockSteps whole steps while it is in cache, which cuts the memory traffic
+// of a step several times over at the cost of working out a margin of 4*TimeBlockSteps points around each column twice. the results are
+// bit identical to the blocked kernel, and printing and tracing still happen at exactly the same times. it needs no stage arrays beyond a
+// copy of u and v. it pays when the update is limited by memory bandwidth, as it is with every core of a node running; on a single core the
+// extra margin work can cost more than it saves. columns that split Ny and Nz evenly waste the least, and z is the contiguous direction, so
+// keep TimeBlockNz wide. 1 sweeps the grid once per stage, as usual. LOWSTORAGE_RK ignores this
+extern int TimeBlockSteps;
+extern int TimeBlockNy;
+extern int TimeBlockNz;
+// the number of RK stage grids the integrator needs, worked out once the parameters are read
+extern int NumStageArrays;
+
+// OPTION - should the RK4 update skip the parts of the grid sitting at the resting state? the grid is cut into ActiveBrickNx x ActiveBrickNy x
+// ActiveBrickNz bricks, and only bricks with a point further than ActiveTolerance from rest, and the bricks around them, are stepped. the rest
+// are left as they are. which bricks are active is looked at every ActiveCheckSteps steps, which is far quicker than a wave crosses a
+// brick, and every ActiveFullSweepSteps steps the whole grid is stepped, to check that the bricks left alone really were at rest. this only
+// applies to RK4 with TimeBlockSteps = 1
+extern bool ActiveRegionUpdate;
+extern int ActiveBrickNx;
+extern int ActiveBrickNy;
+extern int ActiveBrickNz;
+extern double ActiveTolerance;
+extern int ActiveCheckSteps;
+extern int ActiveFullSweepSteps;
+
+// OPTION - should the grid be refined around the filament? with AdaptiveRefinement, the grid above is the coarse level, and the blocks of
+// RefinePatchSize points a side where |grad u x grad v| goes above RefineThreshold, and those within RefineBuffer blocks of them, also carry a
+// patch RefinementRatio times finer, which takes RefinementRatio^2 steps for each coarse one. the patches are moved every RegridTime to follow
+// the filament, and the knot is traced at the fine spacing, so a coarse grid with patches can stand in for the whole grid at the fine spacing
+// (see Refinement.h). tracing puts the whole grid together at the fine spacing, so for that moment it takes RefinementRatio^3 times the memory
+// of u and v. it needs the whole grid on one MPI rank. Shell_Scripts/refinementcheck compares a refined run against a uniform fine one
+extern bool AdaptiveRefinement;
+extern int RefinementRatio;
+extern int RefinePatchSize;
+extern double RefineThreshold;
+extern int RefineBuffer;
+extern double RegridTime;
+
+// BUILD OPTION - what precision should u, v and the RK stages be kept in? DOUBLE_PRECISION is the default. SINGLE_PRECISION stores and sums
+// everything in float, halving the memory and memory traffic of the update. MIXED_PRECISION stores float but does the RK sums in double.
+// the grad u cross grad v fields and the curve tracing are always double. Shell_Scripts/precisioncheck compares the three on a knot
+const int Precision = DOUBLE_PRECISION;
+
+// OPTION - which uv_update kernel do you want? the blocked kernel sweeps the grid in cache sized tiles with the neighbour offsets worked out once,
+// and gives bit identical results to the reference kernel (set to 0 to use the reference kernel). LOWSTORAGE_RK always uses the blocked kernel
+extern bool BlockedUpdate;
+// tile sizes for the blocked kernel, in grid points. each tile is swept plane by plane along x, so ~3*TileNy*TileNz points of u and k should fit in L2
+extern int TileNx;
+extern int TileNy;
+extern int TileNz;
+// which instruction set the blocked kernel uses for the interior of each row. SIMD_AUTO picks the best the CPU supports when the code starts,
+// and asking for one the CPU doesn't support falls back the same way. all paths give bit identical results
+extern int SimdPath;
+// set to 1 to time the update on the grid above for each SIMD path the CPU supports, print updates/s per core, and stop
+extern bool KernelBenchmark;
+// BUILD OPTION - the number of ghost layers kept around u, v and the RK stages (see Field.h). the update and grad u cross grad v only reach 1 point away
+const int HaloWidth = 1;
+// OPTION - where should the memory behind u, v and the RK stages go? with FirstTouch each page is first written by the thread that sweeps it in
+// the update, which on a machine with several NUMA nodes (sockets) puts it in the memory next to that thread. 0 zeroes it all from the thread
+// allocating it, which puts the lot on one node, and leaves the threads on the others reading across the socket link. this only pays if the
+// threads stay put, so run with OMP_PROC_BIND=close and OMP_PLACES=cores - where the threads are is printed when the code starts.
+// FieldAlignment is the alignment of the storage in bytes, a power of two up to 4096. HugePages asks for 2MB pages on grids of more than
+// 2MB, which saves TLB misses, but then the pages are placed 2MB at a time
+extern bool FirstTouch;
+extern int FieldAlignment;
+extern bool HugePages;
+// set to 1 to time the update on the grid above with the fields placed by FirstTouch, and again with every page on the node of the master
+// thread, print the bandwidth of both, and stop
+extern bool PlacementBenchmark;
 
 // OPTION - do you want to resize the box? if so, when?
-const bool BoxResizeFlag = 0;
-const double BoxResizeTime = 1000;
+extern bool BoxResizeFlag;
+extern double BoxResizeTime;
 
 
 
 // OPTION - how big should the knot be in the box, do you want it tilted or displaced?
-//Size boundaries of knot (now autoscaled)
-const double xmax = 8*initialNx*initialh/10.0;
-const double ymax = 8*initialNy*initialh/10.0;
-const double zmax = 8*initialNz*initialh/10.0;
+//Size boundaries of knot (now autoscaled). left at 0 they are 8/10 of the box, worked out once the parameters are read
+extern double xmax;
+extern double ymax;
+extern double zmax;
 /** two rotation angles for the initial stl file, and a displacement vector for the file **/
-const double initialthetarotation = 0;
-const double initialxdisplacement = 0;
-const double initialydisplacement = 0;
-const double initialzdisplacement = 0;
+extern double initialthetarotation;
+extern double initialxdisplacement;
+extern double initialydisplacement;
+extern double initialzdisplacement;
 
-// OPTION - what system params do you want . Don't touch these usually
+// OPTION - what system params do you want . Don't touch these usually. the update kernels are compiled for the values they start off at
+// (ScrollWaveEpsilon, ScrollWaveBeta, ScrollWaveGam), and any others go through a copy of the kernels that reads them when it starts each row
 //System size parameters
-const double lambda = 21.3;                //approx wavelength
-const double epsilon = 0.3;                //parameters for F-N eqns
-const double beta = 0.7;
-const double gam = 0.5;
+extern double lambda;                //approx wavelength
+extern double epsilon;                //parameters for F-N eqns
+extern double beta;
+extern double gam;
+const double ScrollWaveEpsilon = 0.3;
+const double ScrollWaveBeta = 0.7;
+const double ScrollWaveGam = 0.5;
 
 
 #endif //FNCONSTANTS_H
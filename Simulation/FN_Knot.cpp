@@ -12,7 +12,8 @@
    The pde's used are
    dudt = (u - u^3/3 - v)/epsilon + Del^2 u
    dvdt = epsilon*(u + beta - gam v)
-   5) The update method is Runge-Kutta fourth order (update_uv) unless RK4 is set to 0, otherwise Euler forward method is used.
+   5) The update method is Runge-Kutta fourth order (uv_update), either classic RK4 or a low storage variant depending on TimeIntegrator,
+   or an IMEX scheme doing the diffusion with FFTs.
    6) A parametric curve for the knot is found at each unit T
 
 
@@ -23,6 +24,17 @@
 #include "Initialisation.h"    //contains user defined variables for the simulation, and the parameters used
 #include "TriCubicInterpolator.h"    //contains user defined variables for the simulation, and the parameters used
 #include "ReadingWriting.h"    //contains user defined variables for the simulation, and the parameters used
+#include "SimdKernels.h"
+#include "Decomposition.h"
+#include "SpectralDiffusion.h"
+#include "Refinement.h"
+#include "Memory.h"
+#include "Analysis.h"
+#include "DerivedFields.h"
+#include "BatchLauncher.h"
+#include "Parameters.h"
+#include "Checkpoint.h"
+#include "SnapshotWriter.h"
 #include <omp.h>
 #include <math.h>
 #include <string.h>
@@ -31,27 +43,120 @@
 #include <gsl/gsl_fft_real.h>
 #include <gsl/gsl_fft_halfcomplex.h>
 
-int main (void)
+int main (int argc, char** argv)
 {
+    ranks_init(&argc,&argv);
+    // the run parameters come from the parameters file and the command line (see Parameters.h), which can also ask for a batch
+    string manifest;
+    if(!read_parameters(argc,argv,manifest))
+    {
+        ranks_finalise();
+        return 1;
+    }
+    if(!manifest.empty())
+    {
+        // the runs are separate processes, each on the whole of its grid
+        if(decomposition().size > 1)
+        {
+            cout << "a batch is launched from a single process, not under mpirun\n";
+            ranks_finalise();
+            return 1;
+        }
+        const int status = launch_batch(manifest);
+        ranks_finalise();
+        return status;
+    }
+    if(!parameters_done())
+    {
+        ranks_finalise();
+        return 1;
+    }
+    cout << "parameters:\n";
+    write_parameters(cout);
     Griddata griddata;
     griddata.Nx = initialNx;
     griddata.Ny = initialNy;
     griddata.Nz = initialNz;
     griddata.h = initialh;
+    griddata.boundarytype = BoundaryType;
+    // the part of the grid this rank steps - all of it, unless we are running on several MPI ranks
+    Griddata slabgriddata = decompose(griddata);
+    const bool rankzero = (decomposition().rank == 0);
+    const bool gathered = (decomposition().size > 1);
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
     int Nz = griddata.Nz;
+    int slabNx = slabgriddata.Nx;
+    // the spectral diffusion transforms whole lines along x, so it can't work on slabs
+    if(TimeIntegrator==IMEX_SPECTRAL && decomposition().size > 1)
+    {
+        cout << "the IMEX_SPECTRAL integrator needs the whole grid on one rank\n";
+        ranks_finalise();
+        return 1;
+    }
+    // so do the refined patches, which can sit anywhere on it
+    if(AdaptiveRefinement && decomposition().size > 1)
+    {
+        cout << "AdaptiveRefinement needs the whole grid on one rank\n";
+        ranks_finalise();
+        return 1;
+    }
+    if((AsyncOutput || UVFileFormat != VTK_UV_FILE) && decomposition().size > 1)
+    {
+        cout << "AsyncOutput and uv files other than VTK_UV_FILE need the whole grid on one rank\n";
+        ranks_finalise();
+        return 1;
+    }
+    if(KernelBenchmark)
+    {
+        uv_update_benchmark(slabgriddata);
+        ranks_finalise();
+        return 0;
+    }
+    if(PlacementBenchmark)
+    {
+        placement_benchmark(slabgriddata);
+        ranks_finalise();
+        return 0;
+    }
+    // where the threads are matters for where the fields below go (see FirstTouch)
+    thread_layout_report();
     // all major allocations are here
     // the main data storage arrays, contain info associated with the grid
-    vector<double>phi(Nx*Ny*Nz);  //scalar potential
-    vector<double>u(Nx*Ny*Nz);
-    vector<double>v(Nx*Ny*Nz);
-    vector<double>ucvx(Nx*Ny*Nz);
-    vector<double>ucvy(Nx*Ny*Nz);
-    vector<double>ucvz(Nx*Ny*Nz);
-    vector<double>ucvmag(Nx*Ny*Nz);// mod(grad u cross grad v)
-    vector<double>ku(4*Nx*Ny*Nz);
-    vector<double>kv(4*Nx*Ny*Nz);
+    vector<double>phi(rankzero ? Nx*Ny*Nz : 0);  //scalar potential
+    Field<StoreType>u(slabNx,Ny,Nz,HaloWidth);   // the solver fields are kept in the precision set by Precision, with a halo of ghost points
+    Field<StoreType>v(slabNx,Ny,Nz,HaloWidth);
+    vector<double>ucvx(slabNx*Ny*Nz);
+    vector<double>ucvy(slabNx*Ny*Nz);
+    vector<double>ucvz(slabNx*Ny*Nz);
+    vector<double>ucvmag(slabNx*Ny*Nz);// mod(grad u cross grad v)
+    Field<StoreType>ku(slabNx,Ny,Nz,HaloWidth,NumStageArrays);   // RK stage storage
+    Field<StoreType>kv(slabNx,Ny,Nz,HaloWidth,NumStageArrays);
+    // initialisation and the knot tracing work on the whole grid, on rank 0. with one rank that's just the fields above, with several the
+    // slabs are gathered into these
+    Field<StoreType>wholeu,wholev;
+    vector<double>wholeucvx,wholeucvy,wholeucvz,wholeucvmag;
+    if(gathered && rankzero)
+    {
+        wholeu.resize(Nx,Ny,Nz,HaloWidth);
+        wholev.resize(Nx,Ny,Nz,HaloWidth);
+        wholeucvx.resize(Nx*Ny*Nz);
+        wholeucvy.resize(Nx*Ny*Nz);
+        wholeucvz.resize(Nx*Ny*Nz);
+        wholeucvmag.resize(Nx*Ny*Nz);
+    }
+    Field<StoreType>& traceu = gathered ? wholeu : u;
+    Field<StoreType>& tracev = gathered ? wholev : v;
+    // with AdaptiveRefinement the knot is traced on the whole grid put together at the fine spacing instead (see Refinement.h), in these
+    Field<StoreType>fineu,finev;
+    vector<double>fineucvx,fineucvy,fineucvz,fineucvmag;
+    Field<StoreType>& knotu = AdaptiveRefinement ? fineu : traceu;
+    Field<StoreType>& knotv = AdaptiveRefinement ? finev : tracev;
+    // grad u cross grad v is worked out at most once an iteration for each grid, into the arrays above (see DerivedFields.h)
+    DerivedFields slabderived(ucvx,ucvy,ucvz,ucvmag);
+    DerivedFields wholederived(wholeucvx,wholeucvy,wholeucvz,wholeucvmag);
+    DerivedFields finederived(fineucvx,fineucvy,fineucvz,fineucvmag);
+    DerivedFields& knotderived = AdaptiveRefinement ? finederived : (gathered ? wholederived : slabderived);
     // objects to hold information about the knotcurve we find, andthe surface we read in
     vector<knotcurve > knotcurves; // a structure containing some number of knot curves, each curve a list of knotpoints
     vector<knotcurve > knotcurvesold; // a structure containing some number of knot curves, each curve a list of knotpoints
@@ -64,6 +169,9 @@ int main (void)
 
     // setting things from globals
     int starttime = 0;
+    double checkpointtime = 0;
+    int StartIteration = 0;
+    int CheckpointIteration = (CheckpointTime > 0) ? (int)(CheckpointTime/dtime) : 0;
     int FrequentKnotplotPrintIteration = (int)(FrequentKnotplotPrintTime/dtime);
     int VelocityKnotplotPrintIteration = (int)(VelocityKnotplotPrintTime/dtime);
     int InitialSkipIteration = (int)(InitialSkipTime/dtime);
@@ -80,96 +188,212 @@ int main (void)
     case FROM_UV_FILE:
     {
         cout << "Reading input file...\n";
-        if(uvfile_read(u,v,ku,kv, ucvx,ucvy,ucvz,ucvmag,griddata)){return 1;}
+        // each rank reads its own slab
+        if(uvfile_read(u,v,ku,kv, ucvx,ucvy,ucvz,ucvmag,slabgriddata)){ranks_finalise(); return 1;}
+        griddata = whole_griddata(slabgriddata);
         // get the start time -  we hack this together as so:
         // the filename looks like uv_plotxxx.vtk, we want the xxx. so we find the t, find the ., and grab everyting between
         string number = B_filename.substr(B_filename.find('t')+1,B_filename.find('.')-B_filename.find('t')-1);
         starttime = atoi(number.c_str());
         break;
     }
+    case FROM_CHECKPOINT:
+    {
+        cout << "Reading checkpoint...\n";
+        // each rank maps in its own slab, and rank 0 the knot tracing's state as well
+        if(!read_checkpoint(u,v,checkpointtime,StartIteration,knotcurves,knotcurvesold,slabgriddata)){ranks_finalise(); return 1;}
+        break;
+    }
     case FROM_FUNCTION:
     {
+        if(!rankzero) break;
         phi_calc_manual(phi,griddata);
         cout << "Calculating u and v...\n";
-        uv_initialise(phi,u,v,griddata);
+        uv_initialise(phi,traceu,tracev,griddata);
         break;
     }
     case FROM_SURFACE_FILE:
     {
+        if(!rankzero) break;
         init_from_surface_file(knotsurface);
         phi_calc_surface(phi,knotsurface,griddata);
         cout << "Calculating u and v...\n";
-        uv_initialise(phi,u,v,griddata);
+        uv_initialise(phi,traceu,tracev,griddata);
         break;
     }
     case FROM_CURVE_FILE:
     {
+        if(!rankzero) break;
         Link Curve;
         InitialiseFromFile(Curve);
         cout << "calculating the solid angle..." << endl;
         phi_calc_curve(phi,Curve,griddata);
         cout << "Calculating u and v...\n";
-        uv_initialise(phi,u,v,griddata);
+        uv_initialise(phi,traceu,tracev,griddata);
     }
 
     }
+    // everything but a restart set up the whole grid on rank 0, and everyone takes their slab of it
+    if(option != FROM_UV_FILE && option != FROM_CHECKPOINT)
+    {
+        scatter_slabs(traceu,u);
+        scatter_slabs(tracev,v);
+    }
+    // from here on uv_update keeps the halos filled
+    fill_slab_halo(u,griddata.boundarytype);
+    fill_slab_halo(v,griddata.boundarytype);
+
+    // the kernels for our boundary condition - this is the only place it gets looked at
+    const BoundaryKernels solver = boundary_kernels(griddata.boundarytype);
+    // and the grid the knot is traced on
+    const Griddata knotgriddata = AdaptiveRefinement ? refined_griddata(griddata) : griddata;
+    // with AsyncAnalysis the tracing happens on a thread of its own, which keeps its own copies of everything it needs
+    if(rankzero && AsyncAnalysis) analysis_start(solver,knotgriddata,knotcurves,knotcurvesold);
+    // and with AsyncOutput the uv files are written on another
+    if(AsyncOutput) snapshot_writer_start();
+    if(AdaptiveRefinement && !AsyncAnalysis)
+    {
+        const int knotpoints = knotgriddata.Nx*knotgriddata.Ny*knotgriddata.Nz;
+        fineucvx.resize(knotpoints);
+        fineucvy.resize(knotpoints);
+        fineucvz.resize(knotpoints);
+        fineucvmag.resize(knotpoints);
+    }
 
     // UPDATE
     cout << "Updating u and v...\n";
 
     double CurrentTime = starttime;
     int CurrentIteration = (int)(CurrentTime/dtime);
-#pragma omp parallel default(none) shared (u,v,ku,kv,ucvx, CurrentIteration,InitialSkipIteration,FrequentKnotplotPrintIteration,UVPrintIteration,VelocityKnotplotPrintIteration,ucvy, ucvz,ucvmag,cout, rawtime, starttime, timeinfo,CurrentTime, knotcurves,knotcurvesold,minimizerstate,griddata)
+    // a checkpoint knows exactly which iteration and time it was taken at
+    if(option == FROM_CHECKPOINT)
     {
-        while(CurrentTime <= TTime)
+        CurrentTime = checkpointtime;
+        CurrentIteration = StartIteration;
+    }
+    StartIteration = CurrentIteration;
+    int StepsToTake = 1;
+#pragma omp parallel default(none) shared (u,v,ku,kv,ucvx, CurrentIteration,StepsToTake,InitialSkipIteration,FrequentKnotplotPrintIteration,UVPrintIteration,VelocityKnotplotPrintIteration,ucvy, ucvz,ucvmag,cout, rawtime, starttime, timeinfo,CurrentTime, knotcurves,knotcurvesold,minimizerstate,griddata,slabgriddata,knotgriddata,solver,rankzero,traceu,tracev,knotu,knotv,slabderived,knotderived,StartIteration,CheckpointIteration,TTime,dtime,AdaptiveRefinement,AsyncAnalysis,AsyncOutput,ActiveRegionUpdate,TimeIntegrator,TimeBlockSteps)
+    {
+        while(true)
         {
+            // every thread has to have looked at CurrentTime before the single below moves it on, or a slow one can leave the loop a step
+            // early and leave the rest waiting for it
+            const bool running = (CurrentTime <= TTime);
+#pragma omp barrier
+            if(!running) break;
 #pragma omp single
             {
+                // a checkpoint comes before anything is printed or traced at this iteration, so that a run carried on from it does those just
+                // as this one does. there is no point writing one at the iteration the run started at
+                if(CheckpointIteration > 0 && CurrentIteration%CheckpointIteration==0 && CurrentIteration != StartIteration)
+                {
+                    gather_slabs(u,traceu);
+                    gather_slabs(v,tracev);
+                    if(rankzero && AsyncAnalysis) analysis_curves(knotcurves,knotcurvesold);
+                    if(rankzero) write_checkpoint(traceu,tracev,CurrentTime,CurrentIteration,knotcurves,knotcurvesold,griddata);
+                }
                 // its useful to have an oppurtunity to print the knotcurve, without doing the velocity tracking, whihc doesnt work too well if we go more frequenclty
                 // than a cycle
-                if( ( CurrentIteration >= InitialSkipIteration ) && ( CurrentIteration%FrequentKnotplotPrintIteration==0) )
+                const bool frequent = ( CurrentIteration >= InitialSkipIteration ) && ( CurrentIteration%FrequentKnotplotPrintIteration==0);
+                // run the curve tracing, and find the velocity of the one we previously stored, then print that previous one
+                const bool velocity = ( CurrentIteration > InitialSkipIteration ) && ( CurrentIteration%VelocityKnotplotPrintIteration==0);
+                if(frequent || velocity)
                 {
-                    crossgrad_calc(u,v,ucvx,ucvy,ucvz,ucvmag,griddata); //find Grad u cross Grad v
-                    find_knot_properties(ucvx,ucvy,ucvz,ucvmag,u,knotcurves,CurrentTime,minimizerstate ,griddata);      //find knot curve and twist and writhe
-                    print_knot(CurrentTime, knotcurves, griddata);
+                    gather_slabs(u,traceu);
+                    gather_slabs(v,tracev);
+                    if(AdaptiveRefinement) refinement_composite(u,v,knotu,knotv,griddata);
+                    if(rankzero && AsyncAnalysis) analysis_submit(knotu,knotv,CurrentTime,CurrentIteration,frequent,velocity);
+                    else if(rankzero) trace_knot(knotu,knotv,knotderived,knotcurves,knotcurvesold,minimizerstate,CurrentTime,CurrentIteration,frequent,velocity,solver,knotgriddata);
                 }
-
-                // run the curve tracing, and find the velocity of the one we previously stored, then print that previous one
-                if( ( CurrentIteration > InitialSkipIteration ) && ( CurrentIteration%VelocityKnotplotPrintIteration==0) )
+                if(rankzero && velocity)
                 {
-                    crossgrad_calc(u,v,ucvx,ucvy,ucvz,ucvmag,griddata); //find Grad u cross Grad v
-
-                    find_knot_properties(ucvx,ucvy,ucvz,ucvmag,u,knotcurves,CurrentTime,minimizerstate ,griddata);      //find knot curve and twist and writhe
-                    if(!knotcurvesold.empty())
-                    {
-                        find_knot_velocity(knotcurves,knotcurvesold,griddata,VelocityKnotplotPrintTime);
-                        print_knot(CurrentTime - VelocityKnotplotPrintTime , knotcurvesold, griddata);
-                    }
-                    knotcurvesold = knotcurves;
-
                     // at this point, let people know how things are going
                     cout << "T = " << CurrentTime << endl;
                     time (&rawtime);
                     timeinfo = localtime (&rawtime);
                     cout << "current time \t" << asctime(timeinfo) << "\n";
+                    cout << "update bandwidth \t" << uv_update_bandwidth(slabgriddata) << " GB/s\n";
+                    if(ActiveRegionUpdate && TimeIntegrator==RK4 && TimeBlockSteps == 1) cout << "part of the grid stepped \t" << uv_update_active_fraction() << "\n";
+                    if(AdaptiveRefinement) cout << "points stepped against the grid at the fine spacing \t" << refinement_point_fraction(griddata) << "\n";
+                    long derivedmisses = slabderived.misses;
+                    long derivedhits = slabderived.hits;
+                    if(&knotderived != &slabderived)
+                    {
+                        derivedmisses += knotderived.misses;
+                        derivedhits += knotderived.hits;
+                    }
+                    cout << "grad u cross grad v worked out \t" << derivedmisses << " times, reused \t" << derivedhits << " times\n";
+                    if(AsyncOutput) cout << "time spent waiting on the uv writer \t" << snapshot_writer_wait_seconds() << " s\n";
+                    if(AsyncAnalysis) cout << "time spent waiting on the analysis \t" << analysis_wait_seconds() << " s, snapshots dropped \t" << analysis_dropped() << "\n";
                 }
 
                 // print the UV, and ucrossv data
                 if(CurrentIteration%UVPrintIteration==0)
                 {
-                    crossgrad_calc(u,v,ucvx,ucvy,ucvz,ucvmag,griddata); //find Grad u cross Grad v
-                    print_uv(u,v,ucvx,ucvy,ucvz,ucvmag,CurrentTime,griddata);
+                    slabderived.crossgrad(u,v,CurrentIteration,slabgriddata); //find Grad u cross Grad v
+                    if(AsyncOutput) snapshot_writer_submit(u,v,ucvmag,CurrentTime,slabgriddata);
+                    else print_uv(u,v,ucvx,ucvy,ucvz,ucvmag,CurrentTime,slabgriddata);    // each rank writes its own slab
                 }
                 //though its useful to have a double time, we want to be careful to avoid double round off accumulation in the timer
-                CurrentIteration++;
-                CurrentTime  = ((double)(CurrentIteration) * dtime);
+                // step on to the next iteration that prints or traces anything, so a temporally blocked update can take the steps in between in one go
+                StepsToTake = 0;
+                do
+                {
+                    CurrentIteration++;
+                    CurrentTime  = ((double)(CurrentIteration) * dtime);
+                    StepsToTake++;
+                }
+                while(CurrentTime <= TTime && !output_iteration(CurrentIteration,InitialSkipIteration,FrequentKnotplotPrintIteration,VelocityKnotplotPrintIteration,UVPrintIteration,CheckpointIteration));
             }
-            uv_update(u,v,ku,kv,griddata);
+            if(AdaptiveRefinement) refinement_update(u,v,ku,kv,StepsToTake,solver,slabgriddata);
+            else solver.uv_update(u,v,ku,kv,StepsToTake,slabgriddata);
         }
     }
+    if(rankzero && AsyncAnalysis) analysis_finish();
+    if(AsyncOutput) snapshot_writer_finish();
+    ranks_finalise();
     return 0;
 }
 
+// trace the knot, with grad u cross grad v only worked out near the curves traced last time if CrossgradBand allows it. if that finds a
+// different number of components, something has appeared or gone away, and the whole grid is gone over again to be sure
+static void trace_curves(Field<StoreType>&u, Field<StoreType>&v, DerivedFields& derived, vector<knotcurve>& knotcurves, gsl_multimin_fminimizer* minimizerstate, double t, int iteration, const BoundaryKernels& solver, const Griddata& griddata)
+{
+    const size_t components = knotcurves.size();
+    const bool partial = derived.crossgrad_near(u,v,knotcurves,iteration,griddata); //find Grad u cross Grad v
+    solver.find_knot_properties(derived.ucvx,derived.ucvy,derived.ucvz,derived.ucvmag,u,knotcurves,t,minimizerstate ,griddata);      //find knot curve and twist and writhe
+    if(partial && knotcurves.size() != components)
+    {
+        derived.crossgrad(u,v,iteration,griddata);
+        solver.find_knot_properties(derived.ucvx,derived.ucvy,derived.ucvz,derived.ucvmag,u,knotcurves,t,minimizerstate ,griddata);
+    }
+}
+
+void trace_knot(Field<StoreType>&u, Field<StoreType>&v, DerivedFields& derived, vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold, gsl_multimin_fminimizer* minimizerstate, double t, int iteration, bool frequent, bool velocity, const BoundaryKernels& solver, const Griddata& griddata)
+{
+    if(frequent)
+    {
+        trace_curves(u,v,derived,knotcurves,minimizerstate,t,iteration,solver,griddata);
+        print_knot(t, knotcurves, griddata);
+    }
+    if(velocity)
+    {
+        trace_curves(u,v,derived,knotcurves,minimizerstate,t,iteration,solver,griddata);
+        if(!knotcurvesold.empty())
+        {
+            find_knot_velocity(knotcurves,knotcurvesold,griddata,VelocityKnotplotPrintTime);
+            print_knot(t - VelocityKnotplotPrintTime , knotcurvesold, griddata);
+        }
+        knotcurvesold = knotcurves;
+    }
+}
+
+bool output_iteration(int n, int skip, int frequentprint, int velocityprint, int uvprint, int checkpointprint)
+{
+    return ( n >= skip && n%frequentprint==0 ) || ( n > skip && n%velocityprint==0 ) || ( n%uvprint==0 ) || ( checkpointprint > 0 && n%checkpointprint==0 );
+}
+
 void scalefunction(double *scale, double *midpoint, double maxxin, double minxin, double maxyin, double minyin, double maxzin, double minzin)
 {
     bool nonzeroheight[3];  //marker: true if this dimension has non zero height in stl file
@@ -183,7 +407,7 @@ void scalefunction(double *scale, double *midpoint, double maxxin, double minxin
     midpoint[0] = 0.5*(maxxin+minxin);
     midpoint[1] = 0.5*(maxyin+minyin);
     midpoint[2] = 0.5*(maxzin+minzin);
-#if PRESERVE_RATIOS
+    if(!PreserveRatios) return;
     double minscale=1000000000;
     int imin=3;
     for(int i = 0;i<3;i++)   //find minimum scale factor
@@ -198,62 +422,86 @@ void scalefunction(double *scale, double *midpoint, double maxxin, double minxin
     {
         for(int i = 0;i<3;i++) scale[i] = scale[imin];
     }
-#endif
 }
 
-void uv_initialise(vector<double>&phi, vector<double>&u, vector<double>&v, const Griddata& griddata)
+template<typename Store>
+void uv_initialise(vector<double>&phi, Field<Store>&u, Field<Store>&v, const Griddata& griddata)
 {
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
     int Nz = griddata.Nz;
-    int n;
+    int i,j,k,n;
 
-    for(n=0; n<Nx*Ny*Nz; n++)
+    for(i=0;i<Nx;i++)
     {
-        u[n] = (2*cos(phi[n]) - 0.4);
-        v[n] = (sin(phi[n]) - 0.4);
+        for(j=0; j<Ny; j++)
+        {
+            for(k=0; k<Nz; k++)
+            {
+                n = pt(i,j,k,griddata);
+                u(i,j,k) = (2*cos(phi[n]) - 0.4);
+                v(i,j,k) = (sin(phi[n]) - 0.4);
+            }
+        }
     }
 }
 
-void crossgrad_calc( vector<double>&u, vector<double>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag,const Griddata& griddata)
+template<typename Store>
+void crossgrad_block( Field<Store>&u, Field<Store>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, int imin, int imax, int jmin, int jmax, int kmin, int kmax, const Griddata& griddata)
 {
-    int Nx = griddata.Nx;
-    int Ny = griddata.Ny;
-    int Nz = griddata.Nz;
-    double h = griddata.h;
-    int i,j,k,n,kup,kdown;
-    double dxu,dyu,dzu,dxv,dyv,dzv;
-    for(i=0;i<Nx;i++)
+    const double h = griddata.h;
+    const int xstride = u.xstride;
+    const int ystride = u.ystride;
+    // the neighbours on the far side of the boundaries come out of the halos uv_update leaves filled, so every row is the same, and the loop
+    // along it vectorises
+    for(int i=imin;i<imax;i++)
     {
-        for(j=0; j<Ny; j++)
+        for(int j=jmin; j<jmax; j++)
         {
-            for(k=0; k<Nz; k++)   //Central difference
+            const Store* U = u.origin() + u.index(i,j,0);
+            const Store* V = v.origin() + v.index(i,j,0);
+            const int n0 = pt(i,j,0,griddata);
+            double* cx = ucvx.data() + n0;
+            double* cy = ucvy.data() + n0;
+            double* cz = ucvz.data() + n0;
+            double* cmag = ucvmag.data() + n0;
+#pragma omp simd
+            for(int k=kmin; k<kmax; k++)   //Central difference
             {
-                kup = gridinc(k,1,Nz,2);
-                kdown = gridinc(k,-1,Nz,2);
-                dxu = 0.5*(u[pt(gridinc(i,1,Nx,0),j,k,griddata)]-u[pt(gridinc(i,-1,Nx,0),j,k,griddata)])/h;
-                dxv = 0.5*(v[pt(gridinc(i,1,Nx,0),j,k,griddata)]-v[pt(gridinc(i,-1,Nx,0),j,k,griddata)])/h;
-                dyu = 0.5*(u[pt(i,gridinc(j,1,Ny,1),k,griddata)]-u[pt(i,gridinc(j,-1,Ny,1),k,griddata)])/h;
-                dyv = 0.5*(v[pt(i,gridinc(j,1,Ny,1),k,griddata)]-v[pt(i,gridinc(j,-1,Ny,1),k,griddata)])/h;
-                dzu = 0.5*(u[pt(i,j,kup,griddata)]-u[pt(i,j,kdown,griddata)])/h;
-                dzv = 0.5*(v[pt(i,j,kup,griddata)]-v[pt(i,j,kdown,griddata)])/h;
-                //          dxu =(-u[pt(gridinc(i,2,Nx,0),j,k,griddata)]+8*u[pt(gridinc(i,1,Nx,0),j,k,griddata)]-8*u[pt(gridinc(i,-1,Nx,0),j,k,griddata)]+u[pt(gridinc(i,-2,Nx,0),j,k,griddata)])/(12*h);
-                //          dxv =(-v[pt(gridinc(i,2,Nx,0),j,k,griddata)]+8*v[pt(gridinc(i,1,Nx,0),j,k,griddata)]-8*v[pt(gridinc(i,-1,Nx,0),j,k,griddata)]+v[pt(gridinc(i,-2,Nx,0),j,k,griddata)])/(12*h);
-                //          dyu =(-u[pt(gridinc(j,2,Ny,1),j,k,griddata)]+8*u[pt(gridinc(j,1,Ny,1),j,k,griddata)]-8*u[pt(gridinc(j,-1,Ny,1),j,k,griddata)]+u[pt(gridinc(j,-2,Ny,1),j,k,griddata)])/(12*h);
-                //          dyv =(-v[pt(gridinc(j,2,Ny,1),j,k,griddata)]+8*v[pt(gridinc(j,1,Ny,1),j,k,griddata)]-8*v[pt(gridinc(j,-1,Ny,1),j,k,griddata)]+v[pt(gridinc(j,-2,Ny,1),j,k,griddata)])/(12*h);
-                //          dzu =(-u[pt(gridinc(k,2,Nz,2),j,k,griddata)]+8*u[pt(gridinc(k,1,Nz,2),j,k,griddata)]-8*u[pt(gridinc(k,-1,Nz,2),j,k,griddata)]+u[pt(gridinc(k,-2,Nz,2),j,k,griddata)])/(12*h);
-                //          dzv =(-v[pt(gridinc(k,2,Nz,2),j,k,griddata)]+8*v[pt(gridinc(k,1,Nz,2),j,k,griddata)]-8*v[pt(gridinc(k,-1,Nz,2),j,k,griddata)]+v[pt(gridinc(k,-2,Nz,2),j,k,griddata)])/(12*h);
-                n = pt(i,j,k,griddata);
-                ucvx[n] = dyu*dzv - dzu*dyv;
-                ucvy[n] = dzu*dxv - dxu*dzv;    //Grad u cross Grad v
-                ucvz[n] = dxu*dyv - dyu*dxv;
-                ucvmag[n] = sqrt(ucvx[n]*ucvx[n] + ucvy[n]*ucvy[n] + ucvz[n]*ucvz[n]);
+                const double dxu = 0.5*(U[k+xstride]-U[k-xstride])/h;
+                const double dxv = 0.5*(V[k+xstride]-V[k-xstride])/h;
+                const double dyu = 0.5*(U[k+ystride]-U[k-ystride])/h;
+                const double dyv = 0.5*(V[k+ystride]-V[k-ystride])/h;
+                const double dzu = 0.5*(U[k+1]-U[k-1])/h;
+                const double dzv = 0.5*(V[k+1]-V[k-1])/h;
+                // fourth order, which needs HaloWidth 2
+                //          dxu =(-U[k+2*xstride]+8*U[k+xstride]-8*U[k-xstride]+U[k-2*xstride])/(12*h);
+                //          and the same along y and z, and for v
+                const double ucx = dyu*dzv - dzu*dyv;
+                const double ucy = dzu*dxv - dxu*dzv;    //Grad u cross Grad v
+                const double ucz = dxu*dyv - dyu*dxv;
+                cx[k] = ucx;
+                cy[k] = ucy;
+                cz[k] = ucz;
+                cmag[k] = sqrt(ucx*ucx + ucy*ucy + ucz*ucz);
             }
         }
     }
 }
 
-void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>& ucvmag,vector<double>&u,vector<knotcurve>& knotcurves,double t, gsl_multimin_fminimizer* minimizerstate, const Griddata& griddata)
+template<typename Store>
+void crossgrad_calc( Field<Store>&u, Field<Store>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag,const Griddata& griddata)
+{
+    // one task per plane. from inside omp single the rest of the team, waiting at the end of it, picks them up. arguments passed by reference
+    // would be firstprivate in the tasks - copied - without the shared clause
+#pragma omp taskloop grainsize(1) shared(u,v,ucvx,ucvy,ucvz,ucvmag,griddata)
+    for(int i=0;i<griddata.Nx;i++) crossgrad_block(u,v,ucvx,ucvy,ucvz,ucvmag,i,i+1,0,griddata.Ny,0,griddata.Nz,griddata);
+}
+
+ComponentTracking componenttracking = {true};
+
+template<typename Store, BoundaryCondition BC>
+void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>& ucvmag,Field<Store>&u,vector<knotcurve>& knotcurves,double t, gsl_multimin_fminimizer* minimizerstate, const Griddata& griddata)
 {
     // first thing, clear the knotcurve object before we begin writing a new one
     knotcurves.clear(); //empty vector with knot curve points
@@ -322,8 +570,8 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
                 modidwn = circularmod(idwn,Nx);
                 modjdwn = circularmod(jdwn,Ny);
                 modkdwn = circularmod(kdwn,Nz);
-                if((BoundaryType==ALLREFLECTING) && (idwn<0 || jdwn<0 || kdwn<0 || idwn > Nx-1 || jdwn > Ny-1 || kdwn > Nz-1)) break;
-                if((BoundaryType==ZPERIODIC) && (idwn<0 || jdwn<0 || idwn > Nx-1 || jdwn > Ny-1 )) break;
+                if((BC==ALLREFLECTING) && (idwn<0 || jdwn<0 || kdwn<0 || idwn > Nx-1 || jdwn > Ny-1 || kdwn > Nz-1)) break;
+                if((BC==ZPERIODIC) && (idwn<0 || jdwn<0 || idwn > Nx-1 || jdwn > Ny-1 )) break;
                 ucvxs=0;
                 ucvys=0;
                 ucvzs=0;
@@ -338,9 +586,9 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
                     jinc = (m/2)%2;
                     kinc = (m/4)%2;
                     /*Loop over nearest points*/
-                    i = gridinc(modidwn, iinc, Nx,0);
-                    j = gridinc(modjdwn, jinc, Ny,1);
-                    k = gridinc(modkdwn,kinc, Nz,2);
+                    i = gridinc<BC>(modidwn, iinc, Nx,0);
+                    j = gridinc<BC>(modjdwn, jinc, Ny,1);
+                    k = gridinc<BC>(modkdwn,kinc, Nz,2);
                     prefactor = (1-iinc + pow(-1,1+iinc)*xd)*(1-jinc + pow(-1,1+jinc)*yd)*(1-kinc + pow(-1,1+kinc)*zd);
                     /*interpolate grad u x grad v over nearest points*/
                     ucvxs += prefactor*ucvx[pt(i,j,k,griddata)];
@@ -365,31 +613,43 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
                 modjdwn = circularmod(jdwn,Ny);
                 modkdwn = circularmod(kdwn,Nz);
                 // again, bear in mind these numbers can be into the "ghost" grids
-                if((BoundaryType==ALLREFLECTING) && (idwn<0 || jdwn<0 || kdwn<0 || idwn > Nx-1 || jdwn > Ny-1 || kdwn > Nz-1)) break;
-                if((BoundaryType==ZPERIODIC) && (idwn<0 || jdwn<0 || idwn > Nx-1 || jdwn > Ny-1 )) break;
-                graducvx=0;
-                graducvy=0;
-                graducvz=0;
-                /*curve to gridpoint down distance*/
-                xd = (testx - x(idwn,griddata))/h;
-                yd = (testy - y(jdwn,griddata))/h;
-                zd = (testz - z(kdwn,griddata))/h;
-                for(m=0;m<8;m++)  //linear interpolation from 8 nearest neighbours
+                if((BC==ALLREFLECTING) && (idwn<0 || jdwn<0 || kdwn<0 || idwn > Nx-1 || jdwn > Ny-1 || kdwn > Nz-1)) break;
+                if((BC==ZPERIODIC) && (idwn<0 || jdwn<0 || idwn > Nx-1 || jdwn > Ny-1 )) break;
+                if(NewtonTracing)
                 {
-                    /* Work out increments*/
-                    iinc = m%2;
-                    jinc = (m/2)%2;
-                    kinc = (m/4)%2;
-                    /*Loop over nearest points*/
-                    i = gridinc(modidwn, iinc, Nx,0);
-                    j = gridinc(modjdwn, jinc, Ny,1);
-                    k = gridinc(modkdwn,kinc, Nz,2);
-                    prefactor = (1-iinc + pow(-1,1+iinc)*xd)*(1-jinc + pow(-1,1+jinc)*yd)*(1-kinc + pow(-1,1+kinc)*zd);
-                    /*interpolate gradients of |grad u x grad v|*/
-                    graducvx += prefactor*(sqrt(ucvx[pt(gridinc(i,1,Nx,0),j,k,griddata)]*ucvx[pt(gridinc(i,1,Nx,0),j,k,griddata)] + ucvy[pt(gridinc(i,1,Nx,0),j,k,griddata)]*ucvy[pt(gridinc(i,1,Nx,0),j,k,griddata)] + ucvz[pt(gridinc(i,1,Nx,0),j,k,griddata)]*ucvz[pt(gridinc(i,1,Nx,0),j,k,griddata)]) - sqrt(ucvx[pt(gridinc(i,-1,Nx,0),j,k,griddata)]*ucvx[pt(gridinc(i,-1,Nx,0),j,k,griddata)] + ucvy[pt(gridinc(i,-1,Nx,0),j,k,griddata)]*ucvy[pt(gridinc(i,-1,Nx,0),j,k,griddata)] + ucvz[pt(gridinc(i,-1,Nx,0),j,k,griddata)]*ucvz[pt(gridinc(i,-1,Nx,0),j,k,griddata)]))/(2*h);
-                    graducvy += prefactor*(sqrt(ucvx[pt(i,gridinc(j,1,Ny,1),k,griddata)]*ucvx[pt(i,gridinc(j,1,Ny,1),k,griddata)] + ucvy[pt(i,gridinc(j,1,Ny,1),k,griddata)]*ucvy[pt(i,gridinc(j,1,Ny,1),k,griddata)] + ucvz[pt(i,gridinc(j,1,Ny,1),k,griddata)]*ucvz[pt(i,gridinc(j,1,Ny,1),k,griddata)]) - sqrt(ucvx[pt(i,gridinc(j,-1,Ny,1),k,griddata)]*ucvx[pt(i,gridinc(j,-1,Ny,1),k,griddata)] + ucvy[pt(i,gridinc(j,-1,Ny,1),k,griddata)]*ucvy[pt(i,gridinc(j,-1,Ny,1),k,griddata)] + ucvz[pt(i,gridinc(j,-1,Ny,1),k,griddata)]*ucvz[pt(i,gridinc(j,-1,Ny,1),k,griddata)]))/(2*h);
-                    graducvz += prefactor*(sqrt(ucvx[pt(i,j,gridinc(k,1,Nz,2),griddata)]*ucvx[pt(i,j,gridinc(k,1,Nz,2),griddata)] + ucvy[pt(i,j,gridinc(k,1,Nz,2),griddata)]*ucvy[pt(i,j,gridinc(k,1,Nz,2),griddata)] + ucvz[pt(i,j,gridinc(k,1,Nz,2),griddata)]*ucvz[pt(i,j,gridinc(k,1,Nz,2),griddata)]) - sqrt(ucvx[pt(i,j,gridinc(k,-1,Nz,2),griddata)]*ucvx[pt(i,j,gridinc(k,-1,Nz,2),griddata)] + ucvy[pt(i,j,gridinc(k,-1,Nz,2),griddata)]*ucvy[pt(i,j,gridinc(k,-1,Nz,2),griddata)] + ucvz[pt(i,j,gridinc(k,-1,Nz,2),griddata)]*ucvz[pt(i,j,gridinc(k,-1,Nz,2),griddata)]))/(2*h);
+                    // from the same interpolation of |grad u x grad v| the maximum is then found on
+                    double graducv[3], hessianucv[3][3];
+                    interpolateducvmag(testx,testy,testz,graducv,hessianucv);
+                    graducvx = graducv[0];
+                    graducvy = graducv[1];
+                    graducvz = graducv[2];
+                }
+                else
+                {
+                    graducvx=0;
+                    graducvy=0;
+                    graducvz=0;
+                    /*curve to gridpoint down distance*/
+                    xd = (testx - x(idwn,griddata))/h;
+                    yd = (testy - y(jdwn,griddata))/h;
+                    zd = (testz - z(kdwn,griddata))/h;
+                    for(m=0;m<8;m++)  //linear interpolation from 8 nearest neighbours
+                    {
+                        /* Work out increments*/
+                        iinc = m%2;
+                        jinc = (m/2)%2;
+                        kinc = (m/4)%2;
+                        /*Loop over nearest points*/
+                        i = gridinc<BC>(modidwn, iinc, Nx,0);
+                        j = gridinc<BC>(modjdwn, jinc, Ny,1);
+                        k = gridinc<BC>(modkdwn,kinc, Nz,2);
+                        prefactor = (1-iinc + pow(-1,1+iinc)*xd)*(1-jinc + pow(-1,1+jinc)*yd)*(1-kinc + pow(-1,1+kinc)*zd);
+                        /*interpolate gradients of |grad u x grad v|*/
+                        graducvx += prefactor*(sqrt(ucvx[pt(gridinc<BC>(i,1,Nx,0),j,k,griddata)]*ucvx[pt(gridinc<BC>(i,1,Nx,0),j,k,griddata)] + ucvy[pt(gridinc<BC>(i,1,Nx,0),j,k,griddata)]*ucvy[pt(gridinc<BC>(i,1,Nx,0),j,k,griddata)] + ucvz[pt(gridinc<BC>(i,1,Nx,0),j,k,griddata)]*ucvz[pt(gridinc<BC>(i,1,Nx,0),j,k,griddata)]) - sqrt(ucvx[pt(gridinc<BC>(i,-1,Nx,0),j,k,griddata)]*ucvx[pt(gridinc<BC>(i,-1,Nx,0),j,k,griddata)] + ucvy[pt(gridinc<BC>(i,-1,Nx,0),j,k,griddata)]*ucvy[pt(gridinc<BC>(i,-1,Nx,0),j,k,griddata)] + ucvz[pt(gridinc<BC>(i,-1,Nx,0),j,k,griddata)]*ucvz[pt(gridinc<BC>(i,-1,Nx,0),j,k,griddata)]))/(2*h);
+                        graducvy += prefactor*(sqrt(ucvx[pt(i,gridinc<BC>(j,1,Ny,1),k,griddata)]*ucvx[pt(i,gridinc<BC>(j,1,Ny,1),k,griddata)] + ucvy[pt(i,gridinc<BC>(j,1,Ny,1),k,griddata)]*ucvy[pt(i,gridinc<BC>(j,1,Ny,1),k,griddata)] + ucvz[pt(i,gridinc<BC>(j,1,Ny,1),k,griddata)]*ucvz[pt(i,gridinc<BC>(j,1,Ny,1),k,griddata)]) - sqrt(ucvx[pt(i,gridinc<BC>(j,-1,Ny,1),k,griddata)]*ucvx[pt(i,gridinc<BC>(j,-1,Ny,1),k,griddata)] + ucvy[pt(i,gridinc<BC>(j,-1,Ny,1),k,griddata)]*ucvy[pt(i,gridinc<BC>(j,-1,Ny,1),k,griddata)] + ucvz[pt(i,gridinc<BC>(j,-1,Ny,1),k,griddata)]*ucvz[pt(i,gridinc<BC>(j,-1,Ny,1),k,griddata)]))/(2*h);
+                        graducvz += prefactor*(sqrt(ucvx[pt(i,j,gridinc<BC>(k,1,Nz,2),griddata)]*ucvx[pt(i,j,gridinc<BC>(k,1,Nz,2),griddata)] + ucvy[pt(i,j,gridinc<BC>(k,1,Nz,2),griddata)]*ucvy[pt(i,j,gridinc<BC>(k,1,Nz,2),griddata)] + ucvz[pt(i,j,gridinc<BC>(k,1,Nz,2),griddata)]*ucvz[pt(i,j,gridinc<BC>(k,1,Nz,2),griddata)]) - sqrt(ucvx[pt(i,j,gridinc<BC>(k,-1,Nz,2),griddata)]*ucvx[pt(i,j,gridinc<BC>(k,-1,Nz,2),griddata)] + ucvy[pt(i,j,gridinc<BC>(k,-1,Nz,2),griddata)]*ucvy[pt(i,j,gridinc<BC>(k,-1,Nz,2),griddata)] + ucvz[pt(i,j,gridinc<BC>(k,-1,Nz,2),griddata)]*ucvz[pt(i,j,gridinc<BC>(k,-1,Nz,2),griddata)]))/(2*h);
 
+                    }
                 }
                 knotcurves[c].knotcurve.push_back(knotpoint());
                 // one of the vectors in the plane we wish to perfrom our minimisation in
@@ -420,44 +680,52 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
                 // take a cross product to get the other vector in the plane
                 gsl_vector* b = gsl_vector_alloc (3);
                 cross_product(f,ucv,b);
-                // initial conditions
-                gsl_vector* minimum = gsl_vector_alloc (2);
-                gsl_vector_set (minimum, 0, 0);
-                gsl_vector_set (minimum, 1, 0);
-                struct parameters params; struct parameters* pparams = &params;
-                pparams->ucvmag=&interpolateducvmag;
-                pparams->v = v; pparams->f = f;pparams->b=b;
-                pparams->mygriddata = griddata;
-                // some initial values
-                gsl_multimin_function F;
-                F.n=2;
-                F.f = &my_f;
-                F.params = (void*) pparams;
-                gsl_vector* stepsize = gsl_vector_alloc (2);
-                gsl_vector_set (stepsize, 0, lambda/(8*M_PI));
-                gsl_vector_set (stepsize, 1, lambda/(8*M_PI));
-                gsl_multimin_fminimizer_set (minimizerstate, &F, minimum, stepsize);
-
-                int iter=0;
-                int status =0;
-                double minimizersize=0;
-                do
+                // the maximum of |grad u x grad v| in this plane, by the simplex minimiser, or with NewtonTracing by Newton's method on the
+                // interpolation, falling back on the simplex if that doesn't settle
+                double planestep[2];
+                if(!NewtonTracing || !plane_maximum(interpolateducvmag,v,f,b,lambda/(8*M_PI),1e-4,planestep))
                 {
-                    iter++;
-                    status = gsl_multimin_fminimizer_iterate(minimizerstate);
+                    // initial conditions
+                    gsl_vector* minimum = gsl_vector_alloc (2);
+                    gsl_vector_set (minimum, 0, 0);
+                    gsl_vector_set (minimum, 1, 0);
+                    struct parameters params; struct parameters* pparams = &params;
+                    pparams->ucvmag=&interpolateducvmag;
+                    pparams->v = v; pparams->f = f;pparams->b=b;
+                    pparams->mygriddata = griddata;
+                    // some initial values
+                    gsl_multimin_function F;
+                    F.n=2;
+                    F.f = &my_f;
+                    F.params = (void*) pparams;
+                    gsl_vector* stepsize = gsl_vector_alloc (2);
+                    gsl_vector_set (stepsize, 0, lambda/(8*M_PI));
+                    gsl_vector_set (stepsize, 1, lambda/(8*M_PI));
+                    gsl_multimin_fminimizer_set (minimizerstate, &F, minimum, stepsize);
+
+                    int iter=0;
+                    int status =0;
+                    double minimizersize=0;
+                    do
+                    {
+                        iter++;
+                        status = gsl_multimin_fminimizer_iterate(minimizerstate);
 
-                    if (status)
-                        break;
+                        if (status)
+                            break;
 
-                    minimizersize = gsl_multimin_fminimizer_size (minimizerstate);
-                    status = gsl_multimin_test_size (minimizersize, 1e-2);
+                        minimizersize = gsl_multimin_fminimizer_size (minimizerstate);
+                        status = gsl_multimin_test_size (minimizersize, 1e-2);
 
+                    }
+                    while (status == GSL_CONTINUE && iter < 500);
+                    planestep[0] = gsl_vector_get(minimizerstate->x, 0);
+                    planestep[1] = gsl_vector_get(minimizerstate->x, 1);
+                    gsl_vector_free(minimum);
+                    gsl_vector_free(stepsize);
                 }
-                while (status == GSL_CONTINUE && iter < 500);
-
-
-                gsl_vector_scale(f,gsl_vector_get(minimizerstate->x, 0));
-                gsl_vector_scale(b,gsl_vector_get(minimizerstate->x, 1));
+                gsl_vector_scale(f,planestep[0]);
+                gsl_vector_scale(b,planestep[1]);
                 gsl_vector_add(f,b);
                 gsl_vector_add(v,f);
                 knotcurves[c].knotcurve[s].xcoord = gsl_vector_get(v, 0);
@@ -468,7 +736,6 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
                 gsl_vector_free(f);
                 gsl_vector_free(b);
                 gsl_vector_free(ucv);
-                gsl_vector_free(stepsize);
 
                 xdiff = knotcurves[c].knotcurve[0].xcoord - knotcurves[c].knotcurve[s].xcoord;     //distance from start/end point
                 ydiff = knotcurves[c].knotcurve[0].ycoord - knotcurves[c].knotcurve[s].ycoord;
@@ -579,8 +846,8 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
                 modidwn = circularmod(idwn,Nx);
                 modjdwn = circularmod(jdwn,Ny);
                 modkdwn = circularmod(kdwn,Nz);
-                if((BoundaryType==ALLREFLECTING) && (idwn<0 || jdwn<0 || kdwn<0 || idwn > Nx-1 || jdwn > Ny-1 || kdwn > Nz-1)) break;
-                if((BoundaryType==ZPERIODIC) && (idwn<0 || jdwn<0 || idwn > Nx-1 || jdwn > Ny-1 )) break;
+                if((BC==ALLREFLECTING) && (idwn<0 || jdwn<0 || kdwn<0 || idwn > Nx-1 || jdwn > Ny-1 || kdwn > Nz-1)) break;
+                if((BC==ZPERIODIC) && (idwn<0 || jdwn<0 || idwn > Nx-1 || jdwn > Ny-1 )) break;
                 dxu=0;
                 dyu=0;
                 dzu=0;
@@ -595,14 +862,14 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
                     jinc = (m/2)%2;
                     kinc = (m/4)%2;
                     /*Loop over nearest points*/
-                    i = gridinc(modidwn, iinc, Nx,0);
-                    j = gridinc(modjdwn, jinc, Ny,1);
-                    k = gridinc(modkdwn,kinc, Nz,2);
+                    i = gridinc<BC>(modidwn, iinc, Nx,0);
+                    j = gridinc<BC>(modjdwn, jinc, Ny,1);
+                    k = gridinc<BC>(modkdwn,kinc, Nz,2);
                     prefactor = (1-iinc + pow(-1,1+iinc)*xd)*(1-jinc + pow(-1,1+jinc)*yd)*(1-kinc + pow(-1,1+kinc)*zd);   //terms of the form (1-xd)(1-yd)zd etc. (interpolation coefficient)
                     /*interpolate grad u over nearest points*/
-                    dxu += prefactor*0.5*(u[pt(gridinc(i,1,Nx,0),j,k,griddata)] -  u[pt(gridinc(i,-1,Nx,0),j,k,griddata)])/h;  //central diff
-                    dyu += prefactor*0.5*(u[pt(i,gridinc(j,1,Ny,1),k,griddata)] -  u[pt(i,gridinc(j,-1,Ny,1),k,griddata)])/h;
-                    dzu += prefactor*0.5*(u[pt(i,j,gridinc(k,1,Nz,2),griddata)] -  u[pt(i,j,gridinc(k,-1,Nz,2),griddata)])/h;
+                    dxu += prefactor*0.5*(u(i+1,j,k) -  u(i-1,j,k))/h;  //central diff, off the halo at the boundaries
+                    dyu += prefactor*0.5*(u(i,j+1,k) -  u(i,j-1,k))/h;
+                    dzu += prefactor*0.5*(u(i,j,k+1) -  u(i,j,k-1))/h;
                 }
                 //project du onto perp of tangent direction first
                 dx = 0.5*(knotcurves[c].knotcurve[incp(s,1,NP)].xcoord - knotcurves[c].knotcurve[incp(s,-1,NP)].xcoord);   //central diff as a is defined on the points
@@ -885,17 +1152,23 @@ void find_knot_properties( vector<double>&ucvx, vector<double>&ucvy, vector<doub
 
     // these variables have the summary stats from the last timestep
 
-    static vector<double> oldwrithe(knotcurves.size());
-    static vector<double> oldtwist(knotcurves.size());
-    static vector<double> oldlength(knotcurves.size());
-    static vector<double> oldxavgpos(knotcurves.size());
-    static vector<double> oldyavgpos(knotcurves.size());
-    static vector<double> oldzavgpos(knotcurves.size());
-    static bool first = true;
+    vector<double>& oldwrithe = componenttracking.writhe;
+    vector<double>& oldtwist = componenttracking.twist;
+    vector<double>& oldlength = componenttracking.length;
+    vector<double>& oldxavgpos = componenttracking.xavgpos;
+    vector<double>& oldyavgpos = componenttracking.yavgpos;
+    vector<double>& oldzavgpos = componenttracking.zavgpos;
+    bool& first = componenttracking.first;
     vector<int> permutation(knotcurves.size());
 
     if(first)
     {
+        oldwrithe.resize(knotcurves.size());
+        oldtwist.resize(knotcurves.size());
+        oldlength.resize(knotcurves.size());
+        oldxavgpos.resize(knotcurves.size());
+        oldyavgpos.resize(knotcurves.size());
+        oldzavgpos.resize(knotcurves.size());
         for(int i = 0; i<knotcurves.size();i++)
         {
             oldwrithe[i] = knotcurves[i].writhe;
@@ -994,22 +1267,99 @@ void find_knot_velocity(const vector<knotcurve>& knotcurves,vector<knotcurve>& k
         }
     }
 }
-void uv_update(vector<double>&u, vector<double>&v,  vector<double>&ku, vector<double>&kv,const Griddata& griddata)
+// counters for the bandwidth report: the time spent updating, and the compulsory memory traffic, counted in full grid arrays. only the master
+// thread touches these
+static double updateseconds = 0;
+static double updatearrays = 0;
+
+template<typename Store, typename Accum, BoundaryCondition BC>
+void uv_update(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv, int steps, const Griddata& griddata)
+{
+    static double starttime;
+#pragma omp master
+    starttime = omp_get_wtime();
+
+    double arrays;
+    if(TimeIntegrator==RK4 && TimeBlockSteps > 1)
+    {
+        // each sweep reads u and v and writes their new values once, however many steps it takes
+        int sweeps = 0;
+        for(int done=0;done<steps;done+=TimeBlockSteps,sweeps++)
+        {
+            uv_update_wavefront<Store,Accum>(u,v,ku,kv,(steps-done < TimeBlockSteps) ? steps-done : TimeBlockSteps,griddata);
+        }
+        arrays = 4*sweeps;
+    }
+    else if(TimeIntegrator==IMEX_SPECTRAL)
+    {
+        uv_update_imex<Store,Accum>(u,v,steps,griddata);
+        // u goes into a grid of doubles and back, each step's reaction reads and writes it and v, and each of the steps+1 diffusions reads
+        // and writes it once along each axis. r is how many Store arrays a grid of doubles counts as
+        const double r = (double)sizeof(double)/sizeof(Store);
+        arrays = 2*(1+r) + steps*(2+2*r) + (steps+1)*6*r;
+    }
+    else
+    {
+        // the part of the grid stepped, added up over the steps
+        double stepped = 0;
+        for(int s=0;s<steps;s++)
+        {
+            double fraction = 1;
+            // the reference kernel works on the whole grid, so a grid split over several ranks always gets the blocked one
+            if(TimeIntegrator==LOWSTORAGE_RK) uv_update_lowstorage<Store,Accum>(u,v,ku,kv,griddata);
+            else if(ActiveRegionUpdate) fraction = uv_update_active<Store,Accum>(u,v,ku,kv,griddata);
+            else if(BlockedUpdate || decomposition().size > 1) uv_update_blocked<Store,Accum>(u,v,ku,kv,griddata);
+            else uv_update_reference<Store,Accum,BC>(u,v,ku,kv,griddata);
+            stepped += fraction;
+        }
+        // the first RK4 stage reads u,v and writes k1 (4 arrays), the next three stages read u,v and the previous k and write the next k (6 each),
+        // and the final sum reads u,v and the four k's and writes u,v (12). the low storage scheme reads u,v,du,dv and writes them all back on each
+        // of its five stages (8 each), the u,v update being folded into the sweep
+        arrays = ((TimeIntegrator==LOWSTORAGE_RK) ? 40 : 34)*stepped;
+    }
+
+    // all the kernels end on the implicit barrier of an omp for, so everyone is finished by here
+#pragma omp master
+    {
+        updateseconds += omp_get_wtime() - starttime;
+        updatearrays += arrays;
+    }
+}
+
+double uv_update_bandwidth(const Griddata& griddata)
+{
+    // the compulsory memory traffic counted up by uv_update. neighbour reads are assumed to come out of cache, which is what the tiling is for,
+    // and the halo fills and the wavefront's margins are only the surface of the grid. this is the number to hold up against the STREAM bandwidth.
+    double bytes = sizeof(StoreType)*((double)griddata.Nx*griddata.Ny*griddata.Nz)*updatearrays;
+    double bandwidth = 0;
+    if(updateseconds > 0) bandwidth = bytes/updateseconds/1e9;
+    updateseconds = 0;
+    updatearrays = 0;
+    return bandwidth;
+}
+
+// the straightforward kernel, kept as the thing the others are checked against. it works out every neighbour with gridinc rather than using
+// the halos, and only fills them at the end
+template<typename Store, typename Accum, BoundaryCondition BC>
+void uv_update_reference(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv,const Griddata& griddata)
 {
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
     int Nz = griddata.Nz;
     const double h = griddata.h;
-    int i,j,k,l,n,kup,kdown,iup,idown,jup,jdown;
-    double D2u;
-    const int arraysize = Nx*Ny*Nz;
+    int i,j,k,l,kup,kdown,iup,idown,jup,jdown;
+    Accum D2u;
 
 
-    // some constants we will use over and over below:
+    // some constants we will use over and over below, all in the precision the sums are done in:
     const double sixth = 1.0/6.0;
-    const double ONETHIRD = 1.0/3.0;
-    const double oneoverepsilon = 1.0/epsilon;
-    const double oneoverhsq = 1.0/(h*h);
+    const Accum dtsixth = dtime*sixth;
+    const Accum ONETHIRD = 1.0/3.0;
+    const Accum oneoverepsilon = 1.0/epsilon;
+    const Accum oneoverhsq = 1.0/(h*h);
+    const Accum EPSILON = epsilon;
+    const Accum BETA = beta;
+    const Accum GAM = gam;
     // first loop. get k1, store (in testun] and testv[n], the value u[n]+h/2k1)
 #pragma omp for 
     for(i=0;i<Nx;i++)
@@ -1018,12 +1368,13 @@ void uv_update(vector<double>&u, vector<double>&v,  vector<double>&ku, vector<do
         {
             for(k=0; k<Nz; k++)   //Central difference
             {
-                n = pt(i,j,k,griddata);
-                kup = gridinc(k,1,Nz,2);
-                kdown = gridinc(k,-1,Nz,2);
-                D2u = oneoverhsq*(u[pt(gridinc(i,1,Nx,0),j,k,griddata)] + u[pt(gridinc(i,-1,Nx,0),j,k,griddata)] + u[pt(i,gridinc(j,1,Ny,1),k,griddata)] + u[pt(i,gridinc(j,-1,Ny,1),k,griddata)] + u[pt(i,j,kup,griddata)] + u[pt(i,j,kdown,griddata)] - 6.0*u[n]);
-                ku[n] = oneoverepsilon*(u[n] - (ONETHIRD*u[n])*(u[n]*u[n]) - v[n]) + D2u;
-                kv[n] = epsilon*(u[n] + beta - gam*v[n]);
+                kup = gridinc<BC>(k,1,Nz,2);
+                kdown = gridinc<BC>(k,-1,Nz,2);
+                Accum currentu = u(i,j,k);
+                Accum currentv = v(i,j,k);
+                D2u = oneoverhsq*((Accum)u(gridinc<BC>(i,1,Nx,0),j,k) + u(gridinc<BC>(i,-1,Nx,0),j,k) + u(i,gridinc<BC>(j,1,Ny,1),k) + u(i,gridinc<BC>(j,-1,Ny,1),k) + u(i,j,kup) + u(i,j,kdown) - 6*currentu);
+                ku(i,j,k) = oneoverepsilon*(currentu - (ONETHIRD*currentu)*(currentu*currentu) - currentv) + D2u;
+                kv(i,j,k) = EPSILON*(currentu + BETA - GAM*currentv);
             }
         }
     }
@@ -1050,6 +1401,7 @@ void uv_update(vector<double>&u, vector<double>&v,  vector<double>&ku, vector<do
         }
             break;
         }
+        const Accum dtinc = dtime*inc;
 #pragma omp for 
         for(i=0;i<Nx;i++)
         {
@@ -1057,36 +1409,986 @@ void uv_update(vector<double>&u, vector<double>&v,  vector<double>&ku, vector<do
             {
                 for(k=0; k<Nz; k++)   //Central difference
                 {
-                    n = pt(i,j,k,griddata);
+                    iup = gridinc<BC>(i,1,Nx,0);
+                    idown = gridinc<BC>(i,-1,Nx,0);
+                    jup = gridinc<BC>(j,1,Ny,1);
+                    jdown = gridinc<BC>(j,-1,Ny,1);
+                    kup = gridinc<BC>(k,1,Nz,2);
+                    kdown = gridinc<BC>(k,-1,Nz,2);
+                    Accum currentu = u(i,j,k) + dtinc*ku(i,j,k,l-1);
+                    Accum currentv = v(i,j,k) + dtinc*kv(i,j,k,l-1);
 
-                    iup = pt(gridinc(i,1,Nx,0),j,k,griddata);
-                    idown =pt(gridinc(i,-1,Nx,0),j,k,griddata);
-                    jup = pt(i,gridinc(j,1,Ny,1),k,griddata);
-                    jdown =pt(i,gridinc(j,-1,Ny,1),k,griddata);
-                    kup = pt(i,j,gridinc(k,1,Nz,2),griddata);
-                    kdown = pt(i,j,gridinc(k,-1,Nz,2),griddata);
-                    double currentu = u[n] + dtime*inc*ku[(l-1)*arraysize+n];
-                    double currentv = v[n] + dtime*inc*kv[(l-1)*arraysize+n];
+                    D2u = oneoverhsq*((u(iup,j,k)+dtinc*ku(iup,j,k,l-1)) + (u(idown,j,k)+dtinc*ku(idown,j,k,l-1)) +(u(i,jup,k)+dtinc*ku(i,jup,k,l-1)) +(u(i,jdown,k)+dtinc*ku(i,jdown,k,l-1)) + (u(i,j,kup)+dtinc*ku(i,j,kup,l-1)) + (u(i,j,kdown)+dtinc*ku(i,j,kdown,l-1))- 6*(currentu));
 
-                    D2u = oneoverhsq*((u[iup]+dtime*inc*ku[(l-1)*arraysize+iup]) + (u[idown]+dtime*inc*ku[(l-1)*arraysize+idown]) +(u[jup]+dtime*inc*ku[(l-1)*arraysize+jup]) +(u[jdown]+dtime*inc*ku[(l-1)*arraysize+jdown]) + (u[kup]+dtime*inc*ku[(l-1)*arraysize+kup]) + (u[kdown]+dtime*inc*ku[(l-1)*arraysize+kdown])- 6.0*(currentu));
 
-
-                    ku[arraysize*l+n] = oneoverepsilon*(currentu - (ONETHIRD*currentu)*(currentu*currentu) - currentv) + D2u;
-                    kv[arraysize*l+n] = epsilon*(currentu + beta - gam*currentv);
+                    ku(i,j,k,l) = oneoverepsilon*(currentu - (ONETHIRD*currentu)*(currentu*currentu) - currentv) + D2u;
+                    kv(i,j,k,l) = EPSILON*(currentu + BETA - GAM*currentv);
                 }
             }
         }
     }
 #pragma omp for 
-    for(n=0;n<Nx*Ny*Nz;n++)
+    for(i=0;i<Nx;i++)
+    {
+        for(j=0; j<Ny; j++)
+        {
+            for(k=0; k<Nz; k++)
+            {
+                u(i,j,k) = u(i,j,k) + dtsixth*((Accum)ku(i,j,k,0)+2*ku(i,j,k,1)+2*ku(i,j,k,2)+ku(i,j,k,3));
+                v(i,j,k) = v(i,j,k) + dtsixth*((Accum)kv(i,j,k,0)+2*kv(i,j,k,1)+2*kv(i,j,k,2)+kv(i,j,k,3));
+            }
+        }
+    }
+    u.template fill_halo<BC>();
+    v.template fill_halo<BC>();
+}
+
+// the SIMD row kernels in use, picked from SimdPath the first time they are needed
+static const SimdRowKernels* rowkernels = NULL;
+
+void select_row_kernels()
+{
+#pragma omp single
+    {
+        if(rowkernels==NULL)
+        {
+            rowkernels = simd_row_kernels(SimdPath);
+            cout << "uv_update SIMD path: " << rowkernels->name << endl;
+        }
+    }
+}
+
+// one RK4 stage, a row at a time. on the first stage there are no k's from a previous stage to add on. the pointers are the origins of padded
+// fields, so the neighbours of every point, boundary or not, are at constant strides
+template<bool FIRSTSTAGE, typename Store, typename Accum>
+struct RK4stage
+{
+    const Store *u,*v,*kuold,*kvold;
+    Store *kunew,*kvnew;
+    Accum dtinc,oneoverhsq;
+    inline void row(int n0, int n1, int xstride, int ystride) const
+    {
+        if(FIRSTSTAGE) rowkernels->rk4first(u,v,kunew,kvnew,n0,n1,xstride,ystride,oneoverhsq);
+        else rowkernels->rk4(u,v,kuold,kvold,kunew,kvnew,n0,n1,xstride,ystride,dtinc,oneoverhsq);
+    }
+    // nothing to do once a plane of the tile is finished
+    inline void planedone(int i, int imin, int jmin, int jmax, int kmin, int kmax, int xstride, int ystride) const {}
+};
+
+// one stage of the 2N-storage RK: du <- A*du + dt*F(u), then u <- u + B*du. the second half can't be done in the same sweep as the first, since
+// the neighbours still need the old u. instead, once plane i of a tile is done nothing in the tile reads plane i-1 again, so the interior of
+// plane i-1 is stepped forward straight away while it is still in cache. points on the faces of the tile may still be read by the neighbouring
+// tiles, and are left for lsrk_face_pass once everyone is done. the halo keeps the old u until it is refilled after the stage
+template<typename Store, typename Accum>
+struct LSRKstage
+{
+    Store *u,*v,*du,*dv;
+    Accum A,B,dt,oneoverhsq;
+    inline void row(int n0, int n1, int xstride, int ystride) const
+    {
+        rowkernels->lsrk(u,v,du,dv,n0,n1,xstride,ystride,A,dt,oneoverhsq);
+    }
+    inline void planedone(int i, int imin, int jmin, int jmax, int kmin, int kmax, int xstride, int ystride) const
+    {
+        if(i-1 <= imin) return;
+        for(int j=jmin+1;j<jmax-1;j++)
+        {
+            const int row = (i-1)*xstride + j*ystride;
+            for(int k=kmin+1;k<kmax-1;k++)
+            {
+                u[row+k] += B*du[row+k];
+                v[row+k] += B*dv[row+k];
+            }
+        }
+    }
+};
+
+// one stage over the whole grid. the grid is cut into TileNx x TileNy x TileNz tiles, and each tile is swept plane by plane along x so the three planes the
+// stencil needs stay in cache. the fields are padded, with xstride and ystride their padded strides, and the halos hold whatever is across the
+// boundaries, so every row goes straight to the SIMD row kernels
+template<class Stage>
+void uv_stage_blocked(const Stage& stage, const Griddata& griddata, int xstride, int ystride)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    const int ntilesx = (Nx+TileNx-1)/TileNx;
+    const int ntilesy = (Ny+TileNy-1)/TileNy;
+    const int ntilesz = (Nz+TileNz-1)/TileNz;
+#pragma omp for collapse(3) schedule(static)
+    for(int tx=0;tx<ntilesx;tx++)
+    {
+        for(int ty=0;ty<ntilesy;ty++)
+        {
+            for(int tz=0;tz<ntilesz;tz++)
+            {
+                const int imin = tx*TileNx;
+                const int imax = (imin+TileNx < Nx) ? imin+TileNx : Nx;
+                const int jmin = ty*TileNy;
+                const int jmax = (jmin+TileNy < Ny) ? jmin+TileNy : Ny;
+                const int kmin = tz*TileNz;
+                const int kmax = (kmin+TileNz < Nz) ? kmin+TileNz : Nz;
+                for(int i=imin;i<imax;i++)
+                {
+                    for(int j=jmin;j<jmax;j++)
+                    {
+                        const int row = i*xstride + j*ystride;
+                        stage.row(row+kmin, row+kmax, xstride, ystride);
+                    }
+                    stage.planedone(i,imin,jmin,jmax,kmin,kmax,xstride,ystride);
+                }
+            }
+        }
+    }
+}
+
+// the second half of a low storage stage for the points uv_stage_blocked had to leave alone - those on the faces of each tile
+template<typename Store, typename Accum>
+void lsrk_face_pass(const LSRKstage<Store,Accum>& stage, const Griddata& griddata, int xstride, int ystride)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    const int ntilesx = (Nx+TileNx-1)/TileNx;
+    const int ntilesy = (Ny+TileNy-1)/TileNy;
+    const int ntilesz = (Nz+TileNz-1)/TileNz;
+    Store* u = stage.u;
+    Store* v = stage.v;
+    const Store* du = stage.du;
+    const Store* dv = stage.dv;
+    const Accum B = stage.B;
+#pragma omp for collapse(3) schedule(static)
+    for(int tx=0;tx<ntilesx;tx++)
     {
+        for(int ty=0;ty<ntilesy;ty++)
+        {
+            for(int tz=0;tz<ntilesz;tz++)
+            {
+                const int imin = tx*TileNx;
+                const int imax = (imin+TileNx < Nx) ? imin+TileNx : Nx;
+                const int jmin = ty*TileNy;
+                const int jmax = (jmin+TileNy < Ny) ? jmin+TileNy : Ny;
+                const int kmin = tz*TileNz;
+                const int kmax = (kmin+TileNz < Nz) ? kmin+TileNz : Nz;
+                for(int i=imin;i<imax;i++)
+                {
+                    for(int j=jmin;j<jmax;j++)
+                    {
+                        const int row = i*xstride + j*ystride;
+                        if(i==imin || i==imax-1 || j==jmin || j==jmax-1)
+                        {
+                            for(int k=kmin;k<kmax;k++)
+                            {
+                                u[row+k] += B*du[row+k];
+                                v[row+k] += B*dv[row+k];
+                            }
+                            continue;
+                        }
+                        u[row+kmin] += B*du[row+kmin];
+                        v[row+kmin] += B*dv[row+kmin];
+                        if(kmax-1 > kmin)
+                        {
+                            u[row+kmax-1] += B*du[row+kmax-1];
+                            v[row+kmax-1] += B*dv[row+kmax-1];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename Store, typename Accum>
+void uv_update_blocked(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv,const Griddata& griddata)
+{
+    select_row_kernels();
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    const int xstride = u.xstride;
+    const int ystride = u.ystride;
+    const int stagesize = ku.componentsize;
+    const Accum oneoverhsq = 1.0/(griddata.h*griddata.h);
+    const double sixth = 1.0/6.0;
+    const Accum dtsixth = dtime*sixth;
+    // the fraction of a timestep each stage steps forward from u, to get the point the next k is evaluated at
+    const double inc[4] = {0, 0.5, 0.5, 1};
 
-        u[n] = u[n] + dtime*sixth*(ku[n]+2*ku[arraysize+n]+2*ku[2*arraysize+n]+ku[3*arraysize+n]);
-        v[n] = v[n] + dtime*sixth*(kv[n]+2*kv[arraysize+n]+2*kv[2*arraysize+n]+kv[3*arraysize+n]);
+    RK4stage<true,Store,Accum> firststage = {u.origin(), v.origin(), NULL, NULL, ku.origin(0), kv.origin(0), 0, oneoverhsq};
+    uv_stage_blocked(firststage, griddata, xstride, ystride);
+    for(int l=1;l<=3;l++)
+    {
+        // the next k needs the neighbours of the last one, across the boundaries too. kv is only ever read at the point itself
+        fill_slab_halo(ku, griddata.boundarytype, l-1);
+        RK4stage<false,Store,Accum> stage = {u.origin(), v.origin(), ku.origin(l-1), kv.origin(l-1), ku.origin(l), kv.origin(l), dtime*inc[l], oneoverhsq};
+        uv_stage_blocked(stage, griddata, xstride, ystride);
+    }
+    Store* U = u.origin();
+    Store* V = v.origin();
+    const Store* KU = ku.origin();
+    const Store* KV = kv.origin();
+#pragma omp for
+    for(int i=0;i<Nx;i++)
+    {
+        for(int j=0;j<Ny;j++)
+        {
+            for(int n=i*xstride+j*ystride;n<i*xstride+j*ystride+Nz;n++)
+            {
+                U[n] = U[n] + dtsixth*((Accum)KU[n]+2*KU[stagesize+n]+2*KU[2*stagesize+n]+KU[3*stagesize+n]);
+                V[n] = V[n] + dtsixth*((Accum)KV[n]+2*KV[stagesize+n]+2*KV[2*stagesize+n]+KV[3*stagesize+n]);
+            }
+        }
     }
+    fill_slab_halo(u, griddata.boundarytype);
+    fill_slab_halo(v, griddata.boundarytype);
+}
+
+// the active region update, for ActiveRegionUpdate. only the bricks listed as active are stepped. the others are left frozen at rest, with
+// their RK stages zeroed, so the active bricks around them see the resting values, not moving. a brick is active if it or one of the 26 around
+// it has a point away from rest. a frozen brick can't move away from rest by itself, so the checks only need to look at the active bricks,
+// bar the one after each full sweep, which looks at everything and says if anything frozen had in fact moved
+struct ActiveBricks
+{
+    int nbx,nby,nbz;             // bricks along each axis, the last ones cut short at the edge of the grid
+    vector<char> nonrest;        // whether each brick has a point away from rest
+    vector<char> active;         // whether each brick gets stepped
+    vector<int> list;            // the active bricks
+    vector<int> frozen;          // bricks that have just stopped being stepped, whose RK stages need zeroing
+    double listpoints;           // grid points in the active bricks
+    int stepssincecheck,stepssincefullsweep;
+    double steppedpoints,steps;  // for uv_update_active_fraction
+};
+static ActiveBricks bricks = {0,0,0};
+
+// the resting state of the medium, where u - u^3/3 - v = 0 and u + beta - gam v = 0
+static void resting_state(double& urest, double& vrest)
+{
+    double U = -1;
+    for(int iteration=0;iteration<50;iteration++) U -= (U - U*U*U/3 - (U+beta)/gam)/(1 - U*U - 1/gam);
+    urest = U;
+    vrest = (U+beta)/gam;
+}
+
+static inline void brick_extent(int b, const Griddata& griddata, int& imin, int& imax, int& jmin, int& jmax, int& kmin, int& kmax)
+{
+    const int bx = b/(bricks.nby*bricks.nbz);
+    const int by = (b/bricks.nbz)%bricks.nby;
+    const int bz = b%bricks.nbz;
+    imin = bx*ActiveBrickNx;
+    imax = (imin+ActiveBrickNx < griddata.Nx) ? imin+ActiveBrickNx : griddata.Nx;
+    jmin = by*ActiveBrickNy;
+    jmax = (jmin+ActiveBrickNy < griddata.Ny) ? jmin+ActiveBrickNy : griddata.Ny;
+    kmin = bz*ActiveBrickNz;
+    kmax = (kmin+ActiveBrickNz < griddata.Nz) ? kmin+ActiveBrickNz : griddata.Nz;
+}
 
+// the brick d bricks along from b along an axis of n bricks, wrapping if the axis is periodic, -1 off the end if not
+static inline int brick_step(int b, int d, int n, bool periodic)
+{
+    b += d;
+    if(b >= 0 && b < n) return b;
+    return periodic ? (b+n)%n : -1;
 }
 
+// work out which bricks are active, and zero the RK stages of those that have just stopped being. everything is looked at if all is set,
+// and then every inactive brick is zeroed, since the full sweep gave them all k's
+template<typename Store>
+void active_check(Field<Store>&u, Field<Store>&v, Field<Store>&ku, Field<Store>&kv, bool all, const Griddata& griddata)
+{
+    static double urest,vrest;
+    const int nbricks = bricks.nbx*bricks.nby*bricks.nbz;
+#pragma omp single
+    resting_state(urest,vrest);
+#pragma omp for schedule(dynamic,16)
+    for(int b=0;b<nbricks;b++)
+    {
+        if(!all && !bricks.active[b]) continue;
+        int imin,imax,jmin,jmax,kmin,kmax;
+        brick_extent(b,griddata,imin,imax,jmin,jmax,kmin,kmax);
+        char away = 0;
+        for(int i=imin;i<imax && !away;i++)
+        {
+            for(int j=jmin;j<jmax && !away;j++)
+            {
+                for(int k=kmin;k<kmax;k++)
+                {
+                    if(fabs(u(i,j,k)-urest) > ActiveTolerance || fabs(v(i,j,k)-vrest) > ActiveTolerance) away = 1;
+                }
+            }
+        }
+        bricks.nonrest[b] = away;
+    }
+#pragma omp single
+    {
+        const Decomposition& decomp = decomposition();
+        const bool xperiodic = (decomp.size == 1 && griddata.boundarytype == ALLPERIODIC);
+        const bool yperiodic = (griddata.boundarytype == ALLPERIODIC);
+        const bool zperiodic = (griddata.boundarytype != ALLREFLECTING);
+        int woken = 0;
+        bricks.list.clear();
+        bricks.frozen.clear();
+        bricks.listpoints = 0;
+        for(int b=0;b<nbricks;b++)
+        {
+            const int bx = b/(bricks.nby*bricks.nbz);
+            const int by = (b/bricks.nbz)%bricks.nby;
+            const int bz = b%bricks.nbz;
+            // we can't see into the slabs either side, so the bricks against them are always stepped
+            char active = (decomp.size > 1 && ((bx == 0 && decomp.left >= 0) || (bx == bricks.nbx-1 && decomp.right >= 0)));
+            for(int dx=-1;dx<=1 && !active;dx++)
+            {
+                const int nx = brick_step(bx,dx,bricks.nbx,xperiodic);
+                if(nx < 0) continue;
+                for(int dy=-1;dy<=1 && !active;dy++)
+                {
+                    const int ny = brick_step(by,dy,bricks.nby,yperiodic);
+                    if(ny < 0) continue;
+                    for(int dz=-1;dz<=1 && !active;dz++)
+                    {
+                        const int nz = brick_step(bz,dz,bricks.nbz,zperiodic);
+                        if(nz >= 0 && bricks.nonrest[(nx*bricks.nby+ny)*bricks.nbz+nz]) active = 1;
+                    }
+                }
+            }
+            if(all && !bricks.active[b] && bricks.nonrest[b]) woken++;
+            if(!active && (all || bricks.active[b])) bricks.frozen.push_back(b);
+            bricks.active[b] = active;
+            if(active)
+            {
+                int imin,imax,jmin,jmax,kmin,kmax;
+                brick_extent(b,griddata,imin,imax,jmin,jmax,kmin,kmax);
+                bricks.list.push_back(b);
+                bricks.listpoints += (double)(imax-imin)*(jmax-jmin)*(kmax-kmin);
+            }
+        }
+        if(woken > 0) cout << "the full sweep found " << woken << " bricks that had moved away from rest while frozen\n";
+        bricks.stepssincecheck = 0;
+    }
+    const int nfrozen = bricks.frozen.size();
+#pragma omp for
+    for(int f=0;f<nfrozen;f++)
+    {
+        int imin,imax,jmin,jmax,kmin,kmax;
+        brick_extent(bricks.frozen[f],griddata,imin,imax,jmin,jmax,kmin,kmax);
+        for(int c=0;c<ku.components;c++)
+        {
+            for(int i=imin;i<imax;i++)
+            {
+                for(int j=jmin;j<jmax;j++)
+                {
+                    for(int k=kmin;k<kmax;k++)
+                    {
+                        ku(i,j,k,c) = 0;
+                        kv(i,j,k,c) = 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// one stage over the active bricks, each swept plane by plane as uv_stage_blocked does its tiles
+template<class Stage>
+void uv_stage_active(const Stage& stage, const Griddata& griddata, int xstride, int ystride)
+{
+    const int nactive = bricks.list.size();
+#pragma omp for schedule(static)
+    for(int a=0;a<nactive;a++)
+    {
+        int imin,imax,jmin,jmax,kmin,kmax;
+        brick_extent(bricks.list[a],griddata,imin,imax,jmin,jmax,kmin,kmax);
+        for(int i=imin;i<imax;i++)
+        {
+            for(int j=jmin;j<jmax;j++)
+            {
+                const int row = i*xstride + j*ystride;
+                stage.row(row+kmin, row+kmax, xstride, ystride);
+            }
+        }
+    }
+}
+
+template<typename Store, typename Accum>
+double uv_update_active(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv,const Griddata& griddata)
+{
+    const int nbx = (griddata.Nx+ActiveBrickNx-1)/ActiveBrickNx;
+    const int nby = (griddata.Ny+ActiveBrickNy-1)/ActiveBrickNy;
+    const int nbz = (griddata.Nz+ActiveBrickNz-1)/ActiveBrickNz;
+    const double points = (double)griddata.Nx*griddata.Ny*griddata.Nz;
+#pragma omp single
+    {
+        // a new grid starts with a full sweep, which sorts out which bricks are active
+        if(bricks.nbx != nbx || bricks.nby != nby || bricks.nbz != nbz)
+        {
+            bricks.nbx = nbx;
+            bricks.nby = nby;
+            bricks.nbz = nbz;
+            bricks.nonrest.assign(nbx*nby*nbz,0);
+            bricks.active.assign(nbx*nby*nbz,1);
+            bricks.stepssincefullsweep = ActiveFullSweepSteps;
+        }
+    }
+    double fraction;
+    const bool fullsweep = (bricks.stepssincefullsweep >= ActiveFullSweepSteps);
+    if(fullsweep)
+    {
+        uv_update_blocked<Store,Accum>(u,v,ku,kv,griddata);
+        active_check(u,v,ku,kv,true,griddata);
+        fraction = 1;
+    }
+    else
+    {
+        if(bricks.stepssincecheck >= ActiveCheckSteps) active_check(u,v,ku,kv,false,griddata);
+        select_row_kernels();
+        const int xstride = u.xstride;
+        const int ystride = u.ystride;
+        const int stagesize = ku.componentsize;
+        const Accum oneoverhsq = 1.0/(griddata.h*griddata.h);
+        const double sixth = 1.0/6.0;
+        const Accum dtsixth = dtime*sixth;
+        const double inc[4] = {0, 0.5, 0.5, 1};
+        RK4stage<true,Store,Accum> firststage = {u.origin(), v.origin(), NULL, NULL, ku.origin(0), kv.origin(0), 0, oneoverhsq};
+        uv_stage_active(firststage, griddata, xstride, ystride);
+        for(int l=1;l<=3;l++)
+        {
+            fill_slab_halo(ku, griddata.boundarytype, l-1);
+            RK4stage<false,Store,Accum> stage = {u.origin(), v.origin(), ku.origin(l-1), kv.origin(l-1), ku.origin(l), kv.origin(l), dtime*inc[l], oneoverhsq};
+            uv_stage_active(stage, griddata, xstride, ystride);
+        }
+        Store* U = u.origin();
+        Store* V = v.origin();
+        const Store* KU = ku.origin();
+        const Store* KV = kv.origin();
+        const int nactive = bricks.list.size();
+#pragma omp for schedule(static)
+        for(int a=0;a<nactive;a++)
+        {
+            int imin,imax,jmin,jmax,kmin,kmax;
+            brick_extent(bricks.list[a],griddata,imin,imax,jmin,jmax,kmin,kmax);
+            for(int i=imin;i<imax;i++)
+            {
+                for(int j=jmin;j<jmax;j++)
+                {
+                    for(int n=i*xstride+j*ystride+kmin;n<i*xstride+j*ystride+kmax;n++)
+                    {
+                        U[n] = U[n] + dtsixth*((Accum)KU[n]+2*KU[stagesize+n]+2*KU[2*stagesize+n]+KU[3*stagesize+n]);
+                        V[n] = V[n] + dtsixth*((Accum)KV[n]+2*KV[stagesize+n]+2*KV[2*stagesize+n]+KV[3*stagesize+n]);
+                    }
+                }
+            }
+        }
+        fill_slab_halo(u, griddata.boundarytype);
+        fill_slab_halo(v, griddata.boundarytype);
+        fraction = bricks.listpoints/points;
+    }
+#pragma omp single
+    {
+        if(fullsweep) bricks.stepssincefullsweep = 0;
+        else bricks.stepssincefullsweep++;
+        bricks.stepssincecheck++;
+        bricks.steppedpoints += fraction;
+        bricks.steps++;
+    }
+    return fraction;
+}
+
+double uv_update_active_fraction()
+{
+    double fraction = (bricks.steps > 0) ? bricks.steppedpoints/bricks.steps : 1;
+    bricks.steppedpoints = 0;
+    bricks.steps = 0;
+    return fraction;
+}
+
+template<typename Store, typename Accum>
+void uv_update_lowstorage(Field<Store>&u, Field<Store>&v,  Field<Store>&du, Field<Store>&dv,const Griddata& griddata)
+{
+    // Carpenter & Kennedy's five stage, fourth order 2N-storage scheme (NASA TM-109112, 1994, solution 3). du and dv are a single grid each and
+    // carry over from one stage to the next, so they must not be touched between calls - A[0]=0 wipes whatever was left in them from the last step
+    const double A[5] = {0.0, -567301805773.0/1357537059087.0, -2404267990393.0/2016746695238.0, -3550918686646.0/2091501179385.0, -1275806237668.0/842570457699.0};
+    const double B[5] = {1432997174477.0/9575080441755.0, 5161836677717.0/13612068292357.0, 1720146321549.0/2090206949498.0, 3134564353537.0/4481467310338.0, 2277821191437.0/14882151754819.0};
+    select_row_kernels();
+    const Accum oneoverhsq = 1.0/(griddata.h*griddata.h);
+    for(int s=0;s<5;s++)
+    {
+        LSRKstage<Store,Accum> stage = {u.origin(), v.origin(), du.origin(), dv.origin(), A[s], B[s], dtime, oneoverhsq};
+        uv_stage_blocked(stage, griddata, u.xstride, u.ystride);
+        lsrk_face_pass(stage, griddata, u.xstride, u.ystride);
+        // the next stage needs the new u across the boundaries
+        fill_slab_halo(u, griddata.boundarytype);
+    }
+    fill_slab_halo(v, griddata.boundarytype);
+}
+
+// the IMEX update. each step is Strang split into half a step of diffusion of u, a whole step of the reaction terms, and another half step of
+// diffusion, so it's second order in dtime. diffuse (SpectralDiffusion.h) does the diffusion exactly, so dtime isn't held below h^2/6, and
+// the reaction terms are a pointwise ODE, stepped with RK4. the half steps of diffusion between two steps are done as one, so the steps of
+// one call cost one diffusion each, plus one. u is worked on in double, in a copy without the halo
+template<typename Store, typename Accum>
+void uv_update_imex(Field<Store>&u, Field<Store>&v, int steps, const Griddata& griddata)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    const Accum dthalf = 0.5*dtime;
+    const Accum dtsixth = dtime/6.0;
+    const Accum DT = dtime;
+    const Accum ONETHIRD = 1.0/3.0;
+    const Accum oneoverepsilon = 1.0/epsilon;
+    const Accum EPSILON = epsilon;
+    const Accum BETA = beta;
+    const Accum GAM = gam;
+    static vector<double> U;
+#pragma omp single
+    U.resize((size_t)Nx*Ny*Nz);
+#pragma omp for
+    for(int i=0;i<Nx;i++)
+    {
+        for(int j=0;j<Ny;j++)
+        {
+            for(int k=0;k<Nz;k++) U[((size_t)i*Ny+j)*Nz+k] = u(i,j,k);
+        }
+    }
+    diffuse(U, 0.5*dtime, griddata);
+    for(int s=0;s<steps;s++)
+    {
+#pragma omp for
+        for(int i=0;i<Nx;i++)
+        {
+            for(int j=0;j<Ny;j++)
+            {
+                for(int k=0;k<Nz;k++)
+                {
+                    const size_t n = ((size_t)i*Ny+j)*Nz+k;
+                    const Accum u0 = U[n];
+                    const Accum v0 = v(i,j,k);
+                    Accum cu = u0;
+                    Accum cv = v0;
+                    Accum sumu = 0;
+                    Accum sumv = 0;
+                    for(int l=0;l<4;l++)
+                    {
+                        const Accum ku = oneoverepsilon*(cu - (ONETHIRD*cu)*(cu*cu) - cv);
+                        const Accum kv = EPSILON*(cu + BETA - GAM*cv);
+                        // the stages are weighted 1,2,2,1, and evaluated at half, half and a whole step along the last one
+                        const Accum weight = (l==0 || l==3) ? 1 : 2;
+                        const Accum inc = (l==2) ? DT : dthalf;
+                        sumu += weight*ku;
+                        sumv += weight*kv;
+                        cu = u0 + inc*ku;
+                        cv = v0 + inc*kv;
+                    }
+                    U[n] = u0 + dtsixth*sumu;
+                    v(i,j,k) = v0 + dtsixth*sumv;
+                }
+            }
+        }
+        diffuse(U, (s==steps-1) ? 0.5*dtime : dtime, griddata);
+    }
+#pragma omp for
+    for(int i=0;i<Nx;i++)
+    {
+        for(int j=0;j<Ny;j++)
+        {
+            for(int k=0;k<Nz;k++) u(i,j,k) = U[((size_t)i*Ny+j)*Nz+k];
+        }
+    }
+    fill_slab_halo(u, griddata.boundarytype);
+    fill_slab_halo(v, griddata.boundarytype);
+}
+
+// the temporally blocked update, for TimeBlockSteps > 1. rather than sweeping the whole grid once per RK4 stage, each TimeBlockNy x TimeBlockNz
+// column of the grid is swept once along x, taking it through several whole timesteps (levels) on the way. at sweep position p the first stage
+// of the first level is done on plane p, each later stage trails one plane behind the one before it, and each level five planes behind the
+// level before, which is as close as the stencil allows. so everything a plane needs from the level or stage before is a plane or two away,
+// and only the last few planes of each quantity are kept, in small per thread rings. u and v are read once and written once per sweep.
+// a column can't see what its neighbours work out, so it works out a margin of 4*levels points around itself as well, starting from the
+// old u and v, the margin shrinking by one point each stage as the outermost points go out of date. the margins are worked out again by the
+// neighbouring columns. the same goes along x at a periodic boundary, or between ranks. reflecting boundaries get ghost points copied in
+// after each stage, as fill_halo does. the new u and v go into ku and kv, which then swap with u and v
+
+// one quantity at one level of the wavefront: a ring of padded planes holding the last few planes it was worked out on. plane q is kept in
+// slot q%size, and slots -1 and size hold copies of the slots at the other end, so planes q-1, q and q+1 are always one plane apart in memory,
+// as the row kernels want
+template<typename Store>
+struct PlaneRing
+{
+    Store* slots;   // slot -1
+    int size,planesize,originoffset;
+    inline int slot(int q) const { return ((q%size)+size)%size; }
+    inline Store* plane(int q) const { return slots + (slot(q)+1)*planesize + originoffset; }
+    // once plane q has been written, update the copies
+    inline void written(int q) const
+    {
+        const int s = slot(q);
+        if(s==0) memcpy(slots + (size+1)*planesize, slots + planesize, planesize*sizeof(Store));
+        if(s==size-1) memcpy(slots, slots + size*planesize, planesize*sizeof(Store));
+    }
+};
+
+template<typename Store, typename Accum>
+struct WavefrontSweep
+{
+    const Field<Store> *u,*v;    // the fields at the start of the sweep
+    Field<Store> *unew,*vnew;    // and at the end
+    const Store *ubelow,*uabove,*vbelow,*vabove;    // the padded planes beyond each end of the slab, at the ends that aren't reflecting walls
+    int levels,margin;
+    int Nx,Ny,Nz;
+    bool xlowopen,xhighopen,yperiodic,zperiodic;
+    Accum oneoverhsq;
+    // the rows and columns of the region worked out at the op'th stage of the sweep, counting from 0, with -1 for u and v themselves
+    inline void region(int op, int jmin, int jmax, int kmin, int kmax, int& ja, int& jb, int& ka, int& kb) const
+    {
+        const int extra = margin-(op+1);
+        ja = jmin-extra;
+        jb = jmax+extra;
+        ka = kmin-extra;
+        kb = kmax+extra;
+        if(!yperiodic && ja < 0) ja = 0;
+        if(!yperiodic && jb > Ny) jb = Ny;
+        if(!zperiodic && ka < 0) ka = 0;
+        if(!zperiodic && kb > Nz) kb = Nz;
+    }
+    // and the planes
+    inline bool inplanes(int op, int q) const
+    {
+        const int extra = margin-(op+1);
+        return (q >= (xlowopen ? -extra : 0)) && (q < (xhighopen ? Nx+extra : Nx));
+    }
+};
+
+// plane q of a quantity read at its neighbours has been worked out over the given region. fill in the ghost points at reflecting boundaries
+template<typename Store, typename Accum>
+void wavefront_ghosts(const WavefrontSweep<Store,Accum>& sweep, const PlaneRing<Store>& ring, int q, int jmin, int kmin, int ja, int jb, int ka, int kb, int ystride)
+{
+    Store* p = ring.plane(q);
+    if(!sweep.zperiodic)
+    {
+        for(int j=ja;j<jb;j++)
+        {
+            Store* row = p + (j-jmin)*ystride - kmin;
+            if(ka == 0) row[-1] = row[0];
+            if(kb == sweep.Nz) row[sweep.Nz] = row[sweep.Nz-1];
+        }
+    }
+    if(!sweep.yperiodic)
+    {
+        if(ja == 0) memcpy(p + (-1-jmin)*ystride + ka-kmin, p + (0-jmin)*ystride + ka-kmin, (kb-ka)*sizeof(Store));
+        if(jb == sweep.Ny) memcpy(p + (sweep.Ny-jmin)*ystride + ka-kmin, p + (sweep.Ny-1-jmin)*ystride + ka-kmin, (kb-ka)*sizeof(Store));
+    }
+    ring.written(q);
+    if(q == 0 && !sweep.xlowopen)
+    {
+        memcpy(ring.plane(-1) - ring.originoffset, p - ring.originoffset, ring.planesize*sizeof(Store));
+        ring.written(-1);
+    }
+    if(q == sweep.Nx-1 && !sweep.xhighopen)
+    {
+        memcpy(ring.plane(sweep.Nx) - ring.originoffset, p - ring.originoffset, ring.planesize*sizeof(Store));
+        ring.written(sweep.Nx);
+    }
+}
+
+// copy plane q of the old u or v into a ring, over the given region. rows and columns across a periodic boundary wrap around
+template<typename Store, typename Accum>
+void wavefront_load(const WavefrontSweep<Store,Accum>& sweep, const Field<Store>& f, const Store* below, const Store* above, const PlaneRing<Store>& ring, int q, int jmin, int kmin, int ja, int jb, int ka, int kb, int ystride)
+{
+    const int Ny = sweep.Ny;
+    const int Nz = sweep.Nz;
+    const Store* source;
+    if(q < 0) source = below + (q+sweep.margin)*f.xstride + f.g*f.ystride + f.g;
+    else if(q >= sweep.Nx) source = above + (q-sweep.Nx)*f.xstride + f.g*f.ystride + f.g;
+    else source = f.origin() + f.index(q,0,0);
+    Store* p = ring.plane(q);
+    for(int j=ja;j<jb;j++)
+    {
+        const Store* from = source + (((j%Ny)+Ny)%Ny)*f.ystride;
+        Store* to = p + (j-jmin)*ystride - kmin;
+        for(int k=ka;k<kb;)
+        {
+            const int from0 = ((k%Nz)+Nz)%Nz;
+            const int length = (kb-k < Nz-from0) ? kb-k : Nz-from0;
+            memcpy(to+k, from+from0, length*sizeof(Store));
+            k += length;
+        }
+    }
+}
+
+// sweep one column of the grid, jmin..jmax x kmin..kmax, through the levels
+template<typename Store, typename Accum>
+void wavefront_column(const WavefrontSweep<Store,Accum>& sweep, int jmin, int jmax, int kmin, int kmax)
+{
+    const int levels = sweep.levels;
+    const int Nx = sweep.Nx;
+    // every ring has the same plane layout, big enough for the largest column and its margin
+    const int pad = sweep.margin+1;
+    const int ystride = TimeBlockNz + 2*pad;
+    const int planesize = (TimeBlockNy + 2*pad)*ystride;
+    // the rings of each level: u, v, then ku and kv of each stage. the sizes are how many planes each is needed for, plus two to spare: plane q
+    // of u is loaded one sweep position before it is first used and read until the end of the level at q, four positions later, and the
+    // other quantities are written one stage later each and read for one position less
+    const int ringsizes[10] = {7,7,6,6,5,5,4,4,3,3};
+    const int ringsperlevel = 10;
+    static thread_local vector<Store> storage;
+    static thread_local vector<PlaneRing<Store> > rings;
+    size_t total = 0;
+    for(int r=0;r<ringsperlevel;r++) total += (size_t)(ringsizes[r]+2)*planesize;
+    total *= levels;
+    if(storage.size() < total) storage.resize(total);
+    rings.resize(ringsperlevel*levels);
+    Store* next = storage.data();
+    for(int r=0;r<ringsperlevel*levels;r++)
+    {
+        PlaneRing<Store> ring = {next, ringsizes[r%ringsperlevel], planesize, pad*ystride+pad};
+        rings[r] = ring;
+        next += (size_t)(ring.size+2)*planesize;
+    }
+    const double sixth = 1.0/6.0;
+    const Accum dtsixth = dtime*sixth;
+    const double inc[4] = {0, 0.5, 0.5, 1};
+    const int lag = 5;    // sweep positions between one level and the next
+
+    int ja,jb,ka,kb;
+    const int firstplane = sweep.xlowopen ? -sweep.margin : 0;
+    const int lastplane = sweep.xhighopen ? Nx+sweep.margin : Nx;
+    for(int p=firstplane-1;p<Nx+lag*levels-1;p++)
+    {
+        // load the next plane of u and v
+        if(p+1 >= firstplane && p+1 < lastplane)
+        {
+            sweep.region(-1,jmin,jmax,kmin,kmax,ja,jb,ka,kb);
+            wavefront_load(sweep,*sweep.u,sweep.ubelow,sweep.uabove,rings[0],p+1,jmin,kmin,ja,jb,ka,kb,ystride);
+            wavefront_load(sweep,*sweep.v,sweep.vbelow,sweep.vabove,rings[1],p+1,jmin,kmin,ja,jb,ka,kb,ystride);
+            wavefront_ghosts(sweep,rings[0],p+1,jmin,kmin,ja,jb,ka,kb,ystride);
+        }
+        for(int t=0;t<levels;t++)
+        {
+            const PlaneRing<Store>* level = &rings[ringsperlevel*t];
+            // the four stages
+            for(int l=0;l<4;l++)
+            {
+                const int q = p - lag*t - l;
+                const int op = 4*t + l;
+                if(!sweep.inplanes(op,q)) continue;
+                sweep.region(op,jmin,jmax,kmin,kmax,ja,jb,ka,kb);
+                const Store* U = level[0].plane(q);
+                const Store* V = level[1].plane(q);
+                Store* KU = level[2+2*l].plane(q);
+                Store* KV = level[3+2*l].plane(q);
+                const Accum dtinc = dtime*inc[l];
+                for(int j=ja;j<jb;j++)
+                {
+                    const int row = (j-jmin)*ystride - kmin;
+                    if(l==0) rowkernels->rk4first(U,V,KU,KV,row+ka,row+kb,planesize,ystride,sweep.oneoverhsq);
+                    else rowkernels->rk4(U,V,level[2*l].plane(q),level[1+2*l].plane(q),KU,KV,row+ka,row+kb,planesize,ystride,dtinc,sweep.oneoverhsq);
+                }
+                // the last ku, and all the kv's, are only read at the point itself
+                if(l < 3) wavefront_ghosts(sweep,level[2+2*l],q,jmin,kmin,ja,jb,ka,kb,ystride);
+            }
+            // and the sum, into the next level's u and v, or the new fields at the end
+            const int q = p - lag*t - 4;
+            const int op = 4*t + 3;
+            if(!sweep.inplanes(op,q)) continue;
+            sweep.region(op,jmin,jmax,kmin,kmax,ja,jb,ka,kb);
+            const Store* U = level[0].plane(q);
+            const Store* V = level[1].plane(q);
+            const Store *KU1 = level[2].plane(q), *KU2 = level[4].plane(q), *KU3 = level[6].plane(q), *KU4 = level[8].plane(q);
+            const Store *KV1 = level[3].plane(q), *KV2 = level[5].plane(q), *KV3 = level[7].plane(q), *KV4 = level[9].plane(q);
+            const bool last = (t == levels-1);
+            Store* Unew = last ? NULL : level[ringsperlevel].plane(q);
+            Store* Vnew = last ? NULL : level[ringsperlevel+1].plane(q);
+            for(int j=ja;j<jb;j++)
+            {
+                const int row = (j-jmin)*ystride - kmin;
+                Store* UN = last ? sweep.unew->origin() + sweep.unew->index(q,j,0) - row : Unew;
+                Store* VN = last ? sweep.vnew->origin() + sweep.vnew->index(q,j,0) - row : Vnew;
+                for(int n=row+ka;n<row+kb;n++)
+                {
+                    UN[n] = U[n] + dtsixth*((Accum)KU1[n]+2*KU2[n]+2*KU3[n]+KU4[n]);
+                    VN[n] = V[n] + dtsixth*((Accum)KV1[n]+2*KV2[n]+2*KV3[n]+KV4[n]);
+                }
+            }
+            if(!last) wavefront_ghosts(sweep,level[ringsperlevel],q,jmin,kmin,ja,jb,ka,kb,ystride);
+        }
+    }
+}
+
+template<typename Store, typename Accum>
+void uv_update_wavefront(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv, int levels, const Griddata& griddata)
+{
+    select_row_kernels();
+    // the planes beyond each end of the slab
+    static vector<Store> ubelow,uabove,vbelow,vabove;
+#pragma omp single
+    {
+        slab_neighbour_planes(u,4*levels,ubelow,uabove);
+        slab_neighbour_planes(v,4*levels,vbelow,vabove);
+    }
+    WavefrontSweep<Store,Accum> sweep = {&u, &v, &ku, &kv, ubelow.data(), uabove.data(), vbelow.data(), vabove.data(), levels, 4*levels,
+                                         griddata.Nx, griddata.Ny, griddata.Nz, decomposition().left >= 0, decomposition().right >= 0,
+                                         griddata.boundarytype == ALLPERIODIC, griddata.boundarytype != ALLREFLECTING, (Accum)(1.0/(griddata.h*griddata.h))};
+    const int ntilesy = (griddata.Ny+TimeBlockNy-1)/TimeBlockNy;
+    const int ntilesz = (griddata.Nz+TimeBlockNz-1)/TimeBlockNz;
+#pragma omp for collapse(2) schedule(static)
+    for(int ty=0;ty<ntilesy;ty++)
+    {
+        for(int tz=0;tz<ntilesz;tz++)
+        {
+            const int jmin = ty*TimeBlockNy;
+            const int jmax = (jmin+TimeBlockNy < griddata.Ny) ? jmin+TimeBlockNy : griddata.Ny;
+            const int kmin = tz*TimeBlockNz;
+            const int kmax = (kmin+TimeBlockNz < griddata.Nz) ? kmin+TimeBlockNz : griddata.Nz;
+            wavefront_column(sweep,jmin,jmax,kmin,kmax);
+        }
+    }
+#pragma omp single
+    {
+        u.swap(ku);
+        v.swap(kv);
+    }
+    fill_slab_halo(u, griddata.boundarytype);
+    fill_slab_halo(v, griddata.boundarytype);
+}
+
+void uv_update_benchmark(const Griddata& griddata)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    // griddata is this rank's slab, and the rate is for the whole grid
+    const int ranks = decomposition().size;
+    const double N = (double)decomposition().globalNx*Ny*Nz;
+    const int steps = 20;
+    Field<StoreType>u(Nx,Ny,Nz,HaloWidth);
+    Field<StoreType>v(Nx,Ny,Nz,HaloWidth);
+    Field<StoreType>ku,kv;
+    const BoundaryKernels solver = boundary_kernels(griddata.boundarytype);
+    if(!BlockedUpdate && TimeIntegrator==RK4) cout << "BlockedUpdate is off, so the SIMD paths below all run the reference kernel\n";
+    cout << "timing " << steps << " steps of uv_update on a " << decomposition().globalNx << "x" << Ny << "x" << Nz << " grid over " << ranks << " ranks\n";
+    if(TimeIntegrator==RK4 && TimeBlockSteps > 1) cout << "taking up to " << TimeBlockSteps << " steps per sweep, in " << TimeBlockNy << "x" << TimeBlockNz << " columns\n";
+    for(int path=SIMD_SCALAR;path<=SIMD_AVX512;path++)
+    {
+        rowkernels = simd_row_kernels(path);
+        if(!simd_path_supported(path))
+        {
+            cout << "path " << path << " isn't supported on this CPU\n";
+            continue;
+        }
+        // start each path from the same state, with the reaction term doing something everywhere
+        for(int i=0;i<Nx;i++)
+        {
+            for(int j=0;j<Ny;j++)
+            {
+                for(int k=0;k<Nz;k++)
+                {
+                    const int n = ((decomposition().xoffset+i)*Ny+j)*Nz+k;
+                    u(i,j,k) = 2*cos(0.01*n) - 0.4;
+                    v(i,j,k) = sin(0.01*n) - 0.4;
+                }
+            }
+        }
+        fill_slab_halo(u,griddata.boundarytype);
+        fill_slab_halo(v,griddata.boundarytype);
+        ku.resize(Nx,Ny,Nz,HaloWidth,NumStageArrays);
+        kv.resize(Nx,Ny,Nz,HaloWidth,NumStageArrays);
+        // one untimed sweep to fault the pages in
+#pragma omp parallel
+        solver.uv_update(u,v,ku,kv,TimeBlockSteps,griddata);
+        uv_update_bandwidth(griddata);
+
+        int threads = 1;
+        ranks_barrier();
+        double starttime = omp_get_wtime();
+#pragma omp parallel
+        {
+#pragma omp master
+            threads = omp_get_num_threads();
+            solver.uv_update(u,v,ku,kv,steps,griddata);
+        }
+        ranks_barrier();
+        double seconds = omp_get_wtime() - starttime;
+        cout << rowkernels->name << "\t" << (N*steps)/seconds/(threads*ranks) << " updates/s per core on " << threads << " threads x " << ranks << " ranks\t" << uv_update_bandwidth(griddata) << " GB/s\n";
+    }
+    rowkernels = simd_row_kernels(SimdPath);
+}
+
+void placement_benchmark(const Griddata& griddata)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    const int steps = 20;
+    const BoundaryKernels solver = boundary_kernels(griddata.boundarytype);
+    rowkernels = simd_row_kernels(SimdPath);
+    thread_layout_report();
+    cout << "timing " << steps << " steps of uv_update on a " << decomposition().globalNx << "x" << Ny << "x" << Nz << " grid, with the " << rowkernels->name << " kernels\n";
+    const char* placements[] = {"first touched by the threads sweeping them", "first touched by the master thread"};
+    for(int serial=0;serial<2;serial++)
+    {
+        // resize only places the pages, so the fields are made here rather than reused
+        Field<StoreType>u,v,ku,kv;
+        u.resize(Nx,Ny,Nz,HaloWidth,1,!serial);
+        v.resize(Nx,Ny,Nz,HaloWidth,1,!serial);
+        ku.resize(Nx,Ny,Nz,HaloWidth,NumStageArrays,!serial);
+        kv.resize(Nx,Ny,Nz,HaloWidth,NumStageArrays,!serial);
+#pragma omp parallel for
+        for(int i=0;i<Nx;i++)
+        {
+            for(int j=0;j<Ny;j++)
+            {
+                for(int k=0;k<Nz;k++)
+                {
+                    const int n = ((decomposition().xoffset+i)*Ny+j)*Nz+k;
+                    u(i,j,k) = 2*cos(0.01*n) - 0.4;
+                    v(i,j,k) = sin(0.01*n) - 0.4;
+                }
+            }
+        }
+        fill_slab_halo(u,griddata.boundarytype);
+        fill_slab_halo(v,griddata.boundarytype);
+#pragma omp parallel
+        solver.uv_update(u,v,ku,kv,TimeBlockSteps,griddata);
+        uv_update_bandwidth(griddata);
+        ranks_barrier();
+        double starttime = omp_get_wtime();
+#pragma omp parallel
+        solver.uv_update(u,v,ku,kv,steps,griddata);
+        ranks_barrier();
+        double seconds = omp_get_wtime() - starttime;
+        cout << "fields " << placements[serial] << "\t" << ((double)decomposition().globalNx*Ny*Nz*steps)/seconds << " updates/s\t" << uv_update_bandwidth(griddata) << " GB/s\n";
+    }
+}
+
+template<BoundaryCondition BC>
+BoundaryKernels boundary_kernels()
+{
+    BoundaryKernels kernels = {uv_update<StoreType,AccumType,BC>, find_knot_properties<StoreType,BC>};
+    return kernels;
+}
+
+BoundaryKernels boundary_kernels(BoundaryCondition boundarytype)
+{
+    switch(boundarytype)
+    {
+    case ALLREFLECTING: return boundary_kernels<ALLREFLECTING>();
+    case ZPERIODIC: return boundary_kernels<ZPERIODIC>();
+    case ALLPERIODIC: break;
+    }
+    return boundary_kernels<ALLPERIODIC>();
+}
+
+// the solver is built for the precision picked in FN_Constants.h. these are instantiated here so that code outside this file can call them
+template void uv_initialise<StoreType>(vector<double>&phi, Field<StoreType>&u, Field<StoreType>&v, const Griddata& griddata);
+template void crossgrad_calc<StoreType>(Field<StoreType>&u, Field<StoreType>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, const Griddata& griddata);
+template void crossgrad_block<StoreType>(Field<StoreType>&u, Field<StoreType>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, int imin, int imax, int jmin, int jmax, int kmin, int kmax, const Griddata& griddata);
+template void uv_update_reference<StoreType,AccumType,ALLREFLECTING>(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, const Griddata& griddata);
+template void uv_update_reference<StoreType,AccumType,ZPERIODIC>(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, const Griddata& griddata);
+template void uv_update_reference<StoreType,AccumType,ALLPERIODIC>(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, const Griddata& griddata);
+template void uv_update_blocked<StoreType,AccumType>(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, const Griddata& griddata);
+template double uv_update_active<StoreType,AccumType>(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, const Griddata& griddata);
+template void uv_update_lowstorage<StoreType,AccumType>(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&du, Field<StoreType>&dv, const Griddata& griddata);
+template void uv_update_imex<StoreType,AccumType>(Field<StoreType>&u, Field<StoreType>&v, int steps, const Griddata& griddata);
+
 /*************************File reading and writing*****************************/
 
 int intersect3D_SegmentPlane( knotpoint SegmentStart, knotpoint SegmentEnd, knotpoint PlaneSegmentStart, knotpoint PlaneSegmentEnd, double& IntersectionFraction, std::vector<double>& IntersectionPoint )
@@ -1153,6 +2455,53 @@ double my_f(const gsl_vector* minimum, void* params)
     double value = -1*((*interpolateducvmag)(px,py,pz));
     return value;
 }
+bool plane_maximum(const likely::TriCubicInterpolator& ucvmag, const gsl_vector* v, const gsl_vector* f, const gsl_vector* b, double maxstep, double tolerance, double s[2])
+{
+    s[0] = 0;
+    s[1] = 0;
+    for(int iter=0; iter<20; iter++)
+    {
+        double p[3],F[3],B[3];
+        for(int a=0; a<3; a++)
+        {
+            F[a] = gsl_vector_get(f,a);
+            B[a] = gsl_vector_get(b,a);
+            p[a] = gsl_vector_get(v,a) + s[0]*F[a] + s[1]*B[a];
+        }
+        double gradient[3], hessian[3][3];
+        ucvmag(p[0],p[1],p[2],gradient,hessian);
+        // the gradient and hessian within the plane
+        double g0=0, g1=0, h00=0, h01=0, h11=0;
+        for(int a=0; a<3; a++)
+        {
+            g0 += gradient[a]*F[a];
+            g1 += gradient[a]*B[a];
+            for(int c=0; c<3; c++)
+            {
+                h00 += F[a]*hessian[a][c]*F[c];
+                h01 += F[a]*hessian[a][c]*B[c];
+                h11 += B[a]*hessian[a][c]*B[c];
+            }
+        }
+        // only near a maximum does the step lead to one
+        const double det = h00*h11 - h01*h01;
+        if(h00 >= 0 || det <= 0) return false;
+        double step0 = -(h11*g0 - h01*g1)/det;
+        double step1 = -(h00*g1 - h01*g0)/det;
+        const double length = sqrt(step0*step0 + step1*step1);
+        if(length > maxstep)
+        {
+            step0 *= maxstep/length;
+            step1 *= maxstep/length;
+        }
+        s[0] += step0;
+        s[1] += step1;
+        // a maximum much further off than the first step would go is some other part of the field
+        if(s[0]*s[0] + s[1]*s[1] > 16*maxstep*maxstep) return false;
+        if(length < tolerance) return true;
+    }
+    return false;
+}
 void cross_product(const gsl_vector *u, const gsl_vector *v, gsl_vector *product)
 {
     double p1 = gsl_vector_get(u, 1)*gsl_vector_get(v, 2)
@@ -1205,27 +2554,6 @@ int incabsorb(int i, int p, int N)    //increment with reflecting boundary betwe
     if(i+p>N-1) return (N-1);
     return (i+p);
 }
-// this function is specifically designed to incremenet, in the direction specified, respecting the boundary conditions, which are global enums
-int gridinc(int i, int p, int N, int direction )    //increment with reflecting boundary between -1 and 0 and N-1 and N
-{
-
-    if(BoundaryType == ALLREFLECTING)
-    {
-        return incw(i,p,N);
-    }
-
-    if(BoundaryType == ALLPERIODIC)
-    {
-        return incp(i,p,N);
-    }
-
-    if(BoundaryType == ZPERIODIC)
-    {
-        if(direction ==2) return incp(i,p,N);
-        else return incw(i,p,N);
-    }
-    return 0;
-}
 double x(int i,const Griddata& griddata)
 {
     return (i+0.5-griddata.Nx/2.0)*griddata.h;
@@ -1,5 +1,6 @@
 #include "FN_Constants.h"
 #include "TriCubicInterpolator.h"
+#include "Field.h"
 #include <stdlib.h>
 #include <iostream>
 #include <iomanip>
@@ -16,10 +17,18 @@ using namespace std;
 #ifndef FNKNOT_H
 #define FNKNOT_H
 
+// the types the solver works in, set by Precision in FN_Constants.h. u, v and the RK stages are kept in Store, and the RK sums are done in Accum
+template<int PRECISION> struct PrecisionTypes { typedef double Store; typedef double Accum; };
+template<> struct PrecisionTypes<SINGLE_PRECISION> { typedef float Store; typedef float Accum; };
+template<> struct PrecisionTypes<MIXED_PRECISION> { typedef float Store; typedef double Accum; };
+typedef PrecisionTypes<Precision>::Store StoreType;
+typedef PrecisionTypes<Precision>::Accum AccumType;
+
 struct Griddata
 {
     int Nx,Ny,Nz;
     double h;
+    BoundaryCondition boundarytype;
 };
 struct parameters
 {
@@ -89,6 +98,15 @@ struct knotcurve
     double zavgpos;
 };
 
+// what find_knot_properties keeps from one trace to the next to follow the components, which can come out in any order: the summary stats
+// of each as it last saw them. first is set until the first trace. a checkpoint keeps this too (see Checkpoint.h)
+struct ComponentTracking
+{
+    bool first;
+    std::vector<double> writhe,twist,length,xavgpos,yavgpos,zavgpos;
+};
+extern ComponentTracking componenttracking;
+
 struct Link
 {
     std::vector<knotcurve> Components;
@@ -110,10 +128,19 @@ int pt(int i,  int j,  int k, const Griddata &griddata);       //convert i,j,k t
 int circularmod(int i, int N);    // mod i by N in a cirucler fashion, ie wrapping around both in the +ve and -ve directions
 int incp(int i, int p, int N);    //increment i with p for periodic boundary
 int incw(int i, int p, int N);    //increment with reflecting boundary between -1 and 0 and N-1 and N
-int gridinc(int i, int p, int N, int direction );    //increment with reflecting boundary between -1 and 0 and N-1 and N
+// increment in the direction specified (0,1,2 for x,y,z), respecting boundary condition BC. BC is fixed at compile time, so the loops calling this
+// don't branch on it
+template<BoundaryCondition BC> inline int gridinc(int i, int p, int N, int direction)
+{
+    if(BC == ALLPERIODIC || (BC == ZPERIODIC && direction == 2)) return incp(i,p,N);
+    return incw(i,p,N);
+}
 
 void cross_product(const gsl_vector *u, const gsl_vector *v, gsl_vector *product);
 double my_f(const gsl_vector* minimum, void* params);
+// the maximum of the interpolated |grad u x grad v| in the plane through v spanned by f and b, as the multiples s of f and b that reach it, by
+// Newton's method from v with steps no longer than maxstep, until one is shorter than tolerance. returns false if it doesn't settle on a maximum
+bool plane_maximum(const likely::TriCubicInterpolator& ucvmag, const gsl_vector* v, const gsl_vector* f, const gsl_vector* b, double maxstep, double tolerance, double s[2]);
 void rotatedisplace(double& xcoord, double& ycoord, double& zcoord, const double theta, const double dispx,const double dispy,const double dispz);
 /*************************Functions for knot initialisation*****************************/
 
@@ -126,12 +153,45 @@ void phi_calc_surface(vector<double>&phi, std::vector<triangle>& knotsurface, co
 
 void phi_calc_manual( vector<double>&phi,const Griddata& griddata);
 
-//FitzHugh Nagumo functions
-void uv_initialise(vector<double>&phi, vector<double>&u, vector<double>&v,const Griddata& griddata);
-void crossgrad_calc(vector<double>&u, vector<double>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, const Griddata &griddata);
-void find_knot_properties(vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>& ucvmag, vector<double>&u, vector<knotcurve>& knotcurves, double t, gsl_multimin_fminimizer* minimizerstate, const Griddata &griddata);
+//FitzHugh Nagumo functions. these are templated on the precision of the fields, and instantiated for StoreType/AccumType in FN_Knot.cpp.
+// u, v and the RK stages are padded Fields, and uv_update leaves the halos of u and v filled, so anything reading neighbours of u and v
+// between updates can use the ghost points rather than wrapping. the functions which still need the boundary condition are templated on it,
+// and are reached through boundary_kernels
+template<typename Store> void uv_initialise(vector<double>&phi, Field<Store>&u, Field<Store>&v,const Griddata& griddata);
+// grad u cross grad v over the whole grid. it is shared out as tasks, so call it from one thread - from inside omp single the rest of the team
+// helps, from outside a parallel region this thread does it all
+template<typename Store> void crossgrad_calc(Field<Store>&u, Field<Store>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, const Griddata &griddata);
+// the same over the points imin <= i < imax, jmin <= j < jmax, kmin <= k < kmax, on this thread
+template<typename Store> void crossgrad_block(Field<Store>&u, Field<Store>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, int imin, int imax, int jmin, int jmax, int kmin, int kmax, const Griddata &griddata);
+template<typename Store, BoundaryCondition BC> void find_knot_properties(vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>& ucvmag, Field<Store>&u, vector<knotcurve>& knotcurves, double t, gsl_multimin_fminimizer* minimizerstate, const Griddata &griddata);
 void find_knot_velocity(const vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold, const Griddata &griddata, const double deltatime);
-void uv_update(vector<double>&u, vector<double>&v,  vector<double>&ku, vector<double>&kv, const Griddata &griddata);
+// step u and v forward the given number of timesteps
+template<typename Store, typename Accum, BoundaryCondition BC> void uv_update(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv, int steps, const Griddata &griddata);
+template<typename Store, typename Accum, BoundaryCondition BC> void uv_update_reference(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv, const Griddata &griddata);
+template<typename Store, typename Accum> void uv_update_blocked(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv, const Griddata &griddata);
+// the blocked update on just the parts of the grid away from rest (ActiveRegionUpdate). returns the part of the grid stepped
+template<typename Store, typename Accum> double uv_update_active(Field<Store>&u, Field<Store>&v,  Field<Store>&ku, Field<Store>&kv, const Griddata &griddata);
+// the 2N-storage RK step (LOWSTORAGE_RK). it needs 6 fewer stage grids than RK4, but moves 40 grids through memory a step against RK4's 34
+template<typename Store, typename Accum> void uv_update_lowstorage(Field<Store>&u, Field<Store>&v,  Field<Store>&du, Field<Store>&dv, const Griddata &griddata);
+template<typename Store, typename Accum> void uv_update_imex(Field<Store>&u, Field<Store>&v, int steps, const Griddata &griddata);
+template<typename Store, typename Accum> void uv_update_wavefront(Field<Store>&u, Field<Store>&v,  Field<Store>&unew, Field<Store>&vnew, int levels, const Griddata &griddata);
+double uv_update_bandwidth(const Griddata &griddata);    // achieved GB/s of uv_update since the last call
+double uv_update_active_fraction();    // the average part of the grid uv_update_active stepped since the last call
+void uv_update_benchmark(const Griddata &griddata);    // time uv_update for each SIMD path, and print updates/s per core
+void placement_benchmark(const Griddata &griddata);    // time uv_update with the fields spread over the NUMA nodes and all on one, and print GB/s
+bool output_iteration(int n, int skip, int frequentprint, int velocityprint, int uvprint, int checkpointprint);    // does the main loop print, trace or checkpoint anything at iteration n
+// the boundary condition dependent functions above, for one boundary condition
+struct BoundaryKernels
+{
+    void (*uv_update)(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, int steps, const Griddata &griddata);
+    void (*find_knot_properties)(vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>& ucvmag, Field<StoreType>&u, vector<knotcurve>& knotcurves, double t, gsl_multimin_fminimizer* minimizerstate, const Griddata &griddata);
+};
+BoundaryKernels boundary_kernels(BoundaryCondition boundarytype);
+// what the main loop does with the grid at a print: with frequent, trace the knot and print it, and with velocity, trace it and find the
+// velocity of the one traced last time (kept in knotcurvesold), and print that. u and v must have their halos filled, and be the grid as it
+// is at the given iteration. grad u cross grad v goes through derived, so it is only worked out once
+class DerivedFields;
+void trace_knot(Field<StoreType>&u, Field<StoreType>&v, DerivedFields& derived, vector<knotcurve>& knotcurves, vector<knotcurve>& knotcurvesold, gsl_multimin_fminimizer* minimizerstate, double t, int iteration, bool frequent, bool velocity, const BoundaryKernels& solver, const Griddata &griddata);
 // 3d geometry functions
 int intersect3D_SegmentPlane( knotpoint SegmentStart, knotpoint SegmentEnd, knotpoint PlaneSegmentStart, knotpoint PlaneSegmentEnd, double& IntersectionFraction, std::vector<double>& IntersectionPoint );
 
@@ -0,0 +1,171 @@
+#include "FN_Constants.h"
+#include "Memory.h"
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+using namespace std;
+
+#ifndef FIELD_H
+#define FIELD_H
+
+// a field on the Nx x Ny x Nz grid, padded with g ghost layers on every side, so that a stencil reaching up to g points away never has to
+// wrap or reflect - fill_halo copies the boundary values into the ghost layers instead. the layout is the same as pt() with k fastest, just
+// with the padded sizes. a field can hold several components of the same size one after the other (eg. the RK stages). the storage comes from
+// FieldAllocator (see Memory.h), and is zeroed by first_touch
+template<typename T>
+class Field
+{
+public:
+    Field() : Nx(0), Ny(0), Nz(0), g(0), components(0), xstride(0), ystride(0), componentsize(0) {}
+    Field(int Nx, int Ny, int Nz, int g = 1, int components = 1) { resize(Nx,Ny,Nz,g,components); }
+
+    // the contents are zeroed, spread over the threads with first_touch if spread is true, or by this thread alone if not
+    void resize(int newNx, int newNy, int newNz, int newg = 1, int newcomponents = 1, bool spread = FirstTouch)
+    {
+        Nx = newNx;
+        Ny = newNy;
+        Nz = newNz;
+        g = newg;
+        components = newcomponents;
+        ystride = Nz+2*g;
+        xstride = (Ny+2*g)*ystride;
+        componentsize = (Nx+2*g)*xstride;
+        // free the old storage first, so that the new pages are fresh and untouched
+        vector<T,FieldAllocator<T> >().swap(storage);
+        storage.resize((size_t)components*componentsize);
+        if(spread) first_touch();
+        else std::fill(storage.begin(),storage.end(),T(0));
+    }
+
+    // zero every component with the same static schedule of tiles as uv_stage_blocked, so that each page is first written by, and so placed on
+    // the NUMA node of, the thread that sweeps it in the update. the tiles on the edges of the grid take the halo next to them with them.
+    // call from outside a parallel region - inside one this thread does it all
+    void first_touch()
+    {
+        const int ntilesx = (Nx+TileNx-1)/TileNx;
+        const int ntilesy = (Ny+TileNy-1)/TileNy;
+        const int ntilesz = (Nz+TileNz-1)/TileNz;
+        for(int c=0;c<components;c++)
+        {
+            T* f = origin(c);
+#pragma omp parallel for collapse(3) schedule(static) if(!omp_in_parallel())
+            for(int tx=0;tx<ntilesx;tx++)
+            {
+                for(int ty=0;ty<ntilesy;ty++)
+                {
+                    for(int tz=0;tz<ntilesz;tz++)
+                    {
+                        const int imin = (tx==0) ? -g : tx*TileNx;
+                        const int imax = (tx==ntilesx-1) ? Nx+g : (tx+1)*TileNx;
+                        const int jmin = (ty==0) ? -g : ty*TileNy;
+                        const int jmax = (ty==ntilesy-1) ? Ny+g : (ty+1)*TileNy;
+                        const int kmin = (tz==0) ? -g : tz*TileNz;
+                        const int kmax = (tz==ntilesz-1) ? Nz+g : (tz+1)*TileNz;
+                        for(int i=imin;i<imax;i++) for(int j=jmin;j<jmax;j++) for(int k=kmin;k<kmax;k++) f[index(i,j,k)] = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    // the offset of point i,j,k from point 0,0,0. i,j,k can be up to g outside the grid
+    inline int index(int i, int j, int k) const { return i*xstride + j*ystride + k; }
+    inline T& operator()(int i, int j, int k, int c = 0) { return storage[c*componentsize + offset0() + index(i,j,k)]; }
+    inline const T& operator()(int i, int j, int k, int c = 0) const { return storage[c*componentsize + offset0() + index(i,j,k)]; }
+    // pointer to point 0,0,0 of component c, which index() is relative to
+    inline T* origin(int c = 0) { return storage.data() + c*componentsize + offset0(); }
+    inline const T* origin(int c = 0) const { return storage.data() + c*componentsize + offset0(); }
+
+    // exchange the contents with another field, without copying
+    void swap(Field& other)
+    {
+        storage.swap(other.storage);
+        std::swap(Nx,other.Nx); std::swap(Ny,other.Ny); std::swap(Nz,other.Nz); std::swap(g,other.g); std::swap(components,other.components);
+        std::swap(xstride,other.xstride); std::swap(ystride,other.ystride); std::swap(componentsize,other.componentsize);
+    }
+
+    // copying to and from a plain unpadded array, laid out as pt()
+    template<typename S> void copy_to(vector<S>& out, int c = 0) const
+    {
+        out.resize((size_t)Nx*Ny*Nz);
+        for(int i=0;i<Nx;i++) for(int j=0;j<Ny;j++) for(int k=0;k<Nz;k++) out[((size_t)i*Ny+j)*Nz+k] = (*this)(i,j,k,c);
+    }
+    template<typename S> void copy_from(const vector<S>& in, int c = 0)
+    {
+        for(int i=0;i<Nx;i++) for(int j=0;j<Ny;j++) for(int k=0;k<Nz;k++) (*this)(i,j,k,c) = in[((size_t)i*Ny+j)*Nz+k];
+    }
+
+    // fill the ghost layers of component c from the grid, according to the boundary condition: reflecting boundaries mirror about the cell
+    // face (ghost -1 is a copy of 0), periodic ones wrap. the x faces are done first, then y and z over the already filled layers, so the
+    // edges and corners come out right too. the loops are omp for, so call this from every thread of a parallel region, or from outside one.
+    // xfaces=false leaves the x faces alone, for when they have been filled from elsewhere (see Decomposition.h)
+    template<BoundaryCondition BC> void fill_halo(int c = 0, bool xfaces = true)
+    {
+        T* f = origin(c);
+#pragma omp for
+        for(int j=0;j<(xfaces ? Ny : 0);j++)
+        {
+            for(int l=1;l<=g;l++)
+            {
+                const int ilow = ghostsource<BC>(-l,Nx,0);
+                const int ihigh = ghostsource<BC>(Nx-1+l,Nx,0);
+                for(int k=0;k<Nz;k++)
+                {
+                    f[index(-l,j,k)] = f[index(ilow,j,k)];
+                    f[index(Nx-1+l,j,k)] = f[index(ihigh,j,k)];
+                }
+            }
+        }
+#pragma omp for
+        for(int i=-g;i<Nx+g;i++)
+        {
+            for(int l=1;l<=g;l++)
+            {
+                const int jlow = ghostsource<BC>(-l,Ny,1);
+                const int jhigh = ghostsource<BC>(Ny-1+l,Ny,1);
+                for(int k=0;k<Nz;k++)
+                {
+                    f[index(i,-l,k)] = f[index(i,jlow,k)];
+                    f[index(i,Ny-1+l,k)] = f[index(i,jhigh,k)];
+                }
+            }
+        }
+#pragma omp for
+        for(int i=-g;i<Nx+g;i++)
+        {
+            for(int j=-g;j<Ny+g;j++)
+            {
+                for(int l=1;l<=g;l++)
+                {
+                    f[index(i,j,-l)] = f[index(i,j,ghostsource<BC>(-l,Nz,2))];
+                    f[index(i,j,Nz-1+l)] = f[index(i,j,ghostsource<BC>(Nz-1+l,Nz,2))];
+                }
+            }
+        }
+    }
+    // the same, for a boundary condition only known at run time
+    void fill_halo(BoundaryCondition boundarytype, int c = 0, bool xfaces = true)
+    {
+        switch(boundarytype)
+        {
+        case ALLREFLECTING: fill_halo<ALLREFLECTING>(c,xfaces); break;
+        case ZPERIODIC: fill_halo<ZPERIODIC>(c,xfaces); break;
+        case ALLPERIODIC: fill_halo<ALLPERIODIC>(c,xfaces); break;
+        }
+    }
+
+    int Nx,Ny,Nz,g,components;
+    int xstride,ystride,componentsize;
+
+private:
+    inline int offset0() const { return g*(xstride+ystride+1); }
+    // the grid point ghost point i (outside 0..N-1) takes its value from, along the given direction. the same as gridinc would give
+    template<BoundaryCondition BC> static int ghostsource(int i, int N, int direction)
+    {
+        if(BC == ALLPERIODIC || (BC == ZPERIODIC && direction == 2)) return (i < 0) ? i+N : i-N;
+        return (i < 0) ? -i-1 : 2*N-i-1;
+    }
+    vector<T,FieldAllocator<T> > storage;
+};
+
+#endif //FIELD_H
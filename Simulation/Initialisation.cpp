@@ -374,7 +374,7 @@ void phi_calc_surface(vector<double>&phi,vector<triangle>& knotsurface, const Gr
     print_B_phi(phi,griddata);
 
 }
-void phi_calc_manual(vector<double>&phi, Griddata& griddata)
+void phi_calc_manual(vector<double>&phi, const Griddata& griddata)
 {
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
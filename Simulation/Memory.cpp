@@ -0,0 +1,82 @@
+#include "Memory.h"
+#include <iostream>
+#include <vector>
+#include <set>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <omp.h>
+
+static const size_t PageBytes = 4096;
+static const size_t HugePageBytes = 2*1024*1024;
+// blocks at least this big are mapped fresh from the kernel, rather than coming off the heap, where some thread may already have touched them
+static const size_t MapThreshold = 1024*1024;
+
+static bool huge(size_t bytes)
+{
+    return HugePages && bytes >= HugePageBytes;
+}
+
+static size_t mapped_length(size_t bytes)
+{
+    const size_t page = huge(bytes) ? HugePageBytes : PageBytes;
+    return (bytes+page-1)/page*page;
+}
+
+void* field_allocate(size_t bytes)
+{
+    if(bytes < MapThreshold)
+    {
+        void* p = 0;
+        if(posix_memalign(&p, FieldAlignment, bytes ? bytes : 1) != 0) return 0;
+        return p;
+    }
+    // mmap gives page aligned memory, so a huge page aligned block is cut out of one a huge page bigger
+    const size_t length = mapped_length(bytes);
+    const size_t extra = huge(bytes) ? HugePageBytes : 0;
+    char* base = (char*)mmap(0, length+extra, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(base == (char*)MAP_FAILED) return 0;
+    char* p = base;
+    if(huge(bytes))
+    {
+        p = base + (HugePageBytes - (uintptr_t)base%HugePageBytes)%HugePageBytes;
+        if(p > base) munmap(base, p-base);
+        if(p+length < base+length+extra) munmap(p+length, base+length+extra-(p+length));
+#ifdef MADV_HUGEPAGE
+        madvise(p, length, MADV_HUGEPAGE);
+#endif
+    }
+    return p;
+}
+
+void field_deallocate(void* p, size_t bytes)
+{
+    if(!p) return;
+    if(bytes < MapThreshold) free(p);
+    else munmap(p, mapped_length(bytes));
+}
+
+void thread_layout_report()
+{
+    const int threads = omp_get_max_threads();
+    vector<int> cpus(threads,-1);
+    vector<int> nodes(threads,-1);
+#pragma omp parallel
+    {
+        unsigned cpu,node;
+        if(syscall(SYS_getcpu,&cpu,&node,0) == 0)
+        {
+            cpus[omp_get_thread_num()] = cpu;
+            nodes[omp_get_thread_num()] = node;
+        }
+    }
+    const char* bindnames[] = {"false", "true", "master", "close", "spread"};
+    const int bind = omp_get_proc_bind();
+    set<int> distinctnodes(nodes.begin(),nodes.end());
+    cout << threads << " threads, bound " << ((bind >= 0 && bind <= 4) ? bindnames[bind] : "?") << ", on " << distinctnodes.size() << " NUMA node(s). core/node of each thread:";
+    for(int t=0;t<threads;t++) cout << " " << cpus[t] << "/" << nodes[t];
+    cout << "\n";
+    if(bind == omp_proc_bind_false) cout << "the threads aren't bound to cores, so they can wander away from the pages they first touched. set OMP_PROC_BIND=close and OMP_PLACES=cores\n";
+}
@@ -0,0 +1,41 @@
+#include "FN_Constants.h"
+#include <cstddef>
+#include <new>
+#include <utility>
+using namespace std;
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+// where the memory behind the fields comes from. it is aligned to FieldAlignment bytes, and with HugePages the kernel is asked to back it with
+// 2MB pages. nothing is written to it when it is handed out, so that the first thread to write each page - and so the NUMA node the page
+// ends up on - is the one that sweeps it in the update (see Field::first_touch)
+void* field_allocate(size_t bytes);
+void field_deallocate(void* p, size_t bytes);
+
+// an allocator for vector that gets its memory from field_allocate, and leaves new elements uninitialised (they are all float or double)
+template<typename T>
+struct FieldAllocator
+{
+    typedef T value_type;
+    FieldAllocator() {}
+    template<typename U> FieldAllocator(const FieldAllocator<U>&) {}
+    T* allocate(size_t n)
+    {
+        void* p = field_allocate(n*sizeof(T));
+        if(!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t n) { field_deallocate(p,n*sizeof(T)); }
+    // default initialise rather than value initialise, which leaves a float or double alone
+    template<typename U> void construct(U* p) { ::new((void*)p) U; }
+    template<typename U, typename... Args> void construct(U* p, Args&&... args) { ::new((void*)p) U(std::forward<Args>(args)...); }
+    template<typename U> struct rebind { typedef FieldAllocator<U> other; };
+};
+template<typename T, typename U> bool operator==(const FieldAllocator<T>&, const FieldAllocator<U>&) { return true; }
+template<typename T, typename U> bool operator!=(const FieldAllocator<T>&, const FieldAllocator<U>&) { return false; }
+
+// print which core and NUMA node each OpenMP thread is running on, and whether the threads are bound to them. call from outside a parallel region
+void thread_layout_report();
+
+#endif //MEMORY_H
@@ -0,0 +1,420 @@
+#include "Parameters.h"
+#include "SnapshotCodec.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdlib.h>
+#include <errno.h>
+
+// the run parameters, at their defaults. the ones left at 0 with no sensible default have to be set (see parameters_done)
+int option = FROM_SURFACE_FILE;
+string knot_filename = "";
+string B_filename = "";
+int NumComponents = 1;
+BoundaryCondition BoundaryType = ALLPERIODIC;
+bool PreserveRatios = 0;
+double TTime = 0;
+double UVPrintTime = 0;
+double VelocityKnotplotPrintTime = 0;
+double FrequentKnotplotPrintTime = 0;
+double InitialSkipTime = 0;
+double CheckpointTime = 0;
+int UVFileFormat = VTK_UV_FILE;
+int UVCodec = UV_CODEC_SHUFFLE_LZ;
+double UVErrorBound = 1e-4;
+bool UVFilePerField = 0;
+bool AsyncAnalysis = 0;
+int AnalysisQueueLength = 2;
+bool AnalysisDropWhenFull = 0;
+bool AsyncOutput = 0;
+int OutputQueueLength = 1;
+int OutputThreads = 2;
+bool CrossgradBand = 0;
+int CrossgradBandBlock = 8;
+double CrossgradBandMargin = 6;
+int CrossgradFullTraces = 10;
+bool NewtonTracing = 0;
+int BatchPointsPerThread = 500000;
+int BatchSkipLimit = 4;
+double initialh = 0;
+int initialNx = 0;
+int initialNy = 0;
+int initialNz = 0;
+int interpolationflag = 1;
+int interpolatedNx = 0;
+int interpolatedNy = 0;
+int interpolatedNz = 0;
+double dtime = 0;
+int TimeIntegrator = RK4;
+int TimeBlockSteps = 1;
+int TimeBlockNy = 64;
+int TimeBlockNz = 128;
+int NumStageArrays = 4;
+bool ActiveRegionUpdate = 0;
+int ActiveBrickNx = 8;
+int ActiveBrickNy = 8;
+int ActiveBrickNz = 32;
+double ActiveTolerance = 1e-3;
+int ActiveCheckSteps = 10;
+int ActiveFullSweepSteps = 1000;
+bool AdaptiveRefinement = 0;
+int RefinementRatio = 2;
+int RefinePatchSize = 8;
+double RefineThreshold = 0.3;
+int RefineBuffer = 1;
+double RegridTime = 1;
+bool BlockedUpdate = 1;
+int TileNx = 32;
+int TileNy = 8;
+int TileNz = 256;
+int SimdPath = SIMD_AUTO;
+bool KernelBenchmark = 0;
+bool FirstTouch = 1;
+int FieldAlignment = 64;
+bool HugePages = 0;
+bool PlacementBenchmark = 0;
+bool BoxResizeFlag = 0;
+double BoxResizeTime = 1000;
+double xmax = 0;
+double ymax = 0;
+double zmax = 0;
+double initialthetarotation = 0;
+double initialxdisplacement = 0;
+double initialydisplacement = 0;
+double initialzdisplacement = 0;
+double lambda = 21.3;
+double epsilon = ScrollWaveEpsilon;
+double beta = ScrollWaveBeta;
+double gam = ScrollWaveGam;
+
+// the names integer parameters can be given by
+struct NamedValue
+{
+    const char* name;
+    int value;
+};
+static const NamedValue InitialisationNames[] = {{"FROM_SURFACE_FILE",FROM_SURFACE_FILE}, {"FROM_CURVE_FILE",FROM_CURVE_FILE}, {"FROM_UV_FILE",FROM_UV_FILE}, {"FROM_FUNCTION",FROM_FUNCTION}, {"FROM_CHECKPOINT",FROM_CHECKPOINT}, {NULL,0}};
+static const NamedValue UVFileNames[] = {{"VTK_UV_FILE",VTK_UV_FILE}, {"COMPRESSED_UV_FILE",COMPRESSED_UV_FILE}, {"VTI_UV_FILE",VTI_UV_FILE}, {NULL,0}};
+static const NamedValue UVCodecNames[] = {{"UV_CODEC_SHUFFLE_LZ",UV_CODEC_SHUFFLE_LZ}, {"UV_CODEC_ERROR_BOUNDED",UV_CODEC_ERROR_BOUNDED}, {NULL,0}};
+static const NamedValue BoundaryNames[] = {{"ALLREFLECTING",ALLREFLECTING}, {"ZPERIODIC",ZPERIODIC}, {"ALLPERIODIC",ALLPERIODIC}, {NULL,0}};
+static const NamedValue IntegratorNames[] = {{"RK4",RK4}, {"LOWSTORAGE_RK",LOWSTORAGE_RK}, {"IMEX_SPECTRAL",IMEX_SPECTRAL}, {NULL,0}};
+static const NamedValue SimdNames[] = {{"SIMD_SCALAR",SIMD_SCALAR}, {"SIMD_AVX2",SIMD_AVX2}, {"SIMD_AVX512",SIMD_AVX512}, {"SIMD_AUTO",SIMD_AUTO}, {NULL,0}};
+
+enum ParameterType {INT_PARAMETER, BOOL_PARAMETER, DOUBLE_PARAMETER, STRING_PARAMETER, BOUNDARY_PARAMETER};
+struct Parameter
+{
+    const char* name;
+    const char* insertname;      // what the sed templated FN_Constants.h called it, or NULL
+    ParameterType type;
+    void* value;
+    const NamedValue* names;     // for an integer, the names it can be given by, or NULL
+};
+static const Parameter Parameters[] = {
+    {"option", "INSERT_INITIALISATION_TYPE", INT_PARAMETER, &option, InitialisationNames},
+    {"knot_filename", "INSERT_SURFACE_FILENAME", STRING_PARAMETER, &knot_filename, NULL},
+    {"B_filename", "INSERT_UV_FILENAME", STRING_PARAMETER, &B_filename, NULL},
+    {"NumComponents", NULL, INT_PARAMETER, &NumComponents, NULL},
+    {"BoundaryType", NULL, BOUNDARY_PARAMETER, &BoundaryType, BoundaryNames},
+    {"PreserveRatios", NULL, BOOL_PARAMETER, &PreserveRatios, NULL},
+    {"TTime", "INSERT_RUNTIME", DOUBLE_PARAMETER, &TTime, NULL},
+    {"UVPrintTime", "INSERT_UVPRINTTIME", DOUBLE_PARAMETER, &UVPrintTime, NULL},
+    {"VelocityKnotplotPrintTime", "INSERT_VELOCITYPRINTTIME", DOUBLE_PARAMETER, &VelocityKnotplotPrintTime, NULL},
+    {"FrequentKnotplotPrintTime", "INSERT_FREQUENTPRINTTIME", DOUBLE_PARAMETER, &FrequentKnotplotPrintTime, NULL},
+    {"InitialSkipTime", "INSERT_SKIPTIME", DOUBLE_PARAMETER, &InitialSkipTime, NULL},
+    {"CheckpointTime", NULL, DOUBLE_PARAMETER, &CheckpointTime, NULL},
+    {"UVFileFormat", NULL, INT_PARAMETER, &UVFileFormat, UVFileNames},
+    {"UVCodec", NULL, INT_PARAMETER, &UVCodec, UVCodecNames},
+    {"UVErrorBound", NULL, DOUBLE_PARAMETER, &UVErrorBound, NULL},
+    {"UVFilePerField", NULL, BOOL_PARAMETER, &UVFilePerField, NULL},
+    {"AsyncAnalysis", NULL, BOOL_PARAMETER, &AsyncAnalysis, NULL},
+    {"AnalysisQueueLength", NULL, INT_PARAMETER, &AnalysisQueueLength, NULL},
+    {"AnalysisDropWhenFull", NULL, BOOL_PARAMETER, &AnalysisDropWhenFull, NULL},
+    {"AsyncOutput", NULL, BOOL_PARAMETER, &AsyncOutput, NULL},
+    {"OutputQueueLength", NULL, INT_PARAMETER, &OutputQueueLength, NULL},
+    {"OutputThreads", NULL, INT_PARAMETER, &OutputThreads, NULL},
+    {"CrossgradBand", NULL, BOOL_PARAMETER, &CrossgradBand, NULL},
+    {"CrossgradBandBlock", NULL, INT_PARAMETER, &CrossgradBandBlock, NULL},
+    {"CrossgradBandMargin", NULL, DOUBLE_PARAMETER, &CrossgradBandMargin, NULL},
+    {"CrossgradFullTraces", NULL, INT_PARAMETER, &CrossgradFullTraces, NULL},
+    {"NewtonTracing", NULL, BOOL_PARAMETER, &NewtonTracing, NULL},
+    {"BatchPointsPerThread", NULL, INT_PARAMETER, &BatchPointsPerThread, NULL},
+    {"BatchSkipLimit", NULL, INT_PARAMETER, &BatchSkipLimit, NULL},
+    {"initialh", "INSERT_GRIDSPACING", DOUBLE_PARAMETER, &initialh, NULL},
+    {"initialNx", "INSERT_NX", INT_PARAMETER, &initialNx, NULL},
+    {"initialNy", "INSERT_NY", INT_PARAMETER, &initialNy, NULL},
+    {"initialNz", "INSERT_NZ", INT_PARAMETER, &initialNz, NULL},
+    {"interpolationflag", "INSERT_INTERPOLATION_FLAG", INT_PARAMETER, &interpolationflag, NULL},
+    {"interpolatedNx", "INSERT_INTERPOLATED_NX", INT_PARAMETER, &interpolatedNx, NULL},
+    {"interpolatedNy", "INSERT_INTERPOLATED_NY", INT_PARAMETER, &interpolatedNy, NULL},
+    {"interpolatedNz", "INSERT_INTERPOLATED_NZ", INT_PARAMETER, &interpolatedNz, NULL},
+    {"dtime", "INSERT_TIMESTEP", DOUBLE_PARAMETER, &dtime, NULL},
+    {"TimeIntegrator", NULL, INT_PARAMETER, &TimeIntegrator, IntegratorNames},
+    {"TimeBlockSteps", NULL, INT_PARAMETER, &TimeBlockSteps, NULL},
+    {"TimeBlockNy", NULL, INT_PARAMETER, &TimeBlockNy, NULL},
+    {"TimeBlockNz", NULL, INT_PARAMETER, &TimeBlockNz, NULL},
+    {"ActiveRegionUpdate", NULL, BOOL_PARAMETER, &ActiveRegionUpdate, NULL},
+    {"ActiveBrickNx", NULL, INT_PARAMETER, &ActiveBrickNx, NULL},
+    {"ActiveBrickNy", NULL, INT_PARAMETER, &ActiveBrickNy, NULL},
+    {"ActiveBrickNz", NULL, INT_PARAMETER, &ActiveBrickNz, NULL},
+    {"ActiveTolerance", NULL, DOUBLE_PARAMETER, &ActiveTolerance, NULL},
+    {"ActiveCheckSteps", NULL, INT_PARAMETER, &ActiveCheckSteps, NULL},
+    {"ActiveFullSweepSteps", NULL, INT_PARAMETER, &ActiveFullSweepSteps, NULL},
+    {"AdaptiveRefinement", NULL, BOOL_PARAMETER, &AdaptiveRefinement, NULL},
+    {"RefinementRatio", NULL, INT_PARAMETER, &RefinementRatio, NULL},
+    {"RefinePatchSize", NULL, INT_PARAMETER, &RefinePatchSize, NULL},
+    {"RefineThreshold", NULL, DOUBLE_PARAMETER, &RefineThreshold, NULL},
+    {"RefineBuffer", NULL, INT_PARAMETER, &RefineBuffer, NULL},
+    {"RegridTime", NULL, DOUBLE_PARAMETER, &RegridTime, NULL},
+    {"BlockedUpdate", NULL, BOOL_PARAMETER, &BlockedUpdate, NULL},
+    {"TileNx", NULL, INT_PARAMETER, &TileNx, NULL},
+    {"TileNy", NULL, INT_PARAMETER, &TileNy, NULL},
+    {"TileNz", NULL, INT_PARAMETER, &TileNz, NULL},
+    {"SimdPath", NULL, INT_PARAMETER, &SimdPath, SimdNames},
+    {"KernelBenchmark", NULL, BOOL_PARAMETER, &KernelBenchmark, NULL},
+    {"FirstTouch", NULL, BOOL_PARAMETER, &FirstTouch, NULL},
+    {"FieldAlignment", NULL, INT_PARAMETER, &FieldAlignment, NULL},
+    {"HugePages", NULL, BOOL_PARAMETER, &HugePages, NULL},
+    {"PlacementBenchmark", NULL, BOOL_PARAMETER, &PlacementBenchmark, NULL},
+    {"BoxResizeFlag", NULL, BOOL_PARAMETER, &BoxResizeFlag, NULL},
+    {"BoxResizeTime", NULL, DOUBLE_PARAMETER, &BoxResizeTime, NULL},
+    {"xmax", NULL, DOUBLE_PARAMETER, &xmax, NULL},
+    {"ymax", NULL, DOUBLE_PARAMETER, &ymax, NULL},
+    {"zmax", NULL, DOUBLE_PARAMETER, &zmax, NULL},
+    {"initialthetarotation", NULL, DOUBLE_PARAMETER, &initialthetarotation, NULL},
+    {"initialxdisplacement", NULL, DOUBLE_PARAMETER, &initialxdisplacement, NULL},
+    {"initialydisplacement", NULL, DOUBLE_PARAMETER, &initialydisplacement, NULL},
+    {"initialzdisplacement", NULL, DOUBLE_PARAMETER, &initialzdisplacement, NULL},
+    {"lambda", NULL, DOUBLE_PARAMETER, &lambda, NULL},
+    {"epsilon", NULL, DOUBLE_PARAMETER, &epsilon, NULL},
+    {"beta", NULL, DOUBLE_PARAMETER, &beta, NULL},
+    {"gam", NULL, DOUBLE_PARAMETER, &gam, NULL},
+};
+static const int NumParameters = sizeof(Parameters)/sizeof(Parameters[0]);
+
+static string trim(const string& s)
+{
+    const size_t first = s.find_first_not_of(" \t\r");
+    if(first == string::npos) return "";
+    const size_t last = s.find_last_not_of(" \t\r");
+    return s.substr(first,last-first+1);
+}
+
+// an integer, or one of the names it goes by
+static bool parse_int(const string& text, const NamedValue* names, int& value)
+{
+    for(int n=0;names && names[n].name;n++)
+    {
+        if(text == names[n].name)
+        {
+            value = names[n].value;
+            return true;
+        }
+    }
+    char* end;
+    errno = 0;
+    const long parsed = strtol(text.c_str(),&end,10);
+    if(text.empty() || *end != '\0' || errno != 0) return false;
+    value = (int)parsed;
+    return true;
+}
+
+bool set_parameter(const string& name, const string& valuetext)
+{
+    string text = trim(valuetext);
+    if(text.size() >= 2 && (text[0] == '"' || text[0] == '\'') && text[text.size()-1] == text[0]) text = text.substr(1,text.size()-2);
+    for(int p=0;p<NumParameters;p++)
+    {
+        const Parameter& parameter = Parameters[p];
+        if(name != parameter.name && !(parameter.insertname && name == parameter.insertname)) continue;
+        bool ok = true;
+        switch(parameter.type)
+        {
+        case INT_PARAMETER:
+            ok = parse_int(text, parameter.names, *(int*)parameter.value);
+            break;
+        case BOUNDARY_PARAMETER:
+        {
+            int boundary;
+            ok = parse_int(text, parameter.names, boundary) && boundary >= ALLREFLECTING && boundary <= ALLPERIODIC;
+            if(ok) *(BoundaryCondition*)parameter.value = (BoundaryCondition)boundary;
+            break;
+        }
+        case BOOL_PARAMETER:
+        {
+            int flag;
+            if(text == "true") flag = 1;
+            else if(text == "false") flag = 0;
+            else ok = parse_int(text, NULL, flag) && (flag == 0 || flag == 1);
+            if(ok) *(bool*)parameter.value = flag;
+            break;
+        }
+        case DOUBLE_PARAMETER:
+        {
+            char* end;
+            const double parsed = strtod(text.c_str(),&end);
+            ok = !text.empty() && *end == '\0';
+            if(ok) *(double*)parameter.value = parsed;
+            break;
+        }
+        case STRING_PARAMETER:
+            *(string*)parameter.value = text;
+            break;
+        }
+        if(!ok) cout << "can't read the value " << text << " given for " << name << "\n";
+        return ok;
+    }
+    // old job directories' parameters files carry INSERT_ names the code no longer uses (INSERT_RADIUS, for one), which are passed over
+    if(name.compare(0,7,"INSERT_") == 0)
+    {
+        cout << "ignoring " << name << ", which is no longer used\n";
+        return true;
+    }
+    cout << "unknown parameter " << name << "\n";
+    return false;
+}
+
+bool read_parameter_file(const string& filename)
+{
+    ifstream in(filename.c_str());
+    if(!in)
+    {
+        cout << "can't open the parameters file " << filename << "\n";
+        return false;
+    }
+    string line;
+    int linenumber = 0;
+    while(getline(in,line))
+    {
+        linenumber++;
+        const size_t hash = line.find('#');
+        if(hash != string::npos) line.erase(hash);
+        line = trim(line);
+        if(line.empty()) continue;
+        const size_t equals = line.find('=');
+        if(equals == string::npos)
+        {
+            cout << filename << " line " << linenumber << ": expected NAME=value\n";
+            return false;
+        }
+        if(!set_parameter(trim(line.substr(0,equals)), line.substr(equals+1)))
+        {
+            cout << "(" << filename << " line " << linenumber << ")\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_parameters(int argc, char** argv, string& manifest)
+{
+    // the file first, so that the command line goes over the top of it
+    string filename;
+    for(int a=1;a<argc;a++)
+    {
+        if(string(argv[a]) == "--parameters" && a+1 < argc) filename = argv[a+1];
+    }
+    if(filename.empty() && ifstream("parameters")) filename = "parameters";
+    if(!filename.empty() && !read_parameter_file(filename)) return false;
+    for(int a=1;a<argc;a++)
+    {
+        const string arg = argv[a];
+        const size_t equals = arg.find('=');
+        bool ok = true;
+        if(arg == "ALLREFLECTING" || arg == "ZPERIODIC" || arg == "ALLPERIODIC") ok = set_parameter("BoundaryType",arg);
+        else if(arg == "--parameters" && a+1 < argc) a++;
+        else if(arg == "--surface" && a+1 < argc) ok = set_parameter("knot_filename",argv[++a]);
+        else if(arg == "--grid" && a+4 < argc)
+        {
+            ok = set_parameter("initialNx",argv[a+1]) && set_parameter("initialNy",argv[a+2]) && set_parameter("initialNz",argv[a+3]) && set_parameter("initialh",argv[a+4]);
+            a += 4;
+        }
+        else if(arg == "--batch" && a+1 < argc) manifest = argv[++a];
+        else if(equals != string::npos && equals > 0) ok = set_parameter(arg.substr(0,equals),arg.substr(equals+1));
+        else
+        {
+            cout << "unknown argument " << arg << ", expected NAME=value, a boundary type (ALLREFLECTING, ZPERIODIC or ALLPERIODIC), --parameters <file>, --surface <name>, --grid <Nx> <Ny> <Nz> <h> or --batch <manifest>\n";
+            return false;
+        }
+        if(!ok) return false;
+    }
+    return true;
+}
+
+bool parameters_done()
+{
+    bool ok = true;
+    if(initialNx < 1 || initialNy < 1 || initialNz < 1 || initialh <= 0)
+    {
+        cout << "the grid has to be set: initialNx, initialNy, initialNz and initialh\n";
+        ok = false;
+    }
+    if(dtime <= 0)
+    {
+        cout << "the timestep dtime has to be set\n";
+        ok = false;
+    }
+    // the main loop prints on whole numbers of steps, so each of these has to be at least one
+    if(ok && (UVPrintTime < dtime || VelocityKnotplotPrintTime < dtime || FrequentKnotplotPrintTime < dtime))
+    {
+        cout << "the print times UVPrintTime, VelocityKnotplotPrintTime and FrequentKnotplotPrintTime have to be set, and at least dtime\n";
+        ok = false;
+    }
+    if(AsyncOutput && (OutputQueueLength < 1 || OutputThreads < 1))
+    {
+        cout << "AsyncOutput needs OutputQueueLength and OutputThreads of at least 1\n";
+        ok = false;
+    }
+    if(UVFileFormat == COMPRESSED_UV_FILE && (!snapshot_codec(UVCodec) || (UVCodec == UV_CODEC_ERROR_BOUNDED && UVErrorBound <= 0)))
+    {
+        cout << "compressed uv files need a UVCodec, and UV_CODEC_ERROR_BOUNDED a UVErrorBound above 0\n";
+        ok = false;
+    }
+    if(ok && CheckpointTime != 0 && CheckpointTime < dtime)
+    {
+        cout << "CheckpointTime has to be 0, for no checkpoints, or at least dtime\n";
+        ok = false;
+    }
+    if(!ok) return false;
+    if(xmax == 0) xmax = 8*initialNx*initialh/10.0;
+    if(ymax == 0) ymax = 8*initialNy*initialh/10.0;
+    if(zmax == 0) zmax = 8*initialNz*initialh/10.0;
+    if(interpolatedNx == 0) interpolatedNx = initialNx;
+    if(interpolatedNy == 0) interpolatedNy = initialNy;
+    if(interpolatedNz == 0) interpolatedNz = initialNz;
+    NumStageArrays = (TimeIntegrator!=RK4 || TimeBlockSteps > 1) ? 1 : 4;
+    return true;
+}
+
+void write_parameters(ostream& out)
+{
+    const streamsize precision = out.precision();
+    for(int p=0;p<NumParameters;p++)
+    {
+        const Parameter& parameter = Parameters[p];
+        out << parameter.name << "=";
+        switch(parameter.type)
+        {
+        case INT_PARAMETER:
+        case BOUNDARY_PARAMETER:
+        {
+            const int value = (parameter.type == INT_PARAMETER) ? *(int*)parameter.value : (int)*(BoundaryCondition*)parameter.value;
+            const char* name = NULL;
+            for(int n=0;parameter.names && parameter.names[n].name;n++) if(parameter.names[n].value == value) name = parameter.names[n].name;
+            if(name) out << name;
+            else out << value;
+            break;
+        }
+        case BOOL_PARAMETER:
+            out << (*(bool*)parameter.value ? 1 : 0);
+            break;
+        case DOUBLE_PARAMETER:
+            out << setprecision(17) << *(double*)parameter.value;
+            break;
+        case STRING_PARAMETER:
+            out << "\"" << *(string*)parameter.value << "\"";
+            break;
+        }
+        out << "\n";
+    }
+    out.precision(precision);
+}
@@ -0,0 +1,30 @@
+#include "FN_Constants.h"
+#include <iostream>
+#include <string>
+using namespace std;
+
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+// the run parameters - every OPTION in FN_Constants.h bar the BUILD OPTIONs - are set when the code starts rather than compiled in. they come
+// from a parameters file of NAME=value lines, laid out like Simulation/parameters (the INSERT_ names it uses are understood too), with
+// anything after a # ignored, and quotes around a value dropped. integer options with names, like option or TimeIntegrator, take the
+// name (FROM_UV_FILE, IMEX_SPECTRAL). then the command line is read, in order:
+//   NAME=value                 a parameter, over the top of the file
+//   ALLREFLECTING, ZPERIODIC or ALLPERIODIC   the boundary condition, the same as BoundaryType=...
+//   --parameters <file>        the parameters file. if it isn't given, ./parameters is read if there is one
+//   --surface <name>           the same as knot_filename=<name>
+//   --grid <Nx> <Ny> <Nz> <h>  the same as initialNx=<Nx> initialNy=<Ny> initialNz=<Nz> initialh=<h>
+//   --batch <manifest>         launch a batch of simulations instead (see BatchLauncher.h), whose name is put in manifest
+// returns false, having said why, if anything can't be read or isn't a known parameter
+bool read_parameters(int argc, char** argv, string& manifest);
+// read the lines of a parameters file, or set one parameter from its value as text, in the same way
+bool read_parameter_file(const string& filename);
+bool set_parameter(const string& name, const string& value);
+// check the parameters make sense for a run, and work out the things that follow from them (xmax, ymax, zmax, NumStageArrays, and the
+// interpolated grid, which left at 0 is the grid). returns false, having said why, if they don't
+bool parameters_done();
+// every parameter as NAME=value lines, which read_parameter_file reads back
+void write_parameters(ostream& out);
+
+#endif //PARAMETERS_H
@@ -1,94 +1,193 @@
 #include "ReadingWriting.h"
 #include "FN_Constants.h"
 #include "FN_Knot.h"
+#include "Decomposition.h"
+#include "SnapshotCodec.h"
+#include "VTIFile.h"
+#include "VTKUVFile.h"
+#include "Resample.h"
 #include <string.h>
+#include <algorithm>
+#include <omp.h>
 
-int uvfile_read_BINARY(vector<double>&u, vector<double>&v,const Griddata& griddata)
+#ifdef USE_MPI
+// the file layout of this rank's slab of a scalar section of a uv file: the sections are k slowest, i fastest, so a slab along x is Ny*Nz
+// runs of Nx floats
+static MPI_Datatype slab_filetype(const Griddata& slabgriddata)
 {
-    int Nx = griddata.Nx;
-    int Ny = griddata.Ny;
-    int Nz = griddata.Nz;
-    string temp,buff;
+    int sizes[3] = {slabgriddata.Nz, slabgriddata.Ny, decomposition().globalNx};
+    int subsizes[3] = {slabgriddata.Nz, slabgriddata.Ny, slabgriddata.Nx};
+    int starts[3] = {0, 0, decomposition().xoffset};
+    MPI_Datatype filetype;
+    MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &filetype);
+    MPI_Type_commit(&filetype);
+    return filetype;
+}
+
+// the same file print_uv writes, with each rank writing its own slab of each section. rank 0 writes the text between them
+template<typename Store>
+void print_uv_slabs( Field<Store>&u, Field<Store>&v, vector<double>&ucvmag, double t, const Griddata& slabgriddata)
+{
+    const Griddata griddata = whole_griddata(slabgriddata);
+    const int Nx = slabgriddata.Nx;
+    const int Ny = slabgriddata.Ny;
+    const int Nz = slabgriddata.Nz;
+    double h = griddata.h;
     stringstream ss;
-    ifstream fin (B_filename.c_str(), std::ios::in  | std::ios::binary);
-    int i,j,k,n;
+    ss << "uv_plot" << t << ".vtk";
 
-    for(i=0;i<10;i++)
+    stringstream header;
+    header << "# vtk DataFile Version 3.0\nUV fields\nBINARY\nDATASET STRUCTURED_POINTS\n";
+    header << "DIMENSIONS " << griddata.Nx << ' ' << Ny << ' ' << Nz << '\n';
+    header << "ORIGIN " << x(0,griddata) << ' ' << y(0,griddata) << ' ' << z(0,griddata) << '\n';
+    header << "SPACING " << h << ' ' << h << ' ' << h << '\n';
+    header << "POINT_DATA " << griddata.Nx*Ny*Nz << '\n';
+    header << "SCALARS u float\nLOOKUP_TABLE default\n";
+    const string text[3] = {header.str(), "\nSCALARS v float\nLOOKUP_TABLE default\n", "\nSCALARS ucrossv float\nLOOKUP_TABLE default\n"};
+    const MPI_Offset sectionbytes = (MPI_Offset)sizeof(float)*griddata.Nx*Ny*Nz;
+    MPI_Offset offsets[3];
+    MPI_Offset textoffsets[3] = {0, 0, 0};
+    for(int section=0;section<3;section++)
     {
-        if(fin.good())
-        {
-            if(getline(fin,buff)) temp = buff;
-        }
-        else
-        {
-            cout << "Something went wrong!\n";
-            return 1;
-        }
+        if(section > 0) textoffsets[section] = offsets[section-1] + sectionbytes;
+        offsets[section] = textoffsets[section] + text[section].size();
     }
 
-    for(k=0; k<Nz; k++)
+    MPI_File fh;
+    MPI_File_open(MPI_COMM_WORLD, (char*)ss.str().c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    MPI_File_set_size(fh, 0);
+    if(decomposition().rank == 0)
     {
-        for(j=0; j<Ny; j++)
+        for(int section=0;section<3;section++) MPI_File_write_at(fh, textoffsets[section], (char*)text[section].data(), (int)text[section].size(), MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+    MPI_Datatype filetype = slab_filetype(slabgriddata);
+    vector<float> slab((size_t)Nx*Ny*Nz);
+    for(int section=0;section<3;section++)
+    {
+        int n = 0;
+        for(int k=0; k<Nz; k++)
         {
-            for(i=0; i<Nx; i++)
+            for(int j=0; j<Ny; j++)
             {
-                n=pt(i,j,k,griddata);
-                char* memblock;
-                char* swapped;
-                memblock = new char [sizeof(float)];
-                swapped = new char [sizeof(float)];
-                fin.read(memblock,sizeof(float));
-                ByteSwap(memblock, swapped);
-                float value = 12;
-                memcpy(&value, swapped, 4);
-                u[n] = value;
-                delete[] memblock;
-                delete[] swapped;
+                for(int i=0; i<Nx; i++)
+                {
+                    if(section==0) slab[n++] = FloatSwap(u(i,j,k));
+                    else if(section==1) slab[n++] = FloatSwap(v(i,j,k));
+                    else slab[n++] = FloatSwap(ucvmag[pt(i,j,k,slabgriddata)]);
+                }
             }
         }
+        MPI_File_set_view(fh, offsets[section], MPI_FLOAT, filetype, (char*)"native", MPI_INFO_NULL);
+        MPI_File_write_all(fh, slab.data(), (int)slab.size(), MPI_FLOAT, MPI_STATUS_IGNORE);
     }
+    MPI_Type_free(&filetype);
+    MPI_File_close(&fh);
+}
+#endif
 
-    for(i=0;i<3;i++)
+// the sections u and v of a legacy VTK uv file (see VTKUVFile.h), which is mapped in and swapped into place over the threads. each rank
+// keeps its own slab of the grid
+template<typename Store>
+int uvfile_read_BINARY(Field<Store>&u, Field<Store>&v, const Griddata& slabgriddata)
+{
+    const Griddata griddata = whole_griddata(slabgriddata);
+    VTKUVGrid grid;
+    if(!read_vtk_uv_grid(B_filename,grid)) return 1;
+    if(grid.Nx != griddata.Nx || grid.Ny != griddata.Ny || grid.Nz != griddata.Nz)
     {
-        if(fin.good())
-        {
-            if(getline(fin,buff)) temp = buff;
-        }
-        else
+        cout << B_filename << " is on a " << grid.Nx << "x" << grid.Ny << "x" << grid.Nz << " grid, and this run is set up for " << griddata.Nx << "x" << griddata.Ny << "x" << griddata.Nz << "\n";
+        return 1;
+    }
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    const int slabNx = slabgriddata.Nx;
+    const int xoffset = decomposition().xoffset;
+    const bool ok = read_vtk_uv(B_filename, 2, [&](int section, const char* values)
+    {
+        Field<Store>& f = (section==0) ? u : v;
+        const size_t plane = (size_t)Nx*Ny;
+#pragma omp parallel for collapse(2) schedule(static) if(!omp_in_parallel())
+        for(int i=0; i<slabNx; i++)
         {
-            cout << "Something went wrong!\n";
-            return 1;
+            for(int j=0; j<Ny; j++)
+            {
+                const size_t column = (size_t)j*Nx + xoffset + i;
+#pragma omp simd
+                for(int k=0; k<Nz; k++) f(i,j,k) = vtk_uv_value(values, column + k*plane);
+            }
         }
+    });
+    return ok ? 0 : 1;
+}
+
+// each rank keeps its own slab of the grid, as the planes come out of the file
+template<typename Store>
+int uvfile_read_COMPRESSED(Field<Store>&u, Field<Store>&v, const Griddata& slabgriddata)
+{
+    const Griddata griddata = whole_griddata(slabgriddata);
+    CompressedUVHeader header;
+    if(!read_compressed_uv_header(B_filename,header)) return 1;
+    if(header.Nx != griddata.Nx || header.Ny != griddata.Ny || header.Nz != griddata.Nz)
+    {
+        cout << B_filename << " is on a " << header.Nx << "x" << header.Ny << "x" << header.Nz << " grid, and this run is set up for " << griddata.Nx << "x" << griddata.Ny << "x" << griddata.Nz << "\n";
+        return 1;
     }
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int slabNx = slabgriddata.Nx;
+    const int xoffset = decomposition().xoffset;
+    const bool ok = read_compressed_uv(B_filename, 2, [&](int section, int k0, int k1, const float* values)
+    {
+        Field<Store>& f = (section==0) ? u : v;
+        for(int k=k0; k<k1; k++) for(int j=0; j<Ny; j++) for(int i=0; i<slabNx; i++) f(i,j,k) = values[((size_t)(k-k0)*Ny+j)*Nx+xoffset+i];
+    });
+    return ok ? 0 : 1;
+}
 
-    for(k=0; k<Nz; k++)
+// u from the array u of the .vti B_filename, and v from its array v - or, if B_filename is the u of a file per field (uv_plot<t>_u.vti), from
+// the array v of uv_plot<t>_v.vti. each rank keeps its own slab of the grid
+template<typename Store>
+int uvfile_read_VTI(Field<Store>&u, Field<Store>&v, const Griddata& slabgriddata)
+{
+    const Griddata griddata = whole_griddata(slabgriddata);
+    VTIGrid grid;
+    if(!read_vti_grid(B_filename,grid)) return 1;
+    if(grid.Nx != griddata.Nx || grid.Ny != griddata.Ny || grid.Nz != griddata.Nz)
     {
-        for(j=0; j<Ny; j++)
+        cout << B_filename << " is on a " << grid.Nx << "x" << grid.Ny << "x" << grid.Nz << " grid, and this run is set up for " << griddata.Nx << "x" << griddata.Ny << "x" << griddata.Nz << "\n";
+        return 1;
+    }
+    string vfilename = B_filename;
+    const size_t perfield = vfilename.rfind("_u.vti");
+    if(perfield != string::npos && perfield + 6 == vfilename.size()) vfilename.replace(perfield,6,"_v.vti");
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    const int slabNx = slabgriddata.Nx;
+    const int xoffset = decomposition().xoffset;
+    for(int f=0; f<2; f++)
+    {
+        Field<Store>& field = (f==0) ? u : v;
+        const bool ok = read_vti_array((f==0) ? B_filename : vfilename, (f==0) ? "u" : "v", [&](const float* values)
         {
-            for(i=0; i<Nx; i++)
+#pragma omp parallel for collapse(2) schedule(static) if(!omp_in_parallel())
+            for(int i=0; i<slabNx; i++)
             {
-                n=pt(i,j,k,griddata);
-                char* memblock;
-                char* swapped;
-                memblock = new char [sizeof(float)];
-                swapped = new char [sizeof(float)];
-                fin.read(memblock,sizeof(float));
-                ByteSwap(memblock, swapped);
-                float value = 12;
-                memcpy(&value, swapped, 4);
-                v[n] = value;
-                delete[] memblock;
-                delete[] swapped;
+                for(int j=0; j<Ny; j++)
+                {
+                    const float* column = values + (size_t)j*Nx + xoffset + i;
+                    for(int k=0; k<Nz; k++) field(i,j,k) = column[(size_t)k*Nx*Ny];
+                }
             }
-        }
+        });
+        if(!ok) return 1;
     }
-
-    fin.close();
-
     return 0;
 }
 
-int uvfile_read_ASCII(vector<double>&u, vector<double>&v,const Griddata& griddata)
+template<typename Store>
+int uvfile_read_ASCII(Field<Store>&u, Field<Store>&v,const Griddata& griddata)
 {
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
@@ -96,7 +195,7 @@ int uvfile_read_ASCII(vector<double>&u, vector<double>&v,const Griddata& griddat
     string temp,buff;
     stringstream ss;
     ifstream fin (B_filename.c_str());
-    int i,j,k,n;
+    int i,j,k;
 
     for(i=0;i<10;i++)
     {
@@ -117,7 +216,6 @@ int uvfile_read_ASCII(vector<double>&u, vector<double>&v,const Griddata& griddat
         {
             for(i=0; i<Nx; i++)
             {
-                n=pt(i,j,k,griddata);
                 ss.clear();
                 ss.str("");
                 if(fin.good())
@@ -125,7 +223,7 @@ int uvfile_read_ASCII(vector<double>&u, vector<double>&v,const Griddata& griddat
                     if(getline(fin,buff))
                     {
                         ss << buff;
-                        ss >> u[n];
+                        ss >> u(i,j,k);
                     }
                 }
                 else
@@ -156,13 +254,12 @@ int uvfile_read_ASCII(vector<double>&u, vector<double>&v,const Griddata& griddat
         {
             for(i=0; i<Nx; i++)
             {
-                n=pt(i,j,k,griddata);
                 ss.clear();
                 ss.str("");
                 if(fin.good())
                 {
                     if(getline(fin,buff)) ss << buff;
-                    ss >> v[n];
+                    ss >> v(i,j,k);
                 }
                 else
                 {
@@ -178,11 +275,16 @@ int uvfile_read_ASCII(vector<double>&u, vector<double>&v,const Griddata& griddat
     return 0;
 }
 
-int uvfile_read(vector<double>&u, vector<double>&v, vector<double>& ku, vector<double>& kv, vector<double>& ucvx, vector<double>& ucvy,vector<double>& ucvz, vector<double>& ucvmag,Griddata& griddata)
+template<typename Store>
+int uvfile_read(Field<Store>&u, Field<Store>&v, Field<Store>& ku, Field<Store>& kv, vector<double>& ucvx, vector<double>& ucvy,vector<double>& ucvz, vector<double>& ucvmag,Griddata& griddata)
 {
     string buff,datatype,dimensions,xdim,ydim,zdim;
+    // a compressed uv file (see SnapshotCodec.h) says so in its first bytes
+    const bool compressed = compressed_uv_file(B_filename);
+    // and so does a .vti (see VTIFile.h)
+    const bool vti = vti_file(B_filename);
     ifstream fin (B_filename.c_str());
-    for(int i=0;i<4;i++)
+    for(int i=0;i<((compressed || vti) ? 0 : 4);i++)
     {
         if(fin.good())
         {
@@ -195,13 +297,34 @@ int uvfile_read(vector<double>&u, vector<double>&v, vector<double>& ku, vector<d
         }
     }
 
-    if(datatype.compare("ASCII")==0)
+#ifdef USE_MPI
+    // split over several ranks, each reads its own slab of the grid the file was written on
+    if(decomposition().size > 1)
+    {
+        if((!compressed && !vti && datatype.compare("BINARY")!=0) || interpolationflag)
+        {
+            cout << "a run split over several ranks can only restart from a BINARY, compressed or .vti uv file with interpolationflag 0 - interpolate on one rank first\n";
+            return 1;
+        }
+        if(vti) return uvfile_read_VTI(u,v,griddata);
+        return compressed ? uvfile_read_COMPRESSED(u,v,griddata) : uvfile_read_BINARY(u,v,griddata);
+    }
+#endif
+    if(compressed)
+    {
+        if(uvfile_read_COMPRESSED(u,v,griddata)) return 1;
+    }
+    else if(vti)
+    {
+        if(uvfile_read_VTI(u,v,griddata)) return 1;
+    }
+    else if(datatype.compare("ASCII")==0)
     {
         uvfile_read_ASCII(u,v,griddata);
     }
     else if(datatype.compare("BINARY")==0)
     {
-        uvfile_read_BINARY(u,v,griddata);
+        if(uvfile_read_BINARY(u,v,griddata)) return 1;
     }
 
     // okay we've read in the file - now, did we want to interpolate?
@@ -214,41 +337,30 @@ int uvfile_read(vector<double>&u, vector<double>&v, vector<double>& ku, vector<d
         interpolatedgriddata.Ny = interpolatedNy;
         interpolatedgriddata.Nz = interpolatedNz;
         interpolatedgriddata.h = ((initialNx-1)*initialh)/(interpolatedNx-1);
-
-        vector<double>interpolatedugrid(interpolatedNx*interpolatedNy*interpolatedNz);
-        vector<double>interpolatedvgrid(interpolatedNx*interpolatedNy*interpolatedNz);
-
-        // interpolate u and v
-        likely::TriCubicInterpolator interpolatedu(u, initialh, initialNx,initialNy,initialNz);
-        likely::TriCubicInterpolator interpolatedv(v, initialh, initialNx,initialNy,initialNz);
-        for(int i=0;i<interpolatedNx;i++)
-        {
-            for(int j=0; j<interpolatedNy; j++)
-            {
-                for(int k=0; k<interpolatedNz; k++)   //Central difference
-                {
-
-                    // get the point in space this gridpoint corresponds to
-                    double px= x(i,interpolatedgriddata);
-                    double py= y(j,interpolatedgriddata);
-                    double pz= z(k,interpolatedgriddata);
-                    // interpolate
-                    interpolatedugrid[pt(i,j,k,interpolatedgriddata)]= interpolatedu(px,py,pz);
-                    interpolatedvgrid[pt(i,j,k,interpolatedgriddata)]= interpolatedv(px,py,pz);
-                }
-            }
-        }
+        interpolatedgriddata.boundarytype = griddata.boundarytype;
+
+        // interpolate u and v (see Resample.h), in double whatever precision the fields are kept in
+        vector<double>udouble,vdouble;
+        u.copy_to(udouble);
+        v.copy_to(vdouble);
+        vector<double>interpolatedugrid,interpolatedvgrid;
+        const double starttime = omp_get_wtime();
+        resample_tricubic(udouble,griddata,interpolatedugrid,interpolatedgriddata);
+        resample_tricubic(vdouble,griddata,interpolatedvgrid,interpolatedgriddata);
+        cout << "interpolated from " << griddata.Nx << "x" << griddata.Ny << "x" << griddata.Nz << " to " << interpolatedNx << "x" << interpolatedNy << "x" << interpolatedNz << " in " << omp_get_wtime() - starttime << " s\n";
 
         // resize all arrays, set the new u and v arrays, and set the new griddata
         ucvx.resize(interpolatedNx*interpolatedNy*interpolatedNz);
         ucvy.resize(interpolatedNx*interpolatedNy*interpolatedNz);
         ucvz.resize(interpolatedNx*interpolatedNy*interpolatedNz);
         ucvmag.resize(interpolatedNx*interpolatedNy*interpolatedNz);
-        ku.resize(4*interpolatedNx*interpolatedNy*interpolatedNz);
-        kv.resize(4*interpolatedNx*interpolatedNy*interpolatedNz);
+        ku.resize(interpolatedNx,interpolatedNy,interpolatedNz,HaloWidth,NumStageArrays);
+        kv.resize(interpolatedNx,interpolatedNy,interpolatedNz,HaloWidth,NumStageArrays);
+        u.resize(interpolatedNx,interpolatedNy,interpolatedNz,HaloWidth);
+        v.resize(interpolatedNx,interpolatedNy,interpolatedNz,HaloWidth);
 
-        u = interpolatedugrid;
-        v = interpolatedvgrid;
+        u.copy_from(interpolatedugrid);
+        v.copy_from(interpolatedvgrid);
 
         griddata=interpolatedgriddata;
     }
@@ -401,13 +513,110 @@ void print_B_phi( vector<double>&phi, const Griddata& griddata)
     Bout.close();
 }
 
-void print_uv( vector<double>&u, vector<double>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz,vector<double>&ucvmag, double t, const Griddata& griddata)
+// one section of a uv file, as big endian floats with i fastest. the grid is k fastest, so it is turned round a slab of whole z planes at a
+// time, each thread running along k over a range of i and j, and each slab goes out in one write
+template<typename Value>
+static void write_uv_section(ofstream& uvout, const Value& value, const Griddata& griddata, vector<float>& buffer, int threads)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+    // as many planes as fit in 16MB
+    const int planes = max(1,min(Nz,(1<<22)/(Nx*Ny)));
+    buffer.resize((size_t)planes*Nx*Ny);
+    for(int k0=0; k0<Nz; k0+=planes)
+    {
+        const int k1 = min(Nz,k0+planes);
+#pragma omp parallel for collapse(2) schedule(static) num_threads(threads)
+        for(int j=0; j<Ny; j++)
+        {
+            for(int i=0; i<Nx; i++)
+            {
+                for(int k=k0; k<k1; k++) buffer[((size_t)(k-k0)*Ny+j)*Nx+i] = FloatSwap(value(i,j,k));
+            }
+        }
+        uvout.write((char*) buffer.data(), (size_t)(k1-k0)*Nx*Ny*sizeof(float));
+    }
+}
+
+// the planes k0 <= k < k1 of u, v or ucrossv (section 0, 1 or 2) as floats, i fastest, the way the uv files hold them
+template<typename Store>
+static void uv_planes(const Field<Store>&u, const Field<Store>&v, const vector<double>&ucvmag, int section, int k0, int k1, float* values, const Griddata& griddata)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const size_t plane = (size_t)Nx*Ny;
+    for(int i=0; i<Nx; i++)
+    {
+        for(int j=0; j<Ny; j++)
+        {
+            float* row = values + (size_t)j*Nx + i;
+            if(section==0) for(int k=k0; k<k1; k++) row[(k-k0)*plane] = u(i,j,k);
+            else if(section==1) for(int k=k0; k<k1; k++) row[(k-k0)*plane] = v(i,j,k);
+            else for(int k=k0; k<k1; k++) row[(k-k0)*plane] = ucvmag[pt(i,j,k,griddata)];
+        }
+    }
+}
+
+// the same as a compressed uv file (see SnapshotCodec.h), with a line on how well it packed
+template<typename Store>
+static void write_uv_compressed(const Field<Store>&u, const Field<Store>&v, const vector<double>&ucvmag, double t, const Griddata& griddata, int threads)
 {
+    stringstream ss;
+    ss << "uv_plot" << t << ".uvz";
+    const CompressedUVHeader header = {griddata.Nx, griddata.Ny, griddata.Nz, griddata.h, {x(0,griddata), y(0,griddata), z(0,griddata)}, t, UVErrorBound};
+    // u and v can go through a lossy codec, but ucrossv, which picks out the filament, is always kept exactly
+    const int codecs[3] = {UVCodec, UVCodec, UV_CODEC_SHUFFLE_LZ};
+    size_t rawbytes = 0;
+    size_t filebytes = 0;
+    const double starttime = omp_get_wtime();
+    const bool ok = write_compressed_uv(ss.str(), header, codecs, [&](int section, int k0, int k1, float* values)
+    {
+        uv_planes(u,v,ucvmag,section,k0,k1,values,griddata);
+    }, threads, rawbytes, filebytes);
+    const double seconds = omp_get_wtime() - starttime;
+    if(ok) cout << ss.str() << ": " << rawbytes/1e6 << " MB of floats packed with " << snapshot_codec(UVCodec)->name << " into " << filebytes/1e6 << " MB, " << (double)rawbytes/filebytes << " times smaller, at " << rawbytes/1e6/seconds << " MB/s\n";
+}
+
+// the same as a .vti (see VTIFile.h), uv_plot<t>.vti, or with UVFilePerField uv_plot<t>_u.vti, uv_plot<t>_v.vti and uv_plot<t>_ucrossv.vti
+template<typename Store>
+static void write_uv_vti(const Field<Store>&u, const Field<Store>&v, const vector<double>&ucvmag, double t, const Griddata& griddata, int threads)
+{
+    const VTIGrid grid = {griddata.Nx, griddata.Ny, griddata.Nz, griddata.h, {x(0,griddata), y(0,griddata), z(0,griddata)}};
+    const char* names[3] = {"u", "v", "ucrossv"};
+    size_t filebytes = 0;
+    for(int f=0; f<(UVFilePerField ? 3 : 1); f++)
+    {
+        stringstream ss;
+        ss << "uv_plot" << t;
+        if(UVFilePerField) ss << "_" << names[f];
+        ss << ".vti";
+        const vector<string> arrays = UVFilePerField ? vector<string>(1,names[f]) : vector<string>(names,names+3);
+        const int first = UVFilePerField ? f : 0;
+        write_vti(ss.str(), grid, arrays, [&](int a, int k0, int k1, float* values)
+        {
+            uv_planes(u,v,ucvmag,first+a,k0,k1,values,griddata);
+        }, threads, filebytes);
+    }
+}
+
+template<typename Store>
+void write_uv_file(const Field<Store>&u, const Field<Store>&v, const vector<double>&ucvmag, double t, const Griddata& griddata, int threads)
+{
+    if(UVFileFormat == COMPRESSED_UV_FILE)
+    {
+        write_uv_compressed(u,v,ucvmag,t,griddata,threads);
+        return;
+    }
+    if(UVFileFormat == VTI_UV_FILE)
+    {
+        write_uv_vti(u,v,ucvmag,t,griddata,threads);
+        return;
+    }
     int Nx = griddata.Nx;
     int Ny = griddata.Ny;
     int Nz = griddata.Nz;
     double h = griddata.h;
-    int i,j,k,n;
     stringstream ss;
     ss << "uv_plot" << t << ".vtk";
     ofstream uvout (ss.str().c_str(),std::ios::binary | std::ios::out);
@@ -419,55 +628,38 @@ void print_uv( vector<double>&u, vector<double>&v, vector<double>&ucvx, vector<d
     uvout << "POINT_DATA " << Nx*Ny*Nz << '\n';
     uvout << "SCALARS u float\nLOOKUP_TABLE default\n";
 
-
-    for(k=0; k<Nz; k++)
-    {
-        for(j=0; j<Ny; j++)
-        {
-            for(i=0; i<Nx; i++)
-            {
-                n = pt(i,j,k,griddata);
-                float val =  FloatSwap(u[n]);
-                uvout.write((char*) &val, sizeof(float));
-            }
-        }
-    }
+    vector<float> buffer;
+    write_uv_section(uvout, [&](int i, int j, int k) { return (float)u(i,j,k); }, griddata, buffer, threads);
 
     uvout << "\n" << "SCALARS v float\nLOOKUP_TABLE default\n";
 
-
-    for(k=0; k<Nz; k++)
-    {
-        for(j=0; j<Ny; j++)
-        {
-            for(i=0; i<Nx; i++)
-            {
-                n = pt(i,j,k,griddata);
-                float val =  FloatSwap(v[n]);
-                uvout.write( (char*) &val, sizeof(float));
-            }
-        }
-    }
+    write_uv_section(uvout, [&](int i, int j, int k) { return (float)v(i,j,k); }, griddata, buffer, threads);
 
     uvout << "\n" << "SCALARS ucrossv float\nLOOKUP_TABLE default\n";
 
-    for(k=0; k<Nz; k++)
-    {
-        for(j=0; j<Ny; j++)
-        {
-            for(i=0; i<Nx; i++)
-            {
-                n = pt(i,j,k,griddata);
-                //float val = FloatSwap(sqrt(ucvx[n]*ucvx[n] + ucvy[n]*ucvy[n] + ucvz[n]*ucvz[n]));
-                float val = FloatSwap(ucvmag[n]);
-                uvout.write( (char*) &val, sizeof(float));
-            }
-        }
-    }
+    write_uv_section(uvout, [&](int i, int j, int k) { return (float)ucvmag[pt(i,j,k,griddata)]; }, griddata, buffer, threads);
 
     uvout.close();
 }
 
+template<typename Store>
+void print_uv( Field<Store>&u, Field<Store>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz,vector<double>&ucvmag, double t, const Griddata& griddata)
+{
+#ifdef USE_MPI
+    if(decomposition().size > 1)
+    {
+        print_uv_slabs(u,v,ucvmag,t,griddata);
+        return;
+    }
+#endif
+    write_uv_file(u,v,ucvmag,t,griddata,1);
+}
+
+// the readers and writers for the solver fields are built for the precision picked in FN_Constants.h
+template int uvfile_read<StoreType>(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>& ku, Field<StoreType>& kv, vector<double>& ucvx, vector<double>& ucvy, vector<double>& ucvz, vector<double>& ucvmag, Griddata& griddata);
+template void print_uv<StoreType>(Field<StoreType>&u, Field<StoreType>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, double t, const Griddata& griddata);
+template void write_uv_file<StoreType>(const Field<StoreType>&u, const Field<StoreType>&v, const vector<double>&ucvmag, double t, const Griddata& griddata, int threads);
+
 float FloatSwap( float f )
 {
     union
@@ -6,11 +6,16 @@ using namespace std;
 #define READINGWRITING_H
 
 void print_B_phi(vector<double>&phi, const Griddata &griddata);
-void print_uv(vector<double>&u, vector<double>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, double t, const Griddata &griddata);
+// print_uv and uvfile_read take this rank's slab (see Decomposition.h), and with several ranks all of them write or read the one file together
+template<typename Store> void print_uv(Field<Store>&u, Field<Store>&v, vector<double>&ucvx, vector<double>&ucvy, vector<double>&ucvz, vector<double>&ucvmag, double t, const Griddata &griddata);
+// the uv file print_uv writes (VTK, compressed or .vti, see UVFileFormat), for the whole grid, turned into floats over the given number of threads (see SnapshotWriter.h)
+template<typename Store> void write_uv_file(const Field<Store>&u, const Field<Store>&v, const vector<double>&ucvmag, double t, const Griddata &griddata, int threads);
 void print_knot(double t, vector<knotcurve>& knotcurves, const Griddata &griddata);
-int uvfile_read(vector<double>&u, vector<double>&v, vector<double>& ku, vector<double>& kv, vector<double>& ucvx, vector<double>& ucvy, vector<double>& ucvz, vector<double> &ucvmag, Griddata &griddata);
-int uvfile_read_ASCII(vector<double>&u, vector<double>&v, const Griddata &griddata); // for legacy purposes
-int uvfile_read_BINARY(vector<double>&u, vector<double>&v, const Griddata &griddata);
+template<typename Store> int uvfile_read(Field<Store>&u, Field<Store>&v, Field<Store>& ku, Field<Store>& kv, vector<double>& ucvx, vector<double>& ucvy, vector<double>& ucvz, vector<double> &ucvmag, Griddata &griddata);
+template<typename Store> int uvfile_read_ASCII(Field<Store>&u, Field<Store>&v, const Griddata &griddata); // for legacy purposes
+template<typename Store> int uvfile_read_BINARY(Field<Store>&u, Field<Store>&v, const Griddata &slabgriddata);
+template<typename Store> int uvfile_read_COMPRESSED(Field<Store>&u, Field<Store>&v, const Griddata &slabgriddata);
+template<typename Store> int uvfile_read_VTI(Field<Store>&u, Field<Store>&v, const Griddata &slabgriddata);
 float FloatSwap( float f );
 void ByteSwap(const char* TobeSwapped, char* swapped );
 
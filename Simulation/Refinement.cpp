@@ -0,0 +1,592 @@
+#include "Refinement.h"
+#include "SimdKernels.h"
+#include "TriCubicInterpolator.h"
+#include <math.h>
+
+// a patch of fine points over one block of the coarse grid
+struct Patch
+{
+    int block;                    // the block it covers, numbered the way pt() numbers points
+    int i0,j0,k0;                 // the first coarse point it covers
+    int ni,nj,nk;                 // and how many along each axis, fewer than RefinePatchSize in the last blocks along an axis
+    Field<StoreType> u,v,ku,kv;   // the fine points, with a halo of 1, and the four RK4 stages
+    // the halo points copied from fine points: their offsets, and the patch and offset they come from. across a reflecting wall that's this patch
+    vector<int> linkoffset,linkpatch,linksource;
+    // the halo points interpolated from the coarse grid: their offsets, and where they are, counted in coarse points
+    vector<int> coarseoffset;
+    vector<double> coarsex,coarsey,coarsez;
+    // what they are at the start of the coarse step, and how fast they change over it
+    vector<StoreType> startu,startv,rateu,ratev;
+};
+
+static vector<Patch> patches;
+static vector<int> blockpatch;    // the patch on each block, -1 if there isn't one
+static int nbx = 0, nby = 0, nbz = 0;
+static int stepssinceregrid = 0;
+static bool regridded = false;
+static const SimdRowKernels* finekernels = NULL;
+
+// how far beyond a patch the coarse points copied for the interpolator go. the tricubic reaches 2 points past the point below
+const int CubeMargin = 3;
+
+static inline bool periodic_axis(BoundaryCondition boundarytype, int direction)
+{
+    return boundarytype == ALLPERIODIC || (boundarytype == ZPERIODIC && direction == 2);
+}
+
+// point i on an axis of N points, folded back onto the grid the way the halos are filled: wrapped across a periodic boundary, mirrored about
+// the face of a reflecting one
+static inline int fold(int i, int N, bool periodic)
+{
+    if(i >= 0 && i < N) return i;
+    if(periodic) return ((i%N)+N)%N;
+    return (i < 0) ? -i-1 : 2*N-i-1;
+}
+
+static void set_blocks(const Griddata& griddata)
+{
+    const int newnbx = (griddata.Nx+RefinePatchSize-1)/RefinePatchSize;
+    const int newnby = (griddata.Ny+RefinePatchSize-1)/RefinePatchSize;
+    const int newnbz = (griddata.Nz+RefinePatchSize-1)/RefinePatchSize;
+    if(newnbx == nbx && newnby == nby && newnbz == nbz) return;
+    nbx = newnbx;
+    nby = newnby;
+    nbz = newnbz;
+    patches.clear();
+    blockpatch.assign(nbx*nby*nbz,-1);
+    regridded = false;
+}
+
+// set where a patch is, and size its fields. the RK stages are only wanted on patches that get stepped
+static void place_patch(Patch& p, int block, bool stages, const Griddata& griddata)
+{
+    const int r = RefinementRatio;
+    p.block = block;
+    p.i0 = (block/(nby*nbz))*RefinePatchSize;
+    p.j0 = ((block/nbz)%nby)*RefinePatchSize;
+    p.k0 = (block%nbz)*RefinePatchSize;
+    p.ni = (p.i0+RefinePatchSize < griddata.Nx) ? RefinePatchSize : griddata.Nx-p.i0;
+    p.nj = (p.j0+RefinePatchSize < griddata.Ny) ? RefinePatchSize : griddata.Ny-p.j0;
+    p.nk = (p.k0+RefinePatchSize < griddata.Nz) ? RefinePatchSize : griddata.Nz-p.k0;
+    p.u.resize(r*p.ni,r*p.nj,r*p.nk,1);
+    p.v.resize(r*p.ni,r*p.nj,r*p.nk,1);
+    if(stages)
+    {
+        p.ku.resize(r*p.ni,r*p.nj,r*p.nk,1,4);
+        p.kv.resize(r*p.ni,r*p.nj,r*p.nk,1,4);
+    }
+}
+
+// copy the coarse points around a patch, out to CubeMargin beyond it, into a datacube for the TriCubicInterpolator, laid out as pt() lays
+// out points. the ones off the grid are folded back onto it
+static void coarse_cube(const Field<StoreType>& f, const Patch& p, const Griddata& griddata, vector<double>& cube)
+{
+    const int n1 = p.ni+2*CubeMargin;
+    const int n2 = p.nj+2*CubeMargin;
+    const int n3 = p.nk+2*CubeMargin;
+    const bool periodic[3] = {periodic_axis(griddata.boundarytype,0), periodic_axis(griddata.boundarytype,1), periodic_axis(griddata.boundarytype,2)};
+    cube.resize(n1*n2*n3);
+    for(int a=0;a<n1;a++)
+    {
+        const int i = fold(p.i0-CubeMargin+a,griddata.Nx,periodic[0]);
+        for(int b=0;b<n2;b++)
+        {
+            const int j = fold(p.j0-CubeMargin+b,griddata.Ny,periodic[1]);
+            for(int c=0;c<n3;c++) cube[(a*n2+b)*n3+c] = f(i,j,fold(p.k0-CubeMargin+c,griddata.Nz,periodic[2]));
+        }
+    }
+}
+
+// the interpolated value at x,y,z, counted in coarse points, from an interpolator set up on a patch's datacube. the interpolator puts point
+// [a,b,c] of the cube at (a-(n1-1)/2, b-(n2-1)/2, c-(n3-1)/2) times the spacing, which is 1 here (see gridCoordinate)
+static inline double cube_value(const likely::TriCubicInterpolator& interpolator, const Patch& p, double x, double y, double z)
+{
+    return interpolator(x-(p.i0-CubeMargin)-(interpolator.getN1()-1)/2.0, y-(p.j0-CubeMargin)-(interpolator.getN2()-1)/2.0, z-(p.k0-CubeMargin)-(interpolator.getN3()-1)/2.0);
+}
+
+// where fine point I sits, counted in coarse points. the points are at the centres of their cells, so a coarse point's fine points sit evenly
+// about it
+static inline double coarse_position(int I)
+{
+    return (I+0.5)/RefinementRatio - 0.5;
+}
+
+// fill a patch from the coarse grid: every fine point interpolated, then each coarse point's fine points shifted together so that they average
+// to the coarse value, which restrict_patch then gives back exactly
+static void prolongate(const Field<StoreType>& u, const Field<StoreType>& v, Patch& p, const Griddata& griddata, vector<double>& cubeu, vector<double>& cubev)
+{
+    const int r = RefinementRatio;
+    coarse_cube(u,p,griddata,cubeu);
+    coarse_cube(v,p,griddata,cubev);
+    likely::TriCubicInterpolator interpolatedu(cubeu, 1, p.ni+2*CubeMargin, p.nj+2*CubeMargin, p.nk+2*CubeMargin, false);
+    likely::TriCubicInterpolator interpolatedv(cubev, 1, p.ni+2*CubeMargin, p.nj+2*CubeMargin, p.nk+2*CubeMargin, false);
+    for(int i=0;i<r*p.ni;i++)
+    {
+        const double x = coarse_position(r*p.i0+i);
+        for(int j=0;j<r*p.nj;j++)
+        {
+            const double y = coarse_position(r*p.j0+j);
+            for(int k=0;k<r*p.nk;k++)
+            {
+                const double z = coarse_position(r*p.k0+k);
+                p.u(i,j,k) = cube_value(interpolatedu,p,x,y,z);
+                p.v(i,j,k) = cube_value(interpolatedv,p,x,y,z);
+            }
+        }
+    }
+    const double volume = r*r*r;
+    for(int i=0;i<p.ni;i++)
+    {
+        for(int j=0;j<p.nj;j++)
+        {
+            for(int k=0;k<p.nk;k++)
+            {
+                double sumu = 0, sumv = 0;
+                for(int a=0;a<r;a++) for(int b=0;b<r;b++) for(int c=0;c<r;c++)
+                {
+                    sumu += p.u(r*i+a,r*j+b,r*k+c);
+                    sumv += p.v(r*i+a,r*j+b,r*k+c);
+                }
+                const double shiftu = u(p.i0+i,p.j0+j,p.k0+k) - sumu/volume;
+                const double shiftv = v(p.i0+i,p.j0+j,p.k0+k) - sumv/volume;
+                for(int a=0;a<r;a++) for(int b=0;b<r;b++) for(int c=0;c<r;c++)
+                {
+                    p.u(r*i+a,r*j+b,r*k+c) += shiftu;
+                    p.v(r*i+a,r*j+b,r*k+c) += shiftv;
+                }
+            }
+        }
+    }
+}
+
+// set the coarse points under a patch to the average of their fine points
+static void restrict_patch(const Patch& p, Field<StoreType>& u, Field<StoreType>& v)
+{
+    const int r = RefinementRatio;
+    const double volume = r*r*r;
+    for(int i=0;i<p.ni;i++)
+    {
+        for(int j=0;j<p.nj;j++)
+        {
+            for(int k=0;k<p.nk;k++)
+            {
+                double sumu = 0, sumv = 0;
+                for(int a=0;a<r;a++) for(int b=0;b<r;b++) for(int c=0;c<r;c++)
+                {
+                    sumu += p.u(r*i+a,r*j+b,r*k+c);
+                    sumv += p.v(r*i+a,r*j+b,r*k+c);
+                }
+                u(p.i0+i,p.j0+j,p.k0+k) = sumu/volume;
+                v(p.i0+i,p.j0+j,p.k0+k) = sumv/volume;
+            }
+        }
+    }
+}
+
+// work out where each point of a patch's halo comes from. only the faces are needed, the update's stencil reaching no further. a halo point
+// is folded back onto the grid, and if that lands on a patch it is copied from there. if not, it is interpolated from the coarse grid at the
+// point folded back across reflecting walls only, since the interpolator's datacube is folded across periodic ones already
+static void link_halo(Patch& p, const Griddata& griddata)
+{
+    const int r = RefinementRatio;
+    const int fineN[3] = {r*griddata.Nx, r*griddata.Ny, r*griddata.Nz};
+    const int origin[3] = {r*p.i0, r*p.j0, r*p.k0};
+    const int n[3] = {r*p.ni, r*p.nj, r*p.nk};
+    const bool periodic[3] = {periodic_axis(griddata.boundarytype,0), periodic_axis(griddata.boundarytype,1), periodic_axis(griddata.boundarytype,2)};
+    p.linkoffset.clear();
+    p.linkpatch.clear();
+    p.linksource.clear();
+    p.coarseoffset.clear();
+    p.coarsex.clear();
+    p.coarsey.clear();
+    p.coarsez.clear();
+    for(int d=0;d<3;d++)
+    {
+        const int d1 = (d+1)%3;
+        const int d2 = (d+2)%3;
+        for(int side=0;side<2;side++)
+        {
+            for(int a=0;a<n[d1];a++)
+            {
+                for(int b=0;b<n[d2];b++)
+                {
+                    int local[3];
+                    local[d] = side ? n[d] : -1;
+                    local[d1] = a;
+                    local[d2] = b;
+                    int reflected[3],folded[3];
+                    for(int e=0;e<3;e++)
+                    {
+                        const int I = origin[e]+local[e];
+                        reflected[e] = periodic[e] ? I : fold(I,fineN[e],false);
+                        folded[e] = fold(I,fineN[e],periodic[e]);
+                    }
+                    const int offset = p.u.index(local[0],local[1],local[2]);
+                    const int block = ((folded[0]/r/RefinePatchSize)*nby + folded[1]/r/RefinePatchSize)*nbz + folded[2]/r/RefinePatchSize;
+                    const int q = blockpatch[block];
+                    if(q >= 0)
+                    {
+                        const Patch& source = patches[q];
+                        p.linkoffset.push_back(offset);
+                        p.linkpatch.push_back(q);
+                        p.linksource.push_back(source.u.index(folded[0]-r*source.i0,folded[1]-r*source.j0,folded[2]-r*source.k0));
+                    }
+                    else
+                    {
+                        p.coarseoffset.push_back(offset);
+                        p.coarsex.push_back(coarse_position(reflected[0]));
+                        p.coarsey.push_back(coarse_position(reflected[1]));
+                        p.coarsez.push_back(coarse_position(reflected[2]));
+                    }
+                }
+            }
+        }
+    }
+    const int ncoarse = p.coarseoffset.size();
+    p.startu.resize(ncoarse);
+    p.startv.resize(ncoarse);
+    p.rateu.resize(ncoarse);
+    p.ratev.resize(ncoarse);
+}
+
+// interpolate the coarse grid onto the halo points of a patch that come from it, either at the start of the coarse step, or at its end, which
+// gives how fast they change over it
+static void interpolate_halo(const Field<StoreType>& u, const Field<StoreType>& v, Patch& p, bool start, const Griddata& griddata, vector<double>& cubeu, vector<double>& cubev)
+{
+    const int ncoarse = p.coarseoffset.size();
+    if(ncoarse == 0) return;
+    coarse_cube(u,p,griddata,cubeu);
+    coarse_cube(v,p,griddata,cubev);
+    likely::TriCubicInterpolator interpolatedu(cubeu, 1, p.ni+2*CubeMargin, p.nj+2*CubeMargin, p.nk+2*CubeMargin, false);
+    likely::TriCubicInterpolator interpolatedv(cubev, 1, p.ni+2*CubeMargin, p.nj+2*CubeMargin, p.nk+2*CubeMargin, false);
+    for(int c=0;c<ncoarse;c++)
+    {
+        const double valueu = cube_value(interpolatedu,p,p.coarsex[c],p.coarsey[c],p.coarsez[c]);
+        const double valuev = cube_value(interpolatedv,p,p.coarsex[c],p.coarsey[c],p.coarsez[c]);
+        if(start)
+        {
+            p.startu[c] = valueu;
+            p.startv[c] = valuev;
+        }
+        else
+        {
+            p.rateu[c] = (valueu - p.startu[c])/dtime;
+            p.ratev[c] = (valuev - p.startv[c])/dtime;
+        }
+    }
+}
+
+// fill the halo of u and v of a patch, t into the coarse step. the patches it copies from must all be at the same point
+static void fill_patch_halo(Patch& p, double t)
+{
+    StoreType* U = p.u.origin();
+    StoreType* V = p.v.origin();
+    const int nlinks = p.linkoffset.size();
+    for(int l=0;l<nlinks;l++)
+    {
+        U[p.linkoffset[l]] = patches[p.linkpatch[l]].u.origin()[p.linksource[l]];
+        V[p.linkoffset[l]] = patches[p.linkpatch[l]].v.origin()[p.linksource[l]];
+    }
+    const int ncoarse = p.coarseoffset.size();
+    for(int c=0;c<ncoarse;c++)
+    {
+        U[p.coarseoffset[c]] = p.startu[c] + t*p.rateu[c];
+        V[p.coarseoffset[c]] = p.startv[c] + t*p.ratev[c];
+    }
+}
+
+// and the halo of RK stage l. the next stage is evaluated at u + dtinc*k, so where the halo comes from the coarse grid k is its rate of
+// change, which puts it at the right point in time
+static void fill_patch_stage_halo(Patch& p, int l)
+{
+    StoreType* KU = p.ku.origin(l);
+    StoreType* KV = p.kv.origin(l);
+    const int nlinks = p.linkoffset.size();
+    for(int n=0;n<nlinks;n++)
+    {
+        KU[p.linkoffset[n]] = patches[p.linkpatch[n]].ku.origin(l)[p.linksource[n]];
+        KV[p.linkoffset[n]] = patches[p.linkpatch[n]].kv.origin(l)[p.linksource[n]];
+    }
+    const int ncoarse = p.coarseoffset.size();
+    for(int c=0;c<ncoarse;c++)
+    {
+        KU[p.coarseoffset[c]] = p.rateu[c];
+        KV[p.coarseoffset[c]] = p.ratev[c];
+    }
+}
+
+// take every patch across one coarse step, in RefinementRatio^2 RK4 steps, which keeps dt/h^2 what it is on the coarse grid
+static void step_patches(const Griddata& griddata)
+{
+    const int r = RefinementRatio;
+    const int substeps = r*r;
+    const double dt = dtime/substeps;
+    const AccumType oneoverhsq = (r*r)/(griddata.h*griddata.h);
+    const AccumType dtsixth = dt/6.0;
+    const double inc[4] = {0, 0.5, 0.5, 1};
+    const int npatches = patches.size();
+    for(int s=0;s<substeps;s++)
+    {
+#pragma omp for schedule(dynamic)
+        for(int q=0;q<npatches;q++) fill_patch_halo(patches[q],s*dt);
+        for(int l=0;l<4;l++)
+        {
+#pragma omp for schedule(dynamic)
+            for(int q=0;q<npatches;q++)
+            {
+                Patch& p = patches[q];
+                const int xstride = p.u.xstride;
+                const int ystride = p.u.ystride;
+                for(int i=0;i<p.u.Nx;i++)
+                {
+                    for(int j=0;j<p.u.Ny;j++)
+                    {
+                        const int row = i*xstride + j*ystride;
+                        if(l == 0) finekernels->rk4first(p.u.origin(),p.v.origin(),p.ku.origin(0),p.kv.origin(0),row,row+p.u.Nz,xstride,ystride,oneoverhsq);
+                        else finekernels->rk4(p.u.origin(),p.v.origin(),p.ku.origin(l-1),p.kv.origin(l-1),p.ku.origin(l),p.kv.origin(l),row,row+p.u.Nz,xstride,ystride,dt*inc[l],oneoverhsq);
+                    }
+                }
+            }
+            if(l == 3) break;
+#pragma omp for schedule(dynamic)
+            for(int q=0;q<npatches;q++) fill_patch_stage_halo(patches[q],l);
+        }
+#pragma omp for schedule(dynamic)
+        for(int q=0;q<npatches;q++)
+        {
+            Patch& p = patches[q];
+            StoreType* U = p.u.origin();
+            StoreType* V = p.v.origin();
+            const StoreType* KU = p.ku.origin();
+            const StoreType* KV = p.kv.origin();
+            const int stagesize = p.ku.componentsize;
+            for(int i=0;i<p.u.Nx;i++)
+            {
+                for(int j=0;j<p.u.Ny;j++)
+                {
+                    const int row = i*p.u.xstride + j*p.u.ystride;
+                    for(int n=row;n<row+p.u.Nz;n++)
+                    {
+                        U[n] = U[n] + dtsixth*((AccumType)KU[n]+2*KU[stagesize+n]+2*KU[2*stagesize+n]+KU[3*stagesize+n]);
+                        V[n] = V[n] + dtsixth*((AccumType)KV[n]+2*KV[stagesize+n]+2*KV[2*stagesize+n]+KV[3*stagesize+n]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// lay the patches out again: on the blocks where |grad u x grad v| goes above RefineThreshold, and those within RefineBuffer blocks of them.
+// patches staying where they are keep their fine points, new ones are filled from the coarse grid, and the ones going have already been
+// restricted onto it
+static void regrid(const Field<StoreType>& u, const Field<StoreType>& v, const Griddata& griddata)
+{
+    static vector<char> flagged;
+    static vector<int> fresh;
+    const int nblocks = nbx*nby*nbz;
+    const double oneover2h = 0.5/griddata.h;
+#pragma omp single
+    flagged.assign(nblocks,0);
+#pragma omp for schedule(dynamic)
+    for(int block=0;block<nblocks;block++)
+    {
+        const int i0 = (block/(nby*nbz))*RefinePatchSize;
+        const int j0 = ((block/nbz)%nby)*RefinePatchSize;
+        const int k0 = (block%nbz)*RefinePatchSize;
+        const int i1 = (i0+RefinePatchSize < griddata.Nx) ? i0+RefinePatchSize : griddata.Nx;
+        const int j1 = (j0+RefinePatchSize < griddata.Ny) ? j0+RefinePatchSize : griddata.Ny;
+        const int k1 = (k0+RefinePatchSize < griddata.Nz) ? k0+RefinePatchSize : griddata.Nz;
+        for(int i=i0;i<i1 && !flagged[block];i++)
+        {
+            for(int j=j0;j<j1 && !flagged[block];j++)
+            {
+                for(int k=k0;k<k1;k++)
+                {
+                    const double dxu = oneover2h*(u(i+1,j,k)-u(i-1,j,k));
+                    const double dxv = oneover2h*(v(i+1,j,k)-v(i-1,j,k));
+                    const double dyu = oneover2h*(u(i,j+1,k)-u(i,j-1,k));
+                    const double dyv = oneover2h*(v(i,j+1,k)-v(i,j-1,k));
+                    const double dzu = oneover2h*(u(i,j,k+1)-u(i,j,k-1));
+                    const double dzv = oneover2h*(v(i,j,k+1)-v(i,j,k-1));
+                    const double cx = dyu*dzv - dzu*dyv;
+                    const double cy = dzu*dxv - dxu*dzv;
+                    const double cz = dxu*dyv - dyu*dxv;
+                    if(cx*cx + cy*cy + cz*cz > RefineThreshold*RefineThreshold) flagged[block] = 1;
+                }
+            }
+        }
+    }
+#pragma omp single
+    {
+        const bool periodic[3] = {periodic_axis(griddata.boundarytype,0), periodic_axis(griddata.boundarytype,1), periodic_axis(griddata.boundarytype,2)};
+        const int nb[3] = {nbx,nby,nbz};
+        vector<char> wanted(nblocks,0);
+        for(int block=0;block<nblocks;block++)
+        {
+            if(!flagged[block]) continue;
+            const int b[3] = {block/(nby*nbz), (block/nbz)%nby, block%nbz};
+            for(int dx=-RefineBuffer;dx<=RefineBuffer;dx++)
+            {
+                for(int dy=-RefineBuffer;dy<=RefineBuffer;dy++)
+                {
+                    for(int dz=-RefineBuffer;dz<=RefineBuffer;dz++)
+                    {
+                        const int d[3] = {dx,dy,dz};
+                        int neighbour[3];
+                        bool ongrid = true;
+                        for(int e=0;e<3;e++)
+                        {
+                            neighbour[e] = b[e]+d[e];
+                            if(neighbour[e] >= 0 && neighbour[e] < nb[e]) continue;
+                            if(periodic[e]) neighbour[e] = ((neighbour[e]%nb[e])+nb[e])%nb[e];
+                            else ongrid = false;
+                        }
+                        if(ongrid) wanted[(neighbour[0]*nby+neighbour[1])*nbz+neighbour[2]] = 1;
+                    }
+                }
+            }
+        }
+        int nwanted = 0;
+        for(int block=0;block<nblocks;block++) nwanted += wanted[block];
+        vector<Patch> newpatches(nwanted);
+        vector<int> newblockpatch(nblocks,-1);
+        fresh.clear();
+        for(int block=0,q=0;block<nblocks;block++)
+        {
+            if(!wanted[block]) continue;
+            Patch& p = newpatches[q];
+            const int old = blockpatch[block];
+            if(old >= 0)
+            {
+                p.block = block;
+                p.i0 = patches[old].i0; p.j0 = patches[old].j0; p.k0 = patches[old].k0;
+                p.ni = patches[old].ni; p.nj = patches[old].nj; p.nk = patches[old].nk;
+                p.u.swap(patches[old].u);
+                p.v.swap(patches[old].v);
+                p.ku.swap(patches[old].ku);
+                p.kv.swap(patches[old].kv);
+            }
+            else
+            {
+                place_patch(p,block,true,griddata);
+                fresh.push_back(q);
+            }
+            newblockpatch[block] = q;
+            q++;
+        }
+        patches.swap(newpatches);
+        blockpatch.swap(newblockpatch);
+        stepssinceregrid = 0;
+        regridded = true;
+    }
+    vector<double> cubeu,cubev;
+    const int nfresh = fresh.size();
+#pragma omp for schedule(dynamic)
+    for(int f=0;f<nfresh;f++) prolongate(u,v,patches[fresh[f]],griddata,cubeu,cubev);
+    const int npatches = patches.size();
+#pragma omp for schedule(dynamic)
+    for(int q=0;q<npatches;q++) link_halo(patches[q],griddata);
+}
+
+void refinement_update(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, int steps, const BoundaryKernels& solver, const Griddata& griddata)
+{
+    const int regridsteps = (RegridTime > dtime) ? (int)(RegridTime/dtime) : 1;
+#pragma omp single
+    {
+        set_blocks(griddata);
+        if(finekernels == NULL) finekernels = simd_row_kernels(SimdPath);
+    }
+    vector<double> cubeu,cubev;
+    for(int s=0;s<steps;s++)
+    {
+        if(!regridded || stepssinceregrid >= regridsteps) regrid(u,v,griddata);
+        const int npatches = patches.size();
+#pragma omp for schedule(dynamic)
+        for(int q=0;q<npatches;q++) interpolate_halo(u,v,patches[q],true,griddata,cubeu,cubev);
+        solver.uv_update(u,v,ku,kv,1,griddata);
+#pragma omp for schedule(dynamic)
+        for(int q=0;q<npatches;q++) interpolate_halo(u,v,patches[q],false,griddata,cubeu,cubev);
+        step_patches(griddata);
+#pragma omp for schedule(dynamic)
+        for(int q=0;q<npatches;q++) restrict_patch(patches[q],u,v);
+        u.fill_halo(griddata.boundarytype);
+        v.fill_halo(griddata.boundarytype);
+#pragma omp single
+        stepssinceregrid++;
+    }
+}
+
+Griddata refined_griddata(const Griddata& griddata)
+{
+    Griddata finegriddata = griddata;
+    finegriddata.Nx = RefinementRatio*griddata.Nx;
+    finegriddata.Ny = RefinementRatio*griddata.Ny;
+    finegriddata.Nz = RefinementRatio*griddata.Nz;
+    finegriddata.h = griddata.h/RefinementRatio;
+    return finegriddata;
+}
+
+void refinement_composite(const Field<StoreType>&u, const Field<StoreType>&v, Field<StoreType>&fineu, Field<StoreType>&finev, const Griddata& griddata)
+{
+    const int r = RefinementRatio;
+    const Griddata finegriddata = refined_griddata(griddata);
+    const int Nx = finegriddata.Nx;
+    const int Ny = finegriddata.Ny;
+    const int Nz = finegriddata.Nz;
+    set_blocks(griddata);
+    if(fineu.Nx != Nx || fineu.Ny != Ny || fineu.Nz != Nz)
+    {
+        fineu.resize(Nx,Ny,Nz,HaloWidth);
+        finev.resize(Nx,Ny,Nz,HaloWidth);
+    }
+    vector<double> cubeu,cubev;
+    Patch scratch;
+    for(int block=0;block<nbx*nby*nbz;block++)
+    {
+        const Patch* p = &scratch;
+        if(blockpatch[block] >= 0) p = &patches[blockpatch[block]];
+        else
+        {
+            place_patch(scratch,block,false,griddata);
+            prolongate(u,v,scratch,griddata,cubeu,cubev);
+        }
+        for(int i=0;i<r*p->ni;i++)
+        {
+            for(int j=0;j<r*p->nj;j++)
+            {
+                for(int k=0;k<r*p->nk;k++)
+                {
+                    fineu(r*p->i0+i,r*p->j0+j,r*p->k0+k) = p->u(i,j,k);
+                    finev(r*p->i0+i,r*p->j0+j,r*p->k0+k) = p->v(i,j,k);
+                }
+            }
+        }
+    }
+    // the halo, filled as Field::fill_halo fills it, which can't be called from one thread of a parallel region
+    const bool periodic[3] = {periodic_axis(griddata.boundarytype,0), periodic_axis(griddata.boundarytype,1), periodic_axis(griddata.boundarytype,2)};
+    const int g = fineu.g;
+    for(int i=-g;i<Nx+g;i++)
+    {
+        for(int j=-g;j<Ny+g;j++)
+        {
+            const bool interiorrow = (i >= 0 && i < Nx && j >= 0 && j < Ny);
+            for(int k=-g;k<Nz+g;k++)
+            {
+                if(interiorrow && k == 0) k = Nz;
+                const int si = fold(i,Nx,periodic[0]);
+                const int sj = fold(j,Ny,periodic[1]);
+                const int sk = fold(k,Nz,periodic[2]);
+                fineu(i,j,k) = fineu(si,sj,sk);
+                finev(i,j,k) = finev(si,sj,sk);
+            }
+        }
+    }
+}
+
+double refinement_point_fraction(const Griddata& griddata)
+{
+    double points = (double)griddata.Nx*griddata.Ny*griddata.Nz;
+    const int npatches = patches.size();
+    for(int q=0;q<npatches;q++) points += (double)patches[q].u.Nx*patches[q].u.Ny*patches[q].u.Nz;
+    return points/(RefinementRatio*RefinementRatio*RefinementRatio*(double)griddata.Nx*griddata.Ny*griddata.Nz);
+}
@@ -0,0 +1,29 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+#include "Field.h"
+#include <vector>
+using namespace std;
+
+#ifndef REFINEMENT_H
+#define REFINEMENT_H
+
+// block structured mesh refinement around the filament (AdaptiveRefinement). u and v are the coarse level, and are stepped as usual. the grid
+// is cut into blocks of RefinePatchSize points a side, and the blocks where |grad u x grad v| goes above RefineThreshold, and those within
+// RefineBuffer blocks of them, carry a patch RefinementRatio times finer. a patch's halo comes from the neighbouring patch where there is one,
+// and is interpolated from the coarse grid (with the TriCubicInterpolator in space, linearly in time) where there isn't. a new patch is filled
+// the same way, then shifted so that each coarse point's fine points average to it, and after every step the coarse points under the patches
+// are set to that average, so nothing is lost or made going between the levels
+
+// step u, v and the patches forward the given number of timesteps. the coarse grid takes one step at a time through solver.uv_update, then
+// the patches take RefinementRatio^2 steps of dtime/RefinementRatio^2 across it. the patches are laid out again every RegridTime to follow
+// the filament. call from every thread of a parallel region. it needs the whole grid on one rank
+void refinement_update(Field<StoreType>&u, Field<StoreType>&v, Field<StoreType>&ku, Field<StoreType>&kv, int steps, const BoundaryKernels& solver, const Griddata& griddata);
+// the griddata of the whole grid at the fine spacing
+Griddata refined_griddata(const Griddata& griddata);
+// the whole grid at the fine spacing, for tracing the knot on: the patches where there are patches, and the coarse grid interpolated as for a
+// new patch everywhere else. fineu and finev are sized to fit, with their halos filled. call from one thread
+void refinement_composite(const Field<StoreType>&u, const Field<StoreType>&v, Field<StoreType>&fineu, Field<StoreType>&finev, const Griddata& griddata);
+// the points stepped, coarse and fine, as a part of the points on the whole grid at the fine spacing
+double refinement_point_fraction(const Griddata& griddata);
+
+#endif //REFINEMENT_H
@@ -0,0 +1,88 @@
+#include "Resample.h"
+#include <math.h>
+#include <omp.h>
+
+// the 4 points of the old grid a point of the new one is made from along one axis, wrapped round periodically, and their weights
+struct Stencil
+{
+    int index[4];
+    double weight[4];
+};
+
+static vector<Stencil> axis_stencils(int fromN, double fromh, int toN, double toh)
+{
+    vector<Stencil> stencils(toN);
+    for(int i=0; i<toN; i++)
+    {
+        // where the new point is, in points of the old grid, both being centred on the origin
+        const double d = likely::TriCubicInterpolator::gridCoordinate((i+0.5-toN/2.0)*toh, fromh, fromN);
+        const int base = (int)floor(d);
+        const double t = d - base;
+        // the cubic Hermite between base and base+1, with the slopes there taken from central differences
+        const double t2 = t*t;
+        const double t3 = t2*t;
+        const double h00 = 2*t3 - 3*t2 + 1;
+        const double h10 = t3 - 2*t2 + t;
+        const double h01 = -2*t3 + 3*t2;
+        const double h11 = t3 - t2;
+        Stencil& s = stencils[i];
+        s.weight[0] = -0.5*h10;
+        s.weight[1] = h00 - 0.5*h11;
+        s.weight[2] = h01 + 0.5*h10;
+        s.weight[3] = 0.5*h11;
+        for(int o=0; o<4; o++) s.index[o] = ((base-1+o)%fromN + fromN)%fromN;
+    }
+    return stencils;
+}
+
+void resample_tricubic(const vector<double>& from, const Griddata& fromgriddata, vector<double>& to, const Griddata& togriddata)
+{
+    const int fromNy = fromgriddata.Ny;
+    const int fromNz = fromgriddata.Nz;
+    const int toNx = togriddata.Nx;
+    const int toNy = togriddata.Ny;
+    const int toNz = togriddata.Nz;
+    const vector<Stencil> xstencils = axis_stencils(fromgriddata.Nx, fromgriddata.h, toNx, togriddata.h);
+    const vector<Stencil> ystencils = axis_stencils(fromNy, fromgriddata.h, toNy, togriddata.h);
+    const vector<Stencil> zstencils = axis_stencils(fromNz, fromgriddata.h, toNz, togriddata.h);
+    const size_t fromplane = (size_t)fromNy*fromNz;
+    to.resize((size_t)toNx*toNy*toNz);
+#pragma omp parallel
+    {
+        // a new x plane on the way: first on the old (j,k) points, then on the new j and old k
+        vector<double> xplane(fromplane);
+        vector<double> yplane((size_t)toNy*fromNz);
+#pragma omp for schedule(static)
+        for(int i=0; i<toNx; i++)
+        {
+            const Stencil& sx = xstencils[i];
+            const double* p0 = &from[sx.index[0]*fromplane];
+            const double* p1 = &from[sx.index[1]*fromplane];
+            const double* p2 = &from[sx.index[2]*fromplane];
+            const double* p3 = &from[sx.index[3]*fromplane];
+#pragma omp simd
+            for(size_t n=0; n<fromplane; n++) xplane[n] = sx.weight[0]*p0[n] + sx.weight[1]*p1[n] + sx.weight[2]*p2[n] + sx.weight[3]*p3[n];
+            for(int j=0; j<toNy; j++)
+            {
+                const Stencil& sy = ystencils[j];
+                const double* r0 = &xplane[(size_t)sy.index[0]*fromNz];
+                const double* r1 = &xplane[(size_t)sy.index[1]*fromNz];
+                const double* r2 = &xplane[(size_t)sy.index[2]*fromNz];
+                const double* r3 = &xplane[(size_t)sy.index[3]*fromNz];
+                double* row = &yplane[(size_t)j*fromNz];
+#pragma omp simd
+                for(int k=0; k<fromNz; k++) row[k] = sy.weight[0]*r0[k] + sy.weight[1]*r1[k] + sy.weight[2]*r2[k] + sy.weight[3]*r3[k];
+            }
+            for(int j=0; j<toNy; j++)
+            {
+                const double* row = &yplane[(size_t)j*fromNz];
+                double* out = &to[((size_t)i*toNy+j)*toNz];
+                for(int k=0; k<toNz; k++)
+                {
+                    const Stencil& sz = zstencils[k];
+                    out[k] = sz.weight[0]*row[sz.index[0]] + sz.weight[1]*row[sz.index[1]] + sz.weight[2]*row[sz.index[2]] + sz.weight[3]*row[sz.index[3]];
+                }
+            }
+        }
+    }
+}
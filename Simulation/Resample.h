@@ -0,0 +1,16 @@
+#include "FN_Knot.h"
+#include <vector>
+using namespace std;
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+// resample a field from one grid onto another by tricubic interpolation, for restarting a run on a finer (or coarser) grid. both grids are
+// laid out as pt() lays them out and centred on the origin (see x() and TriCubicInterpolator::gridCoordinate), and the ratio of the spacings
+// can be anything. this is the interpolation TriCubicInterpolator does - with derivatives from central differences, and the grid periodic for
+// the points beyond its edges - which comes apart into a 1D cubic along each axis in turn, each fine point being a weighted sum of the 4 coarse
+// ones around it. each fine x plane is made from the 4 coarse planes around it, then along y, then z, so the planes are done in parallel with
+// a plane of scratch for each thread
+void resample_tricubic(const vector<double>& from, const Griddata& fromgriddata, vector<double>& to, const Griddata& togriddata);
+
+#endif //RESAMPLE_H
@@ -0,0 +1,199 @@
+#include "SimdKernels.h"
+#include <string.h>
+
+// this file must be compiled with -ffp-contract=off (see the Makefile). the AVX-512 kernels can use fused multiply-adds, which round differently
+// from the separate multiply and add the scalar kernels do, and would break bit identity between the paths
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+// everything here is local to this file - the same templates compiled for different instruction sets must never be merged by the linker
+namespace
+{
+// W lanes of T, as a GCC vector type
+template<typename T, int W> struct SimdVec;
+template<> struct SimdVec<double,4> { typedef double type __attribute__((vector_size(32))); };
+template<> struct SimdVec<double,8> { typedef double type __attribute__((vector_size(64))); };
+template<> struct SimdVec<float,4> { typedef float type __attribute__((vector_size(16))); };
+template<> struct SimdVec<float,8> { typedef float type __attribute__((vector_size(32))); };
+template<> struct SimdVec<float,16> { typedef float type __attribute__((vector_size(64))); };
+
+// loading W consecutive Store values into W lanes of Accum and back again. W=1 is the scalar remainder at the end of a row
+template<typename Store, typename Accum, int W>
+struct Pack
+{
+    typedef typename SimdVec<Accum,W>::type A;
+    typedef typename SimdVec<Store,W>::type S;
+    static SIMD_INLINE A load(const Store* p)
+    {
+        S s;
+        memcpy(&s,p,sizeof(S));
+        return __builtin_convertvector(s,A);
+    }
+    static SIMD_INLINE void store(Store* p, A a)
+    {
+        S s = __builtin_convertvector(a,S);
+        memcpy(p,&s,sizeof(S));
+    }
+};
+template<typename Store, typename Accum>
+struct Pack<Store,Accum,1>
+{
+    typedef Accum A;
+    static SIMD_INLINE A load(const Store* p) { return *p; }
+    static SIMD_INLINE void store(Store* p, A a) { *p = a; }
+};
+
+// the FitzHugh-Nagumo parameters as the kernels use them, made once at the start of a row. the ScrollWave ones are constants, which the compiler
+// folds into the kernels as it did when epsilon, beta and gam were compiled in. the Runtime ones are read from epsilon, beta and gam, for any
+// other values - into locals, since the fields being written could alias the globals and have them read again at every point
+template<typename Accum>
+struct ScrollWaveRates
+{
+    Accum oneoverepsilon,EPSILON,BETA,GAM;
+    SIMD_INLINE ScrollWaveRates() : oneoverepsilon(1.0/ScrollWaveEpsilon), EPSILON(ScrollWaveEpsilon), BETA(ScrollWaveBeta), GAM(ScrollWaveGam) {}
+};
+template<typename Accum>
+struct RuntimeRates
+{
+    Accum oneoverepsilon,EPSILON,BETA,GAM;
+    SIMD_INLINE RuntimeRates() : oneoverepsilon(1.0/epsilon), EPSILON(epsilon), BETA(beta), GAM(gam) {}
+};
+
+// the FitzHugh-Nagumo right hand side, for a scalar or a vector of points. written out exactly as in uv_update_reference
+template<typename Accum, class Rates, typename A>
+SIMD_INLINE void fn_rhs(const Rates& rates, A currentu, A currentv, A D2u, A& ku, A& kv)
+{
+    const Accum ONETHIRD = 1.0/3.0;
+    ku = rates.oneoverepsilon*(currentu - (ONETHIRD*currentu)*(currentu*currentu) - currentv) + D2u;
+    kv = rates.EPSILON*(currentu + rates.BETA - rates.GAM*currentv);
+}
+
+template<bool FIRSTSTAGE, typename Store, typename Accum, int W, class Rates>
+SIMD_INLINE void rk4_pack(const Rates& rates, int n, int xstride, int ystride, const Store* u, const Store* v, const Store* kuold, const Store* kvold, Store* kunew, Store* kvnew, Accum dtinc, Accum oneoverhsq)
+{
+    typedef Pack<Store,Accum,W> P;
+    typename P::A currentu,currentv,D2u,ku,kv;
+    const Accum six = 6;
+    if(FIRSTSTAGE)
+    {
+        currentu = P::load(u+n);
+        currentv = P::load(v+n);
+        D2u = oneoverhsq*(P::load(u+n+xstride) + P::load(u+n-xstride) + P::load(u+n+ystride) + P::load(u+n-ystride) + P::load(u+n+1) + P::load(u+n-1) - six*currentu);
+    }
+    else
+    {
+        currentu = P::load(u+n) + dtinc*P::load(kuold+n);
+        currentv = P::load(v+n) + dtinc*P::load(kvold+n);
+        D2u = oneoverhsq*((P::load(u+n+xstride)+dtinc*P::load(kuold+n+xstride)) + (P::load(u+n-xstride)+dtinc*P::load(kuold+n-xstride)) + (P::load(u+n+ystride)+dtinc*P::load(kuold+n+ystride))
+                + (P::load(u+n-ystride)+dtinc*P::load(kuold+n-ystride)) + (P::load(u+n+1)+dtinc*P::load(kuold+n+1)) + (P::load(u+n-1)+dtinc*P::load(kuold+n-1)) - six*(currentu));
+    }
+    fn_rhs<Accum>(rates,currentu,currentv,D2u,ku,kv);
+    P::store(kunew+n,ku);
+    P::store(kvnew+n,kv);
+}
+
+template<typename Store, typename Accum, int W, class Rates>
+SIMD_INLINE void lsrk_pack(const Rates& rates, int n, int xstride, int ystride, const Store* u, const Store* v, Store* du, Store* dv, Accum A, Accum dt, Accum oneoverhsq)
+{
+    typedef Pack<Store,Accum,W> P;
+    typename P::A currentu,currentv,D2u,ku,kv;
+    const Accum six = 6;
+    currentu = P::load(u+n);
+    currentv = P::load(v+n);
+    D2u = oneoverhsq*(P::load(u+n+xstride) + P::load(u+n-xstride) + P::load(u+n+ystride) + P::load(u+n-ystride) + P::load(u+n+1) + P::load(u+n-1) - six*currentu);
+    fn_rhs<Accum>(rates,currentu,currentv,D2u,ku,kv);
+    P::store(du+n, A*P::load(du+n) + dt*ku);
+    P::store(dv+n, A*P::load(dv+n) + dt*kv);
+}
+
+// a row, W points at a time, finishing off one at a time
+template<class Rates, bool FIRSTSTAGE, int W>
+SIMD_INLINE void rk4_row(const StoreType* u, const StoreType* v, const StoreType* kuold, const StoreType* kvold, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType dtinc, AccumType oneoverhsq)
+{
+    const Rates rates;
+    int n = n0;
+    for(;n+W<=n1;n+=W) rk4_pack<FIRSTSTAGE,StoreType,AccumType,W>(rates,n,xstride,ystride,u,v,kuold,kvold,kunew,kvnew,dtinc,oneoverhsq);
+    for(;n<n1;n++) rk4_pack<FIRSTSTAGE,StoreType,AccumType,1>(rates,n,xstride,ystride,u,v,kuold,kvold,kunew,kvnew,dtinc,oneoverhsq);
+}
+
+template<class Rates, int W>
+SIMD_INLINE void lsrk_row(const StoreType* u, const StoreType* v, StoreType* du, StoreType* dv, int n0, int n1, int xstride, int ystride, AccumType A, AccumType dt, AccumType oneoverhsq)
+{
+    const Rates rates;
+    int n = n0;
+    for(;n+W<=n1;n+=W) lsrk_pack<StoreType,AccumType,W>(rates,n,xstride,ystride,u,v,du,dv,A,dt,oneoverhsq);
+    for(;n<n1;n++) lsrk_pack<StoreType,AccumType,1>(rates,n,xstride,ystride,u,v,du,dv,A,dt,oneoverhsq);
+}
+
+// lanes per vector register
+const int AVX2Lanes = 32/sizeof(AccumType);
+const int AVX512Lanes = 64/sizeof(AccumType);
+
+// the entry points for each instruction set. the templates above are forced inline into these, so they are compiled for that instruction set
+
+template<class Rates> void rk4first_scalar(const StoreType* u, const StoreType* v, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType oneoverhsq)
+{ rk4_row<Rates,true,1>(u,v,NULL,NULL,kunew,kvnew,n0,n1,xstride,ystride,0,oneoverhsq); }
+template<class Rates> void rk4_scalar(const StoreType* u, const StoreType* v, const StoreType* kuold, const StoreType* kvold, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType dtinc, AccumType oneoverhsq)
+{ rk4_row<Rates,false,1>(u,v,kuold,kvold,kunew,kvnew,n0,n1,xstride,ystride,dtinc,oneoverhsq); }
+template<class Rates> void lsrk_scalar(const StoreType* u, const StoreType* v, StoreType* du, StoreType* dv, int n0, int n1, int xstride, int ystride, AccumType A, AccumType dt, AccumType oneoverhsq)
+{ lsrk_row<Rates,1>(u,v,du,dv,n0,n1,xstride,ystride,A,dt,oneoverhsq); }
+
+template<class Rates> __attribute__((target("avx2")))
+void rk4first_avx2(const StoreType* u, const StoreType* v, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType oneoverhsq)
+{ rk4_row<Rates,true,AVX2Lanes>(u,v,NULL,NULL,kunew,kvnew,n0,n1,xstride,ystride,0,oneoverhsq); }
+template<class Rates> __attribute__((target("avx2")))
+void rk4_avx2(const StoreType* u, const StoreType* v, const StoreType* kuold, const StoreType* kvold, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType dtinc, AccumType oneoverhsq)
+{ rk4_row<Rates,false,AVX2Lanes>(u,v,kuold,kvold,kunew,kvnew,n0,n1,xstride,ystride,dtinc,oneoverhsq); }
+template<class Rates> __attribute__((target("avx2")))
+void lsrk_avx2(const StoreType* u, const StoreType* v, StoreType* du, StoreType* dv, int n0, int n1, int xstride, int ystride, AccumType A, AccumType dt, AccumType oneoverhsq)
+{ lsrk_row<Rates,AVX2Lanes>(u,v,du,dv,n0,n1,xstride,ystride,A,dt,oneoverhsq); }
+
+template<class Rates> __attribute__((target("avx512f")))
+void rk4first_avx512(const StoreType* u, const StoreType* v, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType oneoverhsq)
+{ rk4_row<Rates,true,AVX512Lanes>(u,v,NULL,NULL,kunew,kvnew,n0,n1,xstride,ystride,0,oneoverhsq); }
+template<class Rates> __attribute__((target("avx512f")))
+void rk4_avx512(const StoreType* u, const StoreType* v, const StoreType* kuold, const StoreType* kvold, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType dtinc, AccumType oneoverhsq)
+{ rk4_row<Rates,false,AVX512Lanes>(u,v,kuold,kvold,kunew,kvnew,n0,n1,xstride,ystride,dtinc,oneoverhsq); }
+template<class Rates> __attribute__((target("avx512f")))
+void lsrk_avx512(const StoreType* u, const StoreType* v, StoreType* du, StoreType* dv, int n0, int n1, int xstride, int ystride, AccumType A, AccumType dt, AccumType oneoverhsq)
+{ lsrk_row<Rates,AVX512Lanes>(u,v,du,dv,n0,n1,xstride,ystride,A,dt,oneoverhsq); }
+
+typedef ScrollWaveRates<AccumType> Compiled;
+typedef RuntimeRates<AccumType> Runtime;
+const SimdRowKernels ScalarKernels = {"scalar", rk4first_scalar<Compiled>, rk4_scalar<Compiled>, lsrk_scalar<Compiled>};
+const SimdRowKernels AVX2Kernels = {"avx2", rk4first_avx2<Compiled>, rk4_avx2<Compiled>, lsrk_avx2<Compiled>};
+const SimdRowKernels AVX512Kernels = {"avx512", rk4first_avx512<Compiled>, rk4_avx512<Compiled>, lsrk_avx512<Compiled>};
+const SimdRowKernels RuntimeScalarKernels = {"scalar, run time FN parameters", rk4first_scalar<Runtime>, rk4_scalar<Runtime>, lsrk_scalar<Runtime>};
+const SimdRowKernels RuntimeAVX2Kernels = {"avx2, run time FN parameters", rk4first_avx2<Runtime>, rk4_avx2<Runtime>, lsrk_avx2<Runtime>};
+const SimdRowKernels RuntimeAVX512Kernels = {"avx512, run time FN parameters", rk4first_avx512<Runtime>, rk4_avx512<Runtime>, lsrk_avx512<Runtime>};
+} // namespace
+
+bool simd_path_supported(int path)
+{
+    switch(path)
+    {
+    case SIMD_SCALAR: return true;
+    case SIMD_AVX2: return __builtin_cpu_supports("avx2");
+    case SIMD_AVX512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+}
+
+const SimdRowKernels* simd_row_kernels(int path)
+{
+    // asking for something this CPU can't do gets the best it can
+    if(path==SIMD_AUTO || !simd_path_supported(path))
+    {
+        if(simd_path_supported(SIMD_AVX512)) path = SIMD_AVX512;
+        else if(simd_path_supported(SIMD_AVX2)) path = SIMD_AVX2;
+        else path = SIMD_SCALAR;
+    }
+    // the kernels with epsilon, beta and gam compiled in, unless they have been set to something else
+    const bool scrollwave = (epsilon == ScrollWaveEpsilon && beta == ScrollWaveBeta && gam == ScrollWaveGam);
+    switch(path)
+    {
+    case SIMD_AVX2: return scrollwave ? &AVX2Kernels : &RuntimeAVX2Kernels;
+    case SIMD_AVX512: return scrollwave ? &AVX512Kernels : &RuntimeAVX512Kernels;
+    }
+    return scrollwave ? &ScalarKernels : &RuntimeScalarKernels;
+}
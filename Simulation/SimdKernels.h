@@ -0,0 +1,27 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+using namespace std;
+
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+// vectorised kernels for a row of the blocked update, ie. a run of points n0 <= n < n1 along z whose neighbours are all at constant strides
+// (+-xstride, +-ystride, +-1). the fields are padded (see Field.h), so this holds right up to the boundaries, the halos standing in for the
+// neighbours across them.
+// there is one set of kernels per instruction set, all for StoreType/AccumType, and they give bit identical results to the scalar ones
+struct SimdRowKernels
+{
+    const char* name;
+    // first RK4 stage: k1 from u,v
+    void (*rk4first)(const StoreType* u, const StoreType* v, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType oneoverhsq);
+    // later RK4 stages: the next k, evaluated at u + dtinc*kold
+    void (*rk4)(const StoreType* u, const StoreType* v, const StoreType* kuold, const StoreType* kvold, StoreType* kunew, StoreType* kvnew, int n0, int n1, int xstride, int ystride, AccumType dtinc, AccumType oneoverhsq);
+    // a low storage RK stage: du <- A*du + dt*F(u)
+    void (*lsrk)(const StoreType* u, const StoreType* v, StoreType* du, StoreType* dv, int n0, int n1, int xstride, int ystride, AccumType A, AccumType dt, AccumType oneoverhsq);
+};
+
+// the SIMD paths, best last. SIMD_AUTO picks the best one this CPU can run
+bool simd_path_supported(int path);
+const SimdRowKernels* simd_row_kernels(int path);
+
+#endif //SIMDKERNELS_H
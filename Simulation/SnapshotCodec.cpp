@@ -0,0 +1,340 @@
+#include "SnapshotCodec.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <zlib.h>
+
+static const char UVMagic[8] = {'F','N','K','N','O','T','U','Z'};
+static const int32_t UVVersion = 1;
+static const int32_t ByteOrderMark = 0x01020304;
+
+// the bytes of n values of width bytes each, regrouped so that byte b of every value comes before byte b+1 of any, and back
+static void shuffle(const unsigned char* in, size_t n, int width, unsigned char* out)
+{
+    for(int b=0;b<width;b++) for(size_t i=0;i<n;i++) out[b*n+i] = in[i*width+b];
+}
+
+static void unshuffle(const unsigned char* in, size_t n, int width, unsigned char* out)
+{
+    for(int b=0;b<width;b++) for(size_t i=0;i<n;i++) out[i*width+b] = in[b*n+i];
+}
+
+// deflate in onto the end of out, and inflate it again into exactly outbytes bytes. both return false if zlib fails
+static bool deflate_bytes(const vector<unsigned char>& in, vector<unsigned char>& out)
+{
+    const size_t at = out.size();
+    uLongf size = compressBound(in.size());
+    out.resize(at+size);
+    if(compress2(out.data()+at,&size,in.data(),in.size(),Z_BEST_SPEED) != Z_OK) return false;
+    out.resize(at+size);
+    return true;
+}
+
+static bool inflate_bytes(const unsigned char* in, size_t nbytes, unsigned char* out, size_t outbytes)
+{
+    uLongf size = outbytes;
+    return uncompress(out,&size,in,nbytes) == Z_OK && size == outbytes;
+}
+
+static bool shuffle_lz_compress(const float* values, size_t n, double /*errorbound*/, vector<unsigned char>& bytes)
+{
+    vector<unsigned char> shuffled(n*sizeof(float));
+    shuffle((const unsigned char*)values,n,sizeof(float),shuffled.data());
+    bytes.clear();
+    return deflate_bytes(shuffled,bytes);
+}
+
+static bool shuffle_lz_decompress(const unsigned char* bytes, size_t nbytes, size_t n, double /*errorbound*/, float* values)
+{
+    vector<unsigned char> shuffled(n*sizeof(float));
+    if(!inflate_bytes(bytes,nbytes,shuffled.data(),shuffled.size())) return false;
+    unshuffle(shuffled.data(),n,sizeof(float),(unsigned char*)values);
+    return true;
+}
+
+// the first byte says whether the slab was rounded (1), or kept losslessly (0) because it couldn't be
+static bool error_bounded_compress(const float* values, size_t n, double errorbound, vector<unsigned char>& bytes)
+{
+    const double step = 2*errorbound;
+    bool fits = (errorbound > 0);
+    for(size_t i=0;i<n && fits;i++) fits = (fabs(values[i]/step) < 1073741824.0);
+    if(!fits)
+    {
+        vector<unsigned char> lossless;
+        if(!shuffle_lz_compress(values,n,errorbound,lossless)) return false;
+        bytes.assign(1,0);
+        bytes.insert(bytes.end(),lossless.begin(),lossless.end());
+        return true;
+    }
+    // the differences between neighbouring multiples, zigzagged so that small negative ones are small too
+    vector<uint32_t> deltas(n);
+    int32_t previous = 0;
+    for(size_t i=0;i<n;i++)
+    {
+        const int32_t q = (int32_t)lrint(values[i]/step);
+        const int32_t d = q - previous;
+        deltas[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+        previous = q;
+    }
+    vector<unsigned char> shuffled(n*sizeof(uint32_t));
+    shuffle((const unsigned char*)deltas.data(),n,sizeof(uint32_t),shuffled.data());
+    bytes.assign(1,1);
+    return deflate_bytes(shuffled,bytes);
+}
+
+static bool error_bounded_decompress(const unsigned char* bytes, size_t nbytes, size_t n, double errorbound, float* values)
+{
+    if(nbytes < 1) return false;
+    if(bytes[0] == 0) return shuffle_lz_decompress(bytes+1,nbytes-1,n,errorbound,values);
+    vector<unsigned char> shuffled(n*sizeof(uint32_t));
+    if(bytes[0] != 1 || !inflate_bytes(bytes+1,nbytes-1,shuffled.data(),shuffled.size())) return false;
+    vector<uint32_t> deltas(n);
+    unshuffle(shuffled.data(),n,sizeof(uint32_t),(unsigned char*)deltas.data());
+    const double step = 2*errorbound;
+    int32_t q = 0;
+    for(size_t i=0;i<n;i++)
+    {
+        q += (int32_t)((deltas[i] >> 1) ^ (0u - (deltas[i] & 1)));
+        values[i] = (float)(q*step);
+    }
+    return true;
+}
+
+static const SnapshotCodec Codecs[] = {
+    {"shuffle + LZ", shuffle_lz_compress, shuffle_lz_decompress},
+    {"error bounded", error_bounded_compress, error_bounded_decompress},
+};
+
+const SnapshotCodec* snapshot_codec(int codec)
+{
+    if(codec < 0 || codec >= (int)(sizeof(Codecs)/sizeof(Codecs[0]))) return NULL;
+    return &Codecs[codec];
+}
+
+template<typename T> static void put(ostream& out, const T& value)
+{
+    out.write((const char*)&value,sizeof(T));
+}
+
+// the whole file, mapped into memory, and how far through it we are. a read past the end gives zero, and sets overrun
+struct MappedUVFile
+{
+    const char* data;
+    size_t size;
+    size_t at;
+    bool overrun;
+};
+
+template<typename T> static T get(MappedUVFile& in)
+{
+    T value = T();
+    if(in.at + sizeof(T) > in.size)
+    {
+        in.overrun = true;
+        return value;
+    }
+    memcpy(&value,in.data+in.at,sizeof(T));
+    in.at += sizeof(T);
+    return value;
+}
+
+// the slabs are no more than 16MB of floats, and there are a few for each thread
+static int slab_planes(const CompressedUVHeader& header, int threads)
+{
+    const int planes = min((1<<22)/(header.Nx*header.Ny),(header.Nz+4*threads-1)/(4*threads));
+    return max(1,planes);
+}
+
+bool compressed_uv_file(const string& filename)
+{
+    ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+    char magic[sizeof(UVMagic)];
+    return fin.read(magic,sizeof(magic)) && memcmp(magic,UVMagic,sizeof(UVMagic)) == 0;
+}
+
+bool write_compressed_uv(const string& filename, const CompressedUVHeader& header, const int codecs[3], const function<void(int,int,int,float*)>& fill, int threads, size_t& rawbytes, size_t& filebytes)
+{
+    const int Nx = header.Nx;
+    const int Ny = header.Ny;
+    const int Nz = header.Nz;
+    const int planes = slab_planes(header,threads);
+    const int slabs = (Nz+planes-1)/planes;
+    ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if(!out.good())
+    {
+        cout << "couldn't open " << filename << " to write\n";
+        return false;
+    }
+    out.write(UVMagic,sizeof(UVMagic));
+    put(out,UVVersion);
+    put(out,ByteOrderMark);
+    put<int32_t>(out,Nx);
+    put<int32_t>(out,Ny);
+    put<int32_t>(out,Nz);
+    put<int32_t>(out,planes);
+    put(out,header.h);
+    for(int d=0;d<3;d++) put(out,header.origin[d]);
+    put(out,header.t);
+    put(out,header.errorbound);
+
+    vector<vector<unsigned char> > packed(slabs);
+    for(int section=0;section<3;section++)
+    {
+        const SnapshotCodec* codec = snapshot_codec(codecs[section]);
+        int failed = 0;
+#pragma omp parallel num_threads(threads)
+        {
+            vector<float> values;
+#pragma omp for schedule(dynamic) reduction(+:failed)
+            for(int s=0;s<slabs;s++)
+            {
+                const int k0 = s*planes;
+                const int k1 = min(Nz,k0+planes);
+                values.resize((size_t)(k1-k0)*Nx*Ny);
+                fill(section,k0,k1,values.data());
+                if(!codec->compress(values.data(),values.size(),header.errorbound,packed[s])) failed++;
+            }
+        }
+        // a slab that couldn't be packed would only turn up as a corrupt file when it was read back, so none of it is kept
+        if(failed)
+        {
+            cout << "couldn't compress " << failed << " slab(s) of section " << section << " of " << filename << " with " << codec->name << ", so it isn't written\n";
+            out.close();
+            remove(filename.c_str());
+            return false;
+        }
+        put<int32_t>(out,codecs[section]);
+        put<int32_t>(out,slabs);
+        for(int s=0;s<slabs;s++) put<int64_t>(out,packed[s].size());
+        for(int s=0;s<slabs;s++) out.write((const char*)packed[s].data(),packed[s].size());
+    }
+    rawbytes += 3*sizeof(float)*(size_t)Nx*Ny*Nz;
+    filebytes += out.tellp();
+    out.close();
+    if(out.fail())
+    {
+        cout << "couldn't write " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+// map the file in and read its header, leaving in just after it
+static bool map_compressed_uv(const string& filename, MappedUVFile& in, CompressedUVHeader& header, int& planes)
+{
+    const int fd = open(filename.c_str(),O_RDONLY);
+    struct stat filestat;
+    if(fd < 0 || fstat(fd,&filestat) != 0 || filestat.st_size == 0)
+    {
+        cout << "couldn't open " << filename << "\n";
+        if(fd >= 0) close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL,filestat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        cout << "couldn't map " << filename << "\n";
+        return false;
+    }
+    in.data = (const char*)mapping;
+    in.size = filestat.st_size;
+    in.at = sizeof(UVMagic);
+    in.overrun = false;
+    const bool magic = (in.size >= sizeof(UVMagic) && memcmp(in.data,UVMagic,sizeof(UVMagic)) == 0);
+    const int32_t version = get<int32_t>(in);
+    const int32_t byteorder = get<int32_t>(in);
+    if(!magic || version != UVVersion || byteorder != ByteOrderMark)
+    {
+        cout << filename << " isn't a compressed uv file this version of the code can read on this machine\n";
+        munmap(mapping,in.size);
+        return false;
+    }
+    header.Nx = get<int32_t>(in);
+    header.Ny = get<int32_t>(in);
+    header.Nz = get<int32_t>(in);
+    planes = get<int32_t>(in);
+    header.h = get<double>(in);
+    for(int d=0;d<3;d++) header.origin[d] = get<double>(in);
+    header.t = get<double>(in);
+    header.errorbound = get<double>(in);
+    if(in.overrun || header.Nx < 1 || header.Ny < 1 || header.Nz < 1 || planes < 1)
+    {
+        cout << "the header of " << filename << " is cut short or garbled\n";
+        munmap(mapping,in.size);
+        return false;
+    }
+    return true;
+}
+
+bool read_compressed_uv_header(const string& filename, CompressedUVHeader& header)
+{
+    MappedUVFile in;
+    int planes;
+    if(!map_compressed_uv(filename,in,header,planes)) return false;
+    munmap((void*)in.data,in.size);
+    return true;
+}
+
+bool read_compressed_uv(const string& filename, int nsections, const function<void(int,int,int,const float*)>& slab)
+{
+    MappedUVFile in;
+    CompressedUVHeader header;
+    int planes;
+    if(!map_compressed_uv(filename,in,header,planes)) return false;
+    const int Nx = header.Nx;
+    const int Ny = header.Ny;
+    const int Nz = header.Nz;
+    bool ok = true;
+    for(int section=0;section<nsections && ok;section++)
+    {
+        const SnapshotCodec* codec = snapshot_codec(get<int32_t>(in));
+        const int slabs = get<int32_t>(in);
+        if(!codec || slabs != (Nz+planes-1)/planes)
+        {
+            ok = false;
+            break;
+        }
+        vector<size_t> offsets(slabs+1);
+        offsets[0] = in.at + slabs*sizeof(int64_t);
+        for(int s=0;s<slabs;s++)
+        {
+            const int64_t bytes = get<int64_t>(in);
+            if(bytes < 0 || in.overrun) ok = false;
+            offsets[s+1] = offsets[s] + (ok ? bytes : 0);
+        }
+        if(!ok || offsets[slabs] > in.size)
+        {
+            ok = false;
+            break;
+        }
+        int bad = 0;
+#pragma omp parallel if(!omp_in_parallel())
+        {
+            vector<float> values;
+#pragma omp for schedule(dynamic) reduction(+:bad)
+            for(int s=0;s<slabs;s++)
+            {
+                const int k0 = s*planes;
+                const int k1 = min(Nz,k0+planes);
+                values.resize((size_t)(k1-k0)*Nx*Ny);
+                if(codec->decompress((const unsigned char*)in.data+offsets[s],offsets[s+1]-offsets[s],values.size(),header.errorbound,values.data())) slab(section,k0,k1,values.data());
+                else bad++;
+            }
+        }
+        ok = (bad == 0);
+        in.at = offsets[slabs];
+    }
+    munmap((void*)in.data,in.size);
+    if(!ok) cout << "the sections of " << filename << " are cut short or garbled\n";
+    return ok;
+}
@@ -0,0 +1,56 @@
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+#ifndef SNAPSHOTCODEC_H
+#define SNAPSHOTCODEC_H
+
+// the codecs a compressed uv file can use (UVCodec in FN_Constants.h)
+// UV_CODEC_SHUFFLE_LZ is lossless: the floats of a slab are split into their four byte planes, which puts the slowly varying sign and exponent
+// bytes together, and then deflated (zlib's LZ77 and Huffman coding).
+// UV_CODEC_ERROR_BOUNDED first rounds each value to the nearest multiple of twice the error bound, so that no value moves by more than the
+// bound (plus the rounding of the float it is read back as). the multiples are stored as differences along i, which on a smooth field are
+// mostly tiny, and then shuffled and deflated the same way. a slab too far from 0 for the multiples to fit in 32 bits is kept losslessly
+#define UV_CODEC_SHUFFLE_LZ 0
+#define UV_CODEC_ERROR_BOUNDED 1
+
+// a codec packs n floats into bytes, and unpacks them again, given the same n and error bound. compress returns false if it couldn't pack
+// them, and decompress if the bytes aren't what compress gave it. new codecs go in the table in SnapshotCodec.cpp
+struct SnapshotCodec
+{
+    const char* name;
+    bool (*compress)(const float* values, size_t n, double errorbound, vector<unsigned char>& bytes);
+    bool (*decompress)(const unsigned char* bytes, size_t nbytes, size_t n, double errorbound, float* values);
+};
+// the codec with the given number, or NULL if there isn't one
+const SnapshotCodec* snapshot_codec(int codec);
+
+// compressed uv files, uv_plot<t>.uvz, hold the same three sections as the VTK ones - u, v and ucrossv, as floats with i fastest and k
+// slowest - each cut into slabs of whole z planes which are compressed on their own, so they can be packed and unpacked in parallel.
+// the file is written in the byte order of the machine, which the header records (in practice, little endian):
+//   "FNKNOTUZ", int32 version, int32 0x01020304, int32 Nx, Ny, Nz and planes per slab, then double h, the origin x, y and z, t and the error bound
+//   then for each section: int32 codec and number of slabs, int64 compressed bytes of each slab, then the slabs
+struct CompressedUVHeader
+{
+    int Nx,Ny,Nz;
+    double h;
+    double origin[3];
+    double t;
+    double errorbound;
+};
+
+// does the file start as a compressed uv file does
+bool compressed_uv_file(const string& filename);
+// write a compressed uv file. fill(section, k0, k1, values) is asked for the planes k0 <= k < k1 of each section in turn, i fastest, and
+// codecs[section] packs them. the slabs are filled and packed over the given number of threads, so fill is called from several at once, for
+// different slabs. the floats the file holds and its size in bytes are added to rawbytes and filebytes. returns false, having said why, if
+// the file can't be written
+bool write_compressed_uv(const string& filename, const CompressedUVHeader& header, const int codecs[3], const function<void(int,int,int,float*)>& fill, int threads, size_t& rawbytes, size_t& filebytes);
+// read the header of a compressed uv file, then the first nsections sections, handing slab(section, k0, k1, values) the planes k0 <= k < k1 of
+// each, i fastest. the slabs are unpacked in parallel, so slab is called from several threads at once, for different slabs. the file is
+// mapped in rather than read through. returns false, having said why, if it can't be read
+bool read_compressed_uv_header(const string& filename, CompressedUVHeader& header);
+bool read_compressed_uv(const string& filename, int nsections, const function<void(int,int,int,const float*)>& slab);
+
+#endif //SNAPSHOTCODEC_H
@@ -0,0 +1,94 @@
+#include "SnapshotQueue.h"
+#include <omp.h>
+
+void SnapshotQueue::start(int n, const function<void(int)>& w)
+{
+    length = n;
+    work = w;
+    queued.clear();
+    freeslots.clear();
+    for(int s=length-1;s>=0;s--) freeslots.push_back(s);
+    stopping = false;
+    waitseconds = 0;
+    droppedslots = 0;
+    worker = thread(&SnapshotQueue::loop,this);
+}
+
+void SnapshotQueue::loop()
+{
+    while(true)
+    {
+        int s;
+        {
+            unique_lock<mutex> lock(queuelock);
+            while(queued.empty() && !stopping) queuechanged.wait(lock);
+            if(queued.empty()) break;
+            s = queued.front();
+            queued.pop_front();
+        }
+        work(s);
+        {
+            lock_guard<mutex> lock(queuelock);
+            freeslots.push_back(s);
+        }
+        queuechanged.notify_all();
+    }
+}
+
+int SnapshotQueue::acquire(bool drop)
+{
+    unique_lock<mutex> lock(queuelock);
+    if(freeslots.empty() && drop)
+    {
+        droppedslots++;
+        return -1;
+    }
+    const double starttime = omp_get_wtime();
+    while(freeslots.empty()) queuechanged.wait(lock);
+    waitseconds += omp_get_wtime() - starttime;
+    const int s = freeslots.back();
+    freeslots.pop_back();
+    return s;
+}
+
+void SnapshotQueue::submit(int slot)
+{
+    {
+        lock_guard<mutex> lock(queuelock);
+        queued.push_back(slot);
+    }
+    queuechanged.notify_all();
+}
+
+void SnapshotQueue::drain()
+{
+    // once every slot is free again the thread has worked on them all, and is waiting
+    unique_lock<mutex> lock(queuelock);
+    while(!queued.empty() || (int)freeslots.size() < length) queuechanged.wait(lock);
+}
+
+void SnapshotQueue::finish()
+{
+    {
+        lock_guard<mutex> lock(queuelock);
+        stopping = true;
+    }
+    queuechanged.notify_all();
+    if(worker.joinable()) worker.join();
+}
+
+double SnapshotQueue::wait_seconds()
+{
+    lock_guard<mutex> lock(queuelock);
+    const double seconds = waitseconds;
+    waitseconds = 0;
+    return seconds;
+}
+
+int SnapshotQueue::dropped()
+{
+    lock_guard<mutex> lock(queuelock);
+    const int n = droppedslots;
+    droppedslots = 0;
+    return n;
+}
@@ -0,0 +1,50 @@
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+using namespace std;
+
+#ifndef SNAPSHOTQUEUE_H
+#define SNAPSHOTQUEUE_H
+
+// a fixed number of slots handed between the main loop and a thread of their own, for the analysis thread (see Analysis.h) and the uv
+// writer (see SnapshotWriter.h). the slots themselves belong to the user, which fills the slot acquire gives it and submits it, and the thread
+// calls work on each submitted slot in turn, oldest first, after which the slot is free again. when no slot is free acquire waits for one,
+// which is how the thread holds the main loop back if it falls behind. a slot that has been acquired and not yet submitted, or has been
+// worked on and is free again, is touched by nobody but the main loop, so it can be filled or read without any lock
+class SnapshotQueue
+{
+public:
+    SnapshotQueue() : length(0), stopping(false), waitseconds(0), droppedslots(0) {}
+    // start the thread, with slots numbered 0 to length-1
+    void start(int length, const function<void(int)>& work);
+    // a free slot, waiting for one if there are none - or, with drop, -1 straight away. call from one thread
+    int acquire(bool drop=false);
+    // queue a slot from acquire, once it is filled
+    void submit(int slot);
+    // wait for every queued slot to be worked on
+    void drain();
+    // wait for every queued slot to be worked on, then stop the thread
+    void finish();
+    // the time acquire spent waiting for a free slot, and the number of times it returned -1, since the last call
+    double wait_seconds();
+    int dropped();
+
+private:
+    int length;
+    deque<int> queued;      // slots waiting to be worked on, oldest first
+    vector<int> freeslots;
+    bool stopping;
+    mutex queuelock;
+    condition_variable queuechanged;
+    thread worker;
+    function<void(int)> work;
+    double waitseconds;
+    int droppedslots;
+
+    void loop();
+};
+
+#endif //SNAPSHOTQUEUE_H
@@ -0,0 +1,51 @@
+#include "SnapshotWriter.h"
+#include "ReadingWriting.h"
+#include "SnapshotQueue.h"
+
+// a copy of what a uv file is written from
+struct StagedSnapshot
+{
+    Field<StoreType> u,v;
+    vector<double> ucvmag;
+    double t;
+    Griddata griddata;
+};
+
+static vector<StagedSnapshot> staged;
+static SnapshotQueue queue;
+
+static void write_staged(int s)
+{
+    StagedSnapshot& snapshot = staged[s];
+    write_uv_file(snapshot.u,snapshot.v,snapshot.ucvmag,snapshot.t,snapshot.griddata,OutputThreads);
+}
+
+void snapshot_writer_start()
+{
+    // the buffers are sized the first time they are used
+    staged.resize(OutputQueueLength);
+    queue.start(OutputQueueLength,write_staged);
+}
+
+void snapshot_writer_submit(const Field<StoreType>& u, const Field<StoreType>& v, const vector<double>& ucvmag, double t, const Griddata& griddata)
+{
+    // nothing is dropped, so this waits for a buffer if need be
+    const int s = queue.acquire();
+    StagedSnapshot& snapshot = staged[s];
+    snapshot.u = u;
+    snapshot.v = v;
+    snapshot.ucvmag = ucvmag;
+    snapshot.t = t;
+    snapshot.griddata = griddata;
+    queue.submit(s);
+}
+
+void snapshot_writer_finish()
+{
+    queue.finish();
+}
+
+double snapshot_writer_wait_seconds()
+{
+    return queue.wait_seconds();
+}
@@ -0,0 +1,23 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+#include "Field.h"
+using namespace std;
+
+#ifndef SNAPSHOTWRITER_H
+#define SNAPSHOTWRITER_H
+
+// writing the uv files on a thread of its own (AsyncOutput). at each uv print the main loop copies u, v and |grad u x grad v| into a free
+// staging buffer, queues it, and steps on, while the writer thread takes the buffers in order and writes each just as print_uv would have,
+// with OutputThreads threads turning it into floats. there are OutputQueueLength buffers, and when none is free the main loop waits for one.
+// nothing is ever dropped. the solver shares nothing with the writer but the buffers. it needs the whole grid on one MPI rank
+
+// start the writer thread
+void snapshot_writer_start();
+// queue a copy of u, v and ucvmag at time t, to be written as uv_plot<t>.vtk. call from one thread
+void snapshot_writer_submit(const Field<StoreType>& u, const Field<StoreType>& v, const vector<double>& ucvmag, double t, const Griddata& griddata);
+// wait for everything queued to be written, then stop the writer thread
+void snapshot_writer_finish();
+// the time snapshot_writer_submit spent waiting for a free buffer since the last call
+double snapshot_writer_wait_seconds();
+
+#endif //SNAPSHOTWRITER_H
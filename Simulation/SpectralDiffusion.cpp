@@ -0,0 +1,170 @@
+#include "SpectralDiffusion.h"
+#include <math.h>
+#include <gsl/gsl_fft_real.h>
+#include <gsl/gsl_fft_halfcomplex.h>
+
+// the transform along one axis, and the factor exp(t lambda) each of its coefficients gets, lambda being the eigenvalue of the 1D Laplacian
+// for that coefficient
+struct AxisTransform
+{
+    int N;              // points along the axis, 0 until it's set up
+    bool reflecting;
+    int n;              // the FFT length: N, or 2N for a mirrored line
+    gsl_fft_real_wavetable* real;
+    gsl_fft_halfcomplex_wavetable* hc;
+    vector<double> cosines,sines;    // cos and sin of pi k/2N, for turning the FFT of a mirrored line into a DCT and back
+    vector<double> factor;           // exp(t lambda) for the coefficient in each slot
+};
+static AxisTransform axes[3] = {{0,false,0,NULL,NULL},{0,false,0,NULL,NULL},{0,false,0,NULL,NULL}};
+
+// lines along y and x are strided, so they go through in batches running along z, which uses whole cache lines of f
+const int LineBatch = 8;
+
+// each thread's copy of the lines it is working on, and the GSL scratch space for each axis, which has to be the length of the FFT
+struct LineWork
+{
+    int n[3];
+    gsl_fft_real_workspace* work[3];
+    int linelength;
+    vector<double> lines;
+    LineWork() : linelength(0) { for(int a=0;a<3;a++) { n[a] = 0; work[a] = NULL; } }
+    ~LineWork() { for(int a=0;a<3;a++) if(work[a]) gsl_fft_real_workspace_free(work[a]); }
+    void resize()
+    {
+        for(int a=0;a<3;a++)
+        {
+            if(n[a] == axes[a].n) continue;
+            if(work[a]) gsl_fft_real_workspace_free(work[a]);
+            n[a] = axes[a].n;
+            work[a] = gsl_fft_real_workspace_alloc(n[a]);
+            if(n[a] > linelength)
+            {
+                linelength = n[a];
+                lines.assign((size_t)LineBatch*linelength,0);
+            }
+        }
+    }
+};
+
+// set up the transforms for this grid, if they aren't already, and the factors for this t
+static void plan(double t, const Griddata& griddata)
+{
+    const int N[3] = {griddata.Nx, griddata.Ny, griddata.Nz};
+    // z is periodic unless everything reflects, x and y only when everything is periodic
+    const bool reflecting[3] = {griddata.boundarytype != ALLPERIODIC, griddata.boundarytype != ALLPERIODIC, griddata.boundarytype == ALLREFLECTING};
+    const double oneoverhsq = 1.0/(griddata.h*griddata.h);
+    for(int a=0;a<3;a++)
+    {
+        AxisTransform& axis = axes[a];
+        if(axis.N != N[a] || axis.reflecting != reflecting[a])
+        {
+            if(axis.real) gsl_fft_real_wavetable_free(axis.real);
+            if(axis.hc) gsl_fft_halfcomplex_wavetable_free(axis.hc);
+            axis.N = N[a];
+            axis.reflecting = reflecting[a];
+            axis.n = reflecting[a] ? 2*N[a] : N[a];
+            axis.real = gsl_fft_real_wavetable_alloc(axis.n);
+            axis.hc = gsl_fft_halfcomplex_wavetable_alloc(axis.n);
+            axis.cosines.resize(N[a]);
+            axis.sines.resize(N[a]);
+            for(int k=0;k<N[a];k++)
+            {
+                axis.cosines[k] = cos(M_PI*k/(2.0*N[a]));
+                axis.sines[k] = sin(M_PI*k/(2.0*N[a]));
+            }
+            axis.factor.resize(N[a]);
+        }
+        // along a periodic axis GSL's halfcomplex order keeps wavenumber k in slots 2k-1 and 2k, and the eigenvalue of the Laplacian is
+        // -4/h^2 sin^2(pi k/N). along a reflecting axis slot k holds the kth DCT coefficient, and it's -4/h^2 sin^2(pi k/2N)
+        for(int s=0;s<N[a];s++)
+        {
+            const double angle = reflecting[a] ? M_PI*s/(2.0*N[a]) : M_PI*((s+1)/2)/N[a];
+            axis.factor[s] = exp(-4*t*oneoverhsq*sin(angle)*sin(angle));
+        }
+    }
+}
+
+// take a line to the coefficients of the 1D Laplacian's eigenvectors, in place. the line needs room for axis.n values
+static void forward_transform(const AxisTransform& axis, double* line, gsl_fft_real_workspace* work)
+{
+    if(!axis.reflecting)
+    {
+        gsl_fft_real_transform(line, 1, axis.n, axis.real, work);
+        return;
+    }
+    // the FFT Y of the line mirrored to length 2N is Y_k = exp(i pi k/2N) C_k, C_k being the DCT-II of the line. C_k goes in slot k, which
+    // is never ahead of the slots 2k-1 and 2k Y_k is read from
+    const int N = axis.N;
+    for(int j=0;j<N;j++) line[2*N-1-j] = line[j];
+    gsl_fft_real_transform(line, 1, axis.n, axis.real, work);
+    for(int k=1;k<N;k++) line[k] = line[2*k-1]*axis.cosines[k] + line[2*k]*axis.sines[k];
+}
+
+// and back again
+static void inverse_transform(const AxisTransform& axis, double* line, gsl_fft_real_workspace* work)
+{
+    if(!axis.reflecting)
+    {
+        gsl_fft_halfcomplex_inverse(line, 1, axis.n, axis.hc, work);
+        return;
+    }
+    // rebuild Y from the top down, so each C_k is read before anything lands on it. Y_N is 0
+    const int N = axis.N;
+    line[2*N-1] = 0;
+    for(int k=N-1;k>=1;k--)
+    {
+        const double C = line[k];
+        line[2*k-1] = C*axis.cosines[k];
+        line[2*k] = C*axis.sines[k];
+    }
+    gsl_fft_halfcomplex_inverse(line, 1, axis.n, axis.hc, work);
+}
+
+// diffuse width lines along axis a, line b starting at f[base+b] and running with the given stride
+static void diffuse_lines(int a, double* f, int base, int width, int stride, LineWork& linework)
+{
+    const AxisTransform& axis = axes[a];
+    const int N = axis.N;
+    for(int b=0;b<width;b++)
+    {
+        double* line = &linework.lines[(size_t)b*linework.linelength];
+        for(int j=0;j<N;j++) line[j] = f[base+b+j*stride];
+    }
+    for(int b=0;b<width;b++)
+    {
+        double* line = &linework.lines[(size_t)b*linework.linelength];
+        forward_transform(axis, line, linework.work[a]);
+        for(int s=0;s<N;s++) line[s] *= axis.factor[s];
+        inverse_transform(axis, line, linework.work[a]);
+    }
+    for(int b=0;b<width;b++)
+    {
+        const double* line = &linework.lines[(size_t)b*linework.linelength];
+        for(int j=0;j<N;j++) f[base+b+j*stride] = line[j];
+    }
+}
+
+void diffuse(vector<double>& f, double t, const Griddata& griddata)
+{
+    const int Nx = griddata.Nx;
+    const int Ny = griddata.Ny;
+    const int Nz = griddata.Nz;
+#pragma omp single
+    plan(t, griddata);
+    static thread_local LineWork linework;
+    linework.resize();
+    double* data = f.data();
+    // z lines are contiguous
+#pragma omp for
+    for(int l=0;l<Nx*Ny;l++) diffuse_lines(2, data, l*Nz, 1, 1, linework);
+#pragma omp for collapse(2)
+    for(int i=0;i<Nx;i++)
+    {
+        for(int k0=0;k0<Nz;k0+=LineBatch) diffuse_lines(1, data, i*Ny*Nz+k0, (Nz-k0 < LineBatch) ? Nz-k0 : LineBatch, Nz, linework);
+    }
+#pragma omp for collapse(2)
+    for(int j=0;j<Ny;j++)
+    {
+        for(int k0=0;k0<Nz;k0+=LineBatch) diffuse_lines(0, data, j*Nz+k0, (Nz-k0 < LineBatch) ? Nz-k0 : LineBatch, Ny*Nz, linework);
+    }
+}
@@ -0,0 +1,17 @@
+#include "FN_Constants.h"
+#include "FN_Knot.h"
+#include <vector>
+using namespace std;
+
+#ifndef SPECTRALDIFFUSION_H
+#define SPECTRALDIFFUSION_H
+
+// the diffusion half of the IMEX integrator: f <- exp(t Del^2) f, where Del^2 is the same 7 point Laplacian the explicit kernels use, so for
+// any t there is no stability limit. each axis is diagonalised by a 1D transform - a real FFT along a periodic axis, and a DCT along a
+// reflecting one, whose ghost points mirror the last plane (a DCT-II is an FFT of the line mirrored to twice its length). the exponential
+// of the 3D Laplacian is the product of those along each axis, so each line is transformed, scaled and transformed back in one go, one axis
+// at a time, rather than holding a whole 3D spectrum.
+// f is the whole Nx x Ny x Nz grid, unpadded, laid out as pt(). call it from every thread of a parallel region
+void diffuse(vector<double>& f, double t, const Griddata& griddata);
+
+#endif //SPECTRALDIFFUSION_H
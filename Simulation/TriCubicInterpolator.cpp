@@ -4,12 +4,15 @@
 #include "RuntimeError.h"
 
 #include <cmath>
+#include <atomic>
 
 namespace local = likely;
 
-local::TriCubicInterpolator::TriCubicInterpolator(DataCube& data, double spacing, int n1, int n2, int n3)
-: _data(data), _spacing(spacing), _n1(n1), _n2(n2), _n3(n3), _initialized(false)
+local::TriCubicInterpolator::TriCubicInterpolator(DataCube& data, double spacing, int n1, int n2, int n3, bool shared)
+: _data(data), _spacing(spacing), _n1(n1), _n2(n2), _n3(n3), _shards(shared ? new Shard[_nShards] : 0), _initialized(false)
 {
+    static std::atomic<unsigned long> interpolators(0);
+    _id = ++interpolators;
     if(_n2 == 0 && _n3 == 0) {
         _n3 = _n2 = _n1;
     }
@@ -19,17 +22,17 @@ local::TriCubicInterpolator::TriCubicInterpolator(DataCube& data, double spacing
 
 local::TriCubicInterpolator::~TriCubicInterpolator() { }
 
-double local::TriCubicInterpolator::operator()(double x, double y, double z) const {
+const double* local::TriCubicInterpolator::_voxel(double x, double y, double z, double& dx, double& dy, double& dz) const {
     // Code here is based on:
     // https://svn.blender.org/svnroot/bf-blender/branches/volume25/source/blender/blenlib/intern/voxel.c
     
     // Map x,y,z to a point dx,dy,dz in the cube [0,n1) x [0,n2) x [0,n3)
     // assuming the grid is centre aligned, ie we have the relation
-    // x(i) = (i+((Nx-1)/2))*spacing
+    // x(i) = (i-(n1-1)/2)*spacing
     //double dx(std::fmod(x/_spacing,_n1)), dy(std::fmod(y/_spacing,_n2)), dz(std::fmod(z/_spacing,_n3));
-    double dx  = (x/_spacing)+(_n1 -1)/2;
-    double dy  = (y/_spacing)+(_n2 -1)/2;
-    double dz  = (z/_spacing)+(_n3 -1)/2;
+    dx  = gridCoordinate(x,_spacing,_n1);
+    dy  = gridCoordinate(y,_spacing,_n2);
+    dz  = gridCoordinate(z,_spacing,_n3);
     if(dx < 0) dx += _n1;
     if(dy < 0) dy += _n2;
     if(dz < 0) dz += _n3;
@@ -37,9 +40,115 @@ double local::TriCubicInterpolator::operator()(double x, double y, double z) con
     int xi = (int)std::floor(dx);
     int yi = (int)std::floor(dy);
     int zi = (int)std::floor(dz);
+    dx -= xi;
+    dy -= yi;
+    dz -= zi;
+    return _coefficients(_index(xi,yi,zi),xi,yi,zi);
+}
+
+double local::TriCubicInterpolator::operator()(double x, double y, double z) const {
+    double dx, dy, dz;
+    const double* coefs = _voxel(x,y,z,dx,dy,dz);
+    // Evaluate the interpolation within this grid voxel.
+    int ijkn(0);
+    double dzpow(1);
+    double result(0);
+    for(int k = 0; k < 4; ++k) {
+        double dypow(1);
+        for(int j = 0; j < 4; ++j) {
+            result += dypow*dzpow*
+                (coefs[ijkn] + dx*(coefs[ijkn+1] + dx*(coefs[ijkn+2] + dx*coefs[ijkn+3])));
+            ijkn += 4;
+            dypow *= dy;
+        }
+        dzpow *= dz;
+    }
+    return result;
+}
+
+double local::TriCubicInterpolator::operator()(double x, double y, double z, double gradient[3], double hessian[3][3]) const {
+    double d[3];
+    const double* coefs = _voxel(x,y,z,d[0],d[1],d[2]);
+    // Powers of dx,dy,dz within the voxel, and their first and second derivatives, for each axis.
+    double p[3][4], dp[3][4], d2p[3][4];
+    for(int a = 0; a < 3; ++a) {
+        const double t(d[a]);
+        p[a][0] = 1; p[a][1] = t; p[a][2] = t*t; p[a][3] = t*t*t;
+        dp[a][0] = 0; dp[a][1] = 1; dp[a][2] = 2*t; dp[a][3] = 3*t*t;
+        d2p[a][0] = 0; d2p[a][1] = 0; d2p[a][2] = 2; d2p[a][3] = 6*t;
+    }
+    double value(0), gx(0), gy(0), gz(0), hxx(0), hyy(0), hzz(0), hxy(0), hxz(0), hyz(0);
+    int ijkn(0);
+    for(int k = 0; k < 4; ++k) {
+        for(int j = 0; j < 4; ++j) {
+            for(int i = 0; i < 4; ++i) {
+                const double c(coefs[ijkn++]);
+                value += c*p[0][i]*p[1][j]*p[2][k];
+                gx += c*dp[0][i]*p[1][j]*p[2][k];
+                gy += c*p[0][i]*dp[1][j]*p[2][k];
+                gz += c*p[0][i]*p[1][j]*dp[2][k];
+                hxx += c*d2p[0][i]*p[1][j]*p[2][k];
+                hyy += c*p[0][i]*d2p[1][j]*p[2][k];
+                hzz += c*p[0][i]*p[1][j]*d2p[2][k];
+                hxy += c*dp[0][i]*dp[1][j]*p[2][k];
+                hxz += c*dp[0][i]*p[1][j]*dp[2][k];
+                hyz += c*p[0][i]*dp[1][j]*dp[2][k];
+            }
+        }
+    }
+    // The polynomial is in grid units, so convert to derivatives with respect to x,y,z.
+    const double s1(1/_spacing), s2(1/(_spacing*_spacing));
+    gradient[0] = s1*gx; gradient[1] = s1*gy; gradient[2] = s1*gz;
+    hessian[0][0] = s2*hxx; hessian[1][1] = s2*hyy; hessian[2][2] = s2*hzz;
+    hessian[0][1] = hessian[1][0] = s2*hxy;
+    hessian[0][2] = hessian[2][0] = s2*hxz;
+    hessian[1][2] = hessian[2][1] = s2*hyz;
+    return value;
+}
+
+const double* local::TriCubicInterpolator::_coefficients(int key, int xi, int yi, int zi) const {
     // Check if we can re-use coefficients from the last interpolation.
-    if(!_initialized || xi != _i1 || yi != _i2 || zi != _i3) {
-        // Extract the local vocal values and calculate partial derivatives.
+    if(!_shards) {
+        if(!_initialized || key != _key) {
+            _computeCoefficients(xi,yi,zi,_coefs);
+            _key = key;
+            _initialized = true;
+        }
+        return _coefs;
+    }
+    // Each thread notes the last voxel it used, which is usually the next one wanted too.
+    struct LastVoxel { unsigned long id; int key; const double* coefs; };
+    static thread_local LastVoxel last = {0, 0, 0};
+    if(last.id == _id && last.key == key) return last.coefs;
+    Shard& shard = _shards[key % _nShards];
+    const double* coefs = 0;
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        std::unordered_map<int,Coefficients>::const_iterator found = shard.voxels.find(key);
+        if(found != shard.voxels.end()) coefs = found->second.c;
+    }
+    if(!coefs) {
+        // Computed without the lock held. If another thread got there first, theirs is kept. If the shard is full,
+        // they are kept for this thread only, until it next computes some.
+        static thread_local Coefficients computed;
+        _computeCoefficients(xi,yi,zi,computed.c);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        if(shard.voxels.size() < _maxShardVoxels) {
+            coefs = shard.voxels.insert(std::make_pair(key,computed)).first->second.c;
+        }
+        else {
+            std::unordered_map<int,Coefficients>::const_iterator found = shard.voxels.find(key);
+            coefs = found != shard.voxels.end() ? found->second.c : computed.c;
+        }
+    }
+    last.id = _id;
+    last.key = key;
+    last.coefs = coefs;
+    return coefs;
+}
+
+void local::TriCubicInterpolator::_computeCoefficients(int xi, int yi, int zi, double coefs[64]) const {
+    // Extract the local vocal values and calculate partial derivatives.
 		double x[64] = {
 		    // values of f(x,y,z) at each corner.
 		    _data[_index(xi,yi,zi)],_data[_index(xi+1,yi,zi)],_data[_index(xi,yi+1,zi)],
@@ -111,35 +220,11 @@ double local::TriCubicInterpolator::operator()(double x, double y, double z) con
 		};
 		// Convert voxel values and partial derivatives to interpolation coefficients.
     	for (int i=0;i<64;++i) {
-    		_coefs[i] = 0.0;
+    		coefs[i] = 0.0;
     		for (int j=0;j<64;++j) {
-    			_coefs[i] += _C[i][j]*x[j];
+    			coefs[i] += _C[i][j]*x[j];
     		}
     	}
-        // Remember this voxel for next time.
-        _i1 = xi;
-        _i2 = yi;
-        _i3 = zi;
-        _initialized = true;
-    }
-    // Evaluate the interpolation within this grid voxel.
-    dx -= xi;
-    dy -= yi;
-    dz -= zi;
-    int ijkn(0);
-    double dzpow(1);
-    double result(0);
-    for(int k = 0; k < 4; ++k) {
-        double dypow(1);
-        for(int j = 0; j < 4; ++j) {
-            result += dypow*dzpow*
-                (_coefs[ijkn] + dx*(_coefs[ijkn+1] + dx*(_coefs[ijkn+2] + dx*_coefs[ijkn+3])));
-            ijkn += 4;
-            dypow *= dy;
-        }
-        dzpow *= dz;
-    }
-    return result;
 }
 
 int local::TriCubicInterpolator::_C[64][64] = {
@@ -1,5 +1,8 @@
 // Created 23-Dec-2011 by David Kirkby (University of California, Irvine) <dkirkby@uci.edu>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
 #ifndef LIKELY_TRI_CUBIC_INTERPOLATOR
 #define LIKELY_TRI_CUBIC_INTERPOLATOR
 
@@ -8,19 +11,30 @@ namespace likely {
 	class TriCubicInterpolator {
 	// Performs tri-cubic interpolation within a 3D periodic grid.
 	// Based on http://citeseerx.ist.psu.edu/viewdoc/summary?doi=10.1.1.89.7835
+	// The interpolation coefficients of each voxel are computed the first time it is queried and kept for the life
+	// of the interpolator, up to a limit, so the datacube must not change meanwhile. Queries may come from several
+	// threads at once. An interpolator made with shared=false keeps only the last voxel's coefficients instead, which
+	// is cheaper to make and suits one that lives briefly and is queried by one thread.
 	public:
         typedef std::vector<double> DataCube;
         // Initializes an interpolator using the specified datacube of length n1*n2*n3 where
         // data is ordered first along the n1 axis [0,0,0], [1,0,0], ..., [n1-1,0,0], [0,1,0], ...
         // If n2 and n3 are both omitted, then n1=n2=n3 is assumed. Data is assumed to be
-        // equally spaced and periodic along each axis, with the coordinate origin (0,0,0) at
-        // grid index [0,0,0].
-		TriCubicInterpolator(DataCube& data, double spacing, int n1, int n2 = 0, int n3 = 0);
+        // equally spaced and periodic along each axis, and centred on the coordinate origin (see
+        // gridCoordinate).
+		TriCubicInterpolator(DataCube& data, double spacing, int n1, int n2 = 0, int n3 = 0, bool shared = true);
 		virtual ~TriCubicInterpolator();
         // Returns the interpolated data value for the specified x,y,z point. If the point lies
         // outside the box [0,n1*spacing) x [0,n2*spacing) x [0,n3*spacing), it will be folded
         // back assuming periodicity along each axis.
         double operator()(double x, double y, double z) const;
+        // Returns the interpolated data value as above, and fills in its first and second derivatives
+        // with respect to x,y,z, all from the same coefficients. hessian[a][b] is d2f/dadb.
+        double operator()(double x, double y, double z, double gradient[3], double hessian[3][3]) const;
+        // Returns where x lies along an axis of n points, in grid units. Point i of the axis is at
+        // x = (i-(n-1)/2)*spacing, the cell-centred layout of the simulation's grids. Every caller maps
+        // positions through this, so that they all agree on where the points are.
+        static double gridCoordinate(double x, double spacing, int n);
         // Returns the grid parameters.
         double getSpacing() const;
         int getN1() const;
@@ -33,12 +47,38 @@ namespace likely {
         DataCube& _data;
         double _spacing;
         int _n1, _n2, _n3;
-        mutable int _i1, _i2, _i3;
-        mutable double _coefs[64];
+        // Returns the coefficients of the voxel holding the point x,y,z, and sets dx,dy,dz to where the
+        // point lies within it, in grid units. The pointer is only good for as long as _coefficients says.
+        const double* _voxel(double x, double y, double z, double& dx, double& dy, double& dz) const;
+        // Returns the coefficients of the voxel whose lower corner has the unrolled index key, computing them if no
+        // thread has yet. The pointer is only good until this thread's next query of any interpolator, since a voxel
+        // that doesn't fit in the cache, or any voxel when the interpolator isn't shared, is held in scratch that the
+        // next query can overwrite.
+        const double* _coefficients(int key, int xi, int yi, int zi) const;
+        void _computeCoefficients(int xi, int yi, int zi, double coefs[64]) const;
+        // The coefficients of the voxels queried so far, keyed by the unrolled index of their lower corner and split
+        // over shards with a lock each, so that threads on different voxels seldom wait for one another. Elements of
+        // an unordered_map stay where they are as it grows, so they can be read after the lock is released. Once a
+        // shard holds _maxShardVoxels, the voxels that would go in it are computed afresh each time they are queried.
+        // There are no shards when the interpolator isn't shared.
+        struct Coefficients { double c[64]; };
+        struct Shard {
+            std::mutex lock;
+            std::unordered_map<int,Coefficients> voxels;
+        };
+        static const int _nShards = 64;
+        static const std::size_t _maxShardVoxels = 1024;
+        std::unique_ptr<Shard[]> _shards;
+        // The last voxel queried, when the interpolator isn't shared.
         mutable bool _initialized;
+        mutable int _key;
+        mutable double _coefs[64];
+        // Tells this interpolator apart in each thread's note of the last voxel it used.
+        unsigned long _id;
         static int _C[64][64];
 	}; // TriCubicInterpolator
 	
+    inline double TriCubicInterpolator::gridCoordinate(double x, double spacing, int n) { return x/spacing + (n-1)/2.0; }
     inline double TriCubicInterpolator::getSpacing() const { return _spacing; }
     inline int TriCubicInterpolator::getN1() const { return _n1; }
     inline int TriCubicInterpolator::getN2() const { return _n2; }
@@ -0,0 +1,192 @@
+#include "VTIFile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+static const char* host_byte_order()
+{
+    const uint16_t one = 1;
+    return (*(const unsigned char*)&one == 1) ? "LittleEndian" : "BigEndian";
+}
+
+bool vti_file(const string& filename)
+{
+    ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+    string line;
+    if(!getline(fin,line) || line.compare(0,5,"<?xml") != 0) return false;
+    return getline(fin,line) && line.find("type=\"ImageData\"") != string::npos;
+}
+
+bool write_vti(const string& filename, const VTIGrid& grid, const vector<string>& names, const function<void(int,int,int,float*)>& fill, int threads, size_t& filebytes)
+{
+    const int Nx = grid.Nx;
+    const int Ny = grid.Ny;
+    const int Nz = grid.Nz;
+    const uint64_t arraybytes = sizeof(float)*(uint64_t)Nx*Ny*Nz;
+    ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if(!out.good())
+    {
+        cout << "couldn't open " << filename << " to write\n";
+        return false;
+    }
+    stringstream extent;
+    extent << "0 " << Nx-1 << " 0 " << Ny-1 << " 0 " << Nz-1;
+    stringstream xml;
+    xml << setprecision(10);
+    xml << "<?xml version=\"1.0\"?>\n";
+    xml << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"" << host_byte_order() << "\" header_type=\"UInt64\">\n";
+    xml << "  <ImageData WholeExtent=\"" << extent.str() << "\" Origin=\"" << grid.origin[0] << ' ' << grid.origin[1] << ' ' << grid.origin[2] << "\" Spacing=\"" << grid.h << ' ' << grid.h << ' ' << grid.h << "\">\n";
+    xml << "    <Piece Extent=\"" << extent.str() << "\">\n";
+    xml << "      <PointData Scalars=\"" << names[0] << "\">\n";
+    for(size_t a=0;a<names.size();a++) xml << "        <DataArray type=\"Float32\" Name=\"" << names[a] << "\" format=\"appended\" offset=\"" << a*(sizeof(uint64_t)+arraybytes) << "\"/>\n";
+    xml << "      </PointData>\n";
+    xml << "    </Piece>\n";
+    xml << "  </ImageData>\n";
+    xml << "  <AppendedData encoding=\"raw\">\n";
+    // the data starts just after the _, which is put where that is a multiple of 8 bytes into the file, so the floats can be used in place
+    string text = xml.str() + "   ";
+    text.append((8 - (text.size()+1)%8)%8,' ');
+    text += "_";
+    out.write(text.data(),text.size());
+
+    // as many planes as fit in 16MB at a time
+    const int planes = max(1,min(Nz,(1<<22)/(Nx*Ny)));
+    vector<float> buffer((size_t)planes*Nx*Ny);
+    for(size_t a=0;a<names.size();a++)
+    {
+        out.write((const char*)&arraybytes,sizeof(arraybytes));
+        for(int k0=0;k0<Nz;k0+=planes)
+        {
+            const int k1 = min(Nz,k0+planes);
+            // each thread fills a run of whole planes
+#pragma omp parallel num_threads(threads)
+            {
+                const int nthreads = omp_get_num_threads();
+                const int t = omp_get_thread_num();
+                const int first = k0 + ((k1-k0)*t)/nthreads;
+                const int last = k0 + ((k1-k0)*(t+1))/nthreads;
+                if(last > first) fill((int)a,first,last,buffer.data() + (size_t)(first-k0)*Nx*Ny);
+            }
+            out.write((const char*)buffer.data(),(size_t)(k1-k0)*Nx*Ny*sizeof(float));
+        }
+    }
+    out << "\n  </AppendedData>\n</VTKFile>\n";
+    filebytes += out.tellp();
+    out.close();
+    if(out.fail())
+    {
+        cout << "couldn't write " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+// the value of an attribute within a tag, or "" if it isn't there
+static string attribute(const string& tag, const string& name)
+{
+    const string key = name + "=\"";
+    const size_t start = tag.find(key);
+    if(start == string::npos) return "";
+    const size_t end = tag.find('"',start+key.size());
+    return (end == string::npos) ? "" : tag.substr(start+key.size(),end-start-key.size());
+}
+
+// the file mapped in, the XML before the appended data, and where that data starts
+struct MappedVTI
+{
+    const char* data;
+    size_t size;
+    string xml;
+    size_t appended;
+};
+
+static bool map_vti(const string& filename, MappedVTI& vti, VTIGrid& grid)
+{
+    const int fd = open(filename.c_str(),O_RDONLY);
+    struct stat filestat;
+    if(fd < 0 || fstat(fd,&filestat) != 0 || filestat.st_size == 0)
+    {
+        cout << "couldn't open " << filename << "\n";
+        if(fd >= 0) close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL,filestat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        cout << "couldn't map " << filename << "\n";
+        return false;
+    }
+    vti.data = (const char*)mapping;
+    vti.size = filestat.st_size;
+    // the XML runs up to the _ that starts the raw data
+    const char* tag = "<AppendedData encoding=\"raw\">";
+    const char* found = (const char*)memmem(vti.data,vti.size,tag,strlen(tag));
+    const char* underscore = found ? (const char*)memchr(found,'_',vti.size-(found-vti.data)) : NULL;
+    vti.xml = found ? string(vti.data,found-vti.data) : "";
+    vti.appended = underscore ? underscore+1-vti.data : 0;
+    const size_t imagedata = vti.xml.find("<ImageData");
+    const string imagetag = (imagedata == string::npos) ? "" : vti.xml.substr(imagedata,vti.xml.find('>',imagedata)-imagedata);
+    int extent[6] = {0,-1,0,-1,0,-1};
+    stringstream(attribute(imagetag,"WholeExtent")) >> extent[0] >> extent[1] >> extent[2] >> extent[3] >> extent[4] >> extent[5];
+    stringstream(attribute(imagetag,"Origin")) >> grid.origin[0] >> grid.origin[1] >> grid.origin[2];
+    grid.h = atof(attribute(imagetag,"Spacing").c_str());
+    grid.Nx = extent[1]-extent[0]+1;
+    grid.Ny = extent[3]-extent[2]+1;
+    grid.Nz = extent[5]-extent[4]+1;
+    if(!underscore || attribute(vti.xml,"byte_order") != host_byte_order() || attribute(vti.xml,"header_type") != "UInt64" || grid.Nx < 1 || grid.Ny < 1 || grid.Nz < 1)
+    {
+        cout << filename << " isn't a .vti with raw appended data this code can read on this machine\n";
+        munmap(mapping,vti.size);
+        return false;
+    }
+    return true;
+}
+
+bool read_vti_grid(const string& filename, VTIGrid& grid)
+{
+    MappedVTI vti;
+    if(!map_vti(filename,vti,grid)) return false;
+    munmap((void*)vti.data,vti.size);
+    return true;
+}
+
+bool read_vti_array(const string& filename, const string& name, const function<void(const float*)>& use)
+{
+    MappedVTI vti;
+    VTIGrid grid;
+    if(!map_vti(filename,vti,grid)) return false;
+    // find the DataArray tag with this name, and from it the offset of the array
+    const size_t named = vti.xml.find("Name=\"" + name + "\"");
+    const size_t start = (named == string::npos) ? string::npos : vti.xml.rfind("<DataArray",named);
+    const string tag = (start == string::npos) ? "" : vti.xml.substr(start,vti.xml.find('>',start)-start);
+    const uint64_t floats = (uint64_t)grid.Nx*grid.Ny*grid.Nz;
+    const size_t offset = vti.appended + strtoull(attribute(tag,"offset").c_str(),NULL,10);
+    uint64_t bytes = 0;
+    if(tag.empty() || attribute(tag,"type") != "Float32" || attribute(tag,"format") != "appended" || offset + sizeof(bytes) > vti.size)
+    {
+        cout << filename << " has no appended Float32 array " << name << "\n";
+        munmap((void*)vti.data,vti.size);
+        return false;
+    }
+    memcpy(&bytes,vti.data+offset,sizeof(bytes));
+    if(bytes != floats*sizeof(float) || offset + sizeof(bytes) + bytes > vti.size || (offset + sizeof(bytes))%sizeof(float) != 0)
+    {
+        cout << "the array " << name << " in " << filename << " doesn't cover the grid, or is cut short\n";
+        munmap((void*)vti.data,vti.size);
+        return false;
+    }
+    use((const float*)(vti.data + offset + sizeof(bytes)));
+    munmap((void*)vti.data,vti.size);
+    return true;
+}
@@ -0,0 +1,30 @@
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+#ifndef VTIFILE_H
+#define VTIFILE_H
+
+// VTK XML ImageData (.vti) files of float fields on a grid, which ParaView reads. the arrays are appended raw, in the byte order of the
+// machine (which the file records), each as a UInt64 byte count and then the floats, x fastest. the XML at the top gives the byte offset of
+// each array, so any one of them can be read without going through the others
+struct VTIGrid
+{
+    int Nx,Ny,Nz;
+    double h;
+    double origin[3];
+};
+
+// does the file start as a .vti does
+bool vti_file(const string& filename);
+// write the arrays with the given names. fill(array, k0, k1, values) is asked for the planes k0 <= k < k1 of each in turn, x fastest, over the
+// given number of threads, so it is called from several at once, for different planes. each lot of planes goes out in one write. the size of
+// the file is added to filebytes. returns false, having said why, if it can't be written
+bool write_vti(const string& filename, const VTIGrid& grid, const vector<string>& names, const function<void(int,int,int,float*)>& fill, int threads, size_t& filebytes);
+// the grid of a .vti, and the array of the given name in it, as x fastest floats. the file is mapped in, and use is handed the floats where
+// they lie in it. returns false, having said why, if it can't be read, or has no Float32 array of that name covering the grid
+bool read_vti_grid(const string& filename, VTIGrid& grid);
+bool read_vti_array(const string& filename, const string& name, const function<void(const float*)>& use);
+
+#endif //VTIFILE_H
@@ -0,0 +1,114 @@
+#include "VTKUVFile.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the file mapped in, and where each of its sections starts
+struct MappedVTKUV
+{
+    const char* data;
+    size_t size;
+    vector<size_t> sections;
+};
+
+// the line starting at pos, which is moved on past it. false at the end of the file
+static bool next_line(const MappedVTKUV& file, size_t& pos, string& line)
+{
+    if(pos >= file.size) return false;
+    const char* end = (const char*)memchr(file.data+pos,'\n',file.size-pos);
+    const size_t length = end ? end-(file.data+pos) : file.size-pos;
+    line.assign(file.data+pos,length);
+    pos += length + 1;
+    return true;
+}
+
+static bool map_vtk_uv(const string& filename, MappedVTKUV& file, VTKUVGrid& grid)
+{
+    const int fd = open(filename.c_str(),O_RDONLY);
+    struct stat filestat;
+    if(fd < 0 || fstat(fd,&filestat) != 0 || filestat.st_size == 0)
+    {
+        cout << "couldn't open " << filename << "\n";
+        if(fd >= 0) close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL,filestat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        cout << "couldn't map " << filename << "\n";
+        return false;
+    }
+    file.data = (const char*)mapping;
+    file.size = filestat.st_size;
+    // it is read through from the front once
+    madvise(mapping,file.size,MADV_SEQUENTIAL);
+
+    // the header, up to the first SCALARS
+    grid.Nx = grid.Ny = grid.Nz = 0;
+    grid.h = 0;
+    grid.origin[0] = grid.origin[1] = grid.origin[2] = 0;
+    bool binary = false;
+    size_t pos = 0;
+    size_t linestart = 0;
+    string line,key;
+    while(true)
+    {
+        linestart = pos;
+        if(!next_line(file,pos,line)) break;
+        stringstream ss(line);
+        key.clear();
+        ss >> key;
+        if(key == "BINARY") binary = true;
+        else if(key == "DIMENSIONS") ss >> grid.Nx >> grid.Ny >> grid.Nz;
+        else if(key == "ORIGIN") ss >> grid.origin[0] >> grid.origin[1] >> grid.origin[2];
+        else if(key == "SPACING") ss >> grid.h;
+        else if(key == "SCALARS") break;
+    }
+    const size_t sectionbytes = sizeof(float)*(size_t)grid.Nx*grid.Ny*grid.Nz;
+    if(!binary || grid.Nx < 1 || grid.Ny < 1 || grid.Nz < 1)
+    {
+        cout << filename << " isn't a BINARY VTK uv file\n";
+        munmap(mapping,file.size);
+        return false;
+    }
+    // then each section is a SCALARS line, a LOOKUP_TABLE line and the floats, with a blank line between sections
+    pos = linestart;
+    file.sections.clear();
+    while(next_line(file,pos,line))
+    {
+        if(line.empty()) continue;
+        if(line.compare(0,7,"SCALARS") != 0 || !next_line(file,pos,line) || line.compare(0,12,"LOOKUP_TABLE") != 0 || pos + sectionbytes > file.size) break;
+        file.sections.push_back(pos);
+        pos += sectionbytes;
+    }
+    return true;
+}
+
+bool read_vtk_uv_grid(const string& filename, VTKUVGrid& grid)
+{
+    MappedVTKUV file;
+    if(!map_vtk_uv(filename,file,grid)) return false;
+    munmap((void*)file.data,file.size);
+    return true;
+}
+
+bool read_vtk_uv(const string& filename, int nsections, const function<void(int,const char*)>& use)
+{
+    MappedVTKUV file;
+    VTKUVGrid grid;
+    if(!map_vtk_uv(filename,file,grid)) return false;
+    if((int)file.sections.size() < nsections)
+    {
+        cout << filename << " has " << file.sections.size() << " whole sections, not " << nsections << "\n";
+        munmap((void*)file.data,file.size);
+        return false;
+    }
+    for(int section=0; section<nsections; section++) use(section,file.data+file.sections[section]);
+    munmap((void*)file.data,file.size);
+    return true;
+}
@@ -0,0 +1,38 @@
+#include <string>
+#include <functional>
+#include <stdint.h>
+#include <string.h>
+using namespace std;
+
+#ifndef VTKUVFILE_H
+#define VTKUVFILE_H
+
+// legacy VTK uv files, uv_plot<t>.vtk, as print_uv writes them: ten lines of text giving the grid, then sections of Nx*Ny*Nz big endian
+// floats, x fastest, each after a SCALARS and a LOOKUP_TABLE line - u, v and (in all but the oldest files) ucrossv
+struct VTKUVGrid
+{
+    int Nx,Ny,Nz;
+    double h;
+    double origin[3];
+};
+
+// the grid the header gives. returns false, having said why, if it isn't a BINARY uv file
+bool read_vtk_uv_grid(const string& filename, VTKUVGrid& grid);
+// the file is mapped in, and use(section, values) handed each of the first nsections sections where they lie in it, still big endian and
+// not necessarily aligned - vtk_uv_value reads them. returns false, having said why, if it can't be read or is cut short
+bool read_vtk_uv(const string& filename, int nsections, const function<void(int,const char*)>& use);
+
+// the nth float of a section, on this machine
+inline float vtk_uv_value(const char* values, size_t n)
+{
+    uint32_t bits;
+    memcpy(&bits,values+sizeof(float)*n,sizeof(bits));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    bits = __builtin_bswap32(bits);
+#endif
+    float value;
+    memcpy(&value,&bits,sizeof(value));
+    return value;
+}
+
+#endif //VTKUVFILE_H